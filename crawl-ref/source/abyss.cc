@@ -68,6 +68,15 @@ static ProceduralLayout *abyssLayout = nullptr, *levelLayout = nullptr;
 typedef priority_queue<ProceduralSample, vector<ProceduralSample>, ProceduralSamplePQCompare> sample_queue;
 
 static sample_queue abyss_sample_queue;
+
+// The cells _abyss_apply_terrain() may regenerate, in abyss coordinates, and
+// their samples. They are sampled together when the first of them is needed
+// (not earlier, since creating the layout uses the RNG). abyss_batch_index
+// holds each map position's index in the batch plus one, or zero.
+static vector<coord_def> abyss_batch_points;
+static vector<ProceduralSample> abyss_batch_samples;
+static FixedArray<unsigned short, GXM, GYM> abyss_batch_index(0);
+
 static vector<dungeon_feature_type> abyssal_features;
 static list<monster*> displaced_monsters;
 
@@ -1106,6 +1115,22 @@ const static RiverLayout rivers(1800, baseLayout);
 // This one is not fixed: [0] is a level pulled from the current game
 static vector<const ProceduralLayout*> complex_vec(2);
 
+/**
+ * One of the Abyss's fixed layouts, for tests.
+ *
+ * @param name "abyss" for everything the Abyss samples apart from the level
+ *             it borrows terrain from, or "wastes" for the abyssal wastes.
+ * @return the layout, or nullptr for any other name.
+ */
+const ProceduralLayout *abyss_fixed_layout(const string &name)
+{
+    if (name == "abyss")
+        return &rivers;
+    if (name == "wastes")
+        return &wastes;
+    return nullptr;
+}
+
 static ProceduralSample _abyss_grid(const coord_def &p)
 {
     const coord_def pt = p + abyssal_state.major_coord;
@@ -1126,7 +1151,15 @@ static ProceduralSample _abyss_grid(const coord_def &p)
         abyssLayout = new WorleyLayout(23571113, complex_vec, 6.1);
     }
 
-    const ProceduralSample sample = (*abyssLayout)(pt, abyssal_state.depth);
+    const int batched = abyss_batch_index(p);
+    if (batched && abyss_batch_samples.empty())
+    {
+        abyssLayout->sample(abyss_batch_points, abyssal_state.depth,
+                            abyss_batch_samples);
+    }
+    const ProceduralSample sample =
+        batched ? abyss_batch_samples[batched - 1]
+                : (*abyssLayout)(pt, abyssal_state.depth);
     ASSERT(sample.feat() > DNGN_UNSEEN);
 
     abyss_sample_queue.push(sample);
@@ -1178,38 +1211,50 @@ static dungeon_feature_type _veto_dangerous_terrain(dungeon_feature_type feat)
     return feat;
 }
 
-static void _update_abyss_terrain(const coord_def &p,
+// May _update_abyss_terrain() change the terrain at map position rp?
+static bool _abyss_terrain_may_change(const coord_def &rp,
     const map_bitmask &abyss_genlevel_mask, bool morph)
 {
-    const coord_def rp = p - abyssal_state.major_coord;
     // ignore dead coordinates
     if (!in_bounds(rp))
-        return;
+        return false;
 
     const dungeon_feature_type currfeat = grd(rp);
 
     // Don't decay vaults.
     if (map_masked(rp, MMT_VAULT))
-        return;
+        return false;
 
     switch (currfeat)
     {
         case DNGN_EXIT_ABYSS:
         case DNGN_ABYSSAL_STAIR:
-            return;
+            return false;
         default:
             break;
     }
 
     if (feat_is_altar(currfeat))
-        return;
+        return false;
 
     if (!abyss_genlevel_mask(rp))
-        return;
+        return false;
 
     if (currfeat != DNGN_UNSEEN && !morph)
+        return false;
+
+    return true;
+}
+
+static void _update_abyss_terrain(const coord_def &p,
+    const map_bitmask &abyss_genlevel_mask, bool morph)
+{
+    const coord_def rp = p - abyssal_state.major_coord;
+    if (!_abyss_terrain_may_change(rp, abyss_genlevel_mask, morph))
         return;
 
+    const dungeon_feature_type currfeat = grd(rp);
+
     // What should have been there previously?  It might not be because
     // of external changes such as digging.
     const ProceduralSample sample = _abyss_grid(rp);
@@ -1276,6 +1321,34 @@ static void _ensure_player_habitable(bool dig_instead)
     }
 }
 
+// Batch up the cells that the main loop of _abyss_apply_terrain() always
+// samples. Cells it only regenerates by chance are left out, and sampled one
+// by one if their turn comes.
+static void _abyss_start_batch(const map_bitmask &abyss_genlevel_mask,
+                               bool morph, bool now, bool used_queue)
+{
+    for (rectangle_iterator ri(MAPGEN_BORDER); ri; ++ri)
+    {
+        const coord_def p(*ri);
+        const coord_def abyss_coord = p + abyssal_state.major_coord;
+        const bool turned_to_floor = map_masked(p, MMT_TURNED_TO_FLOOR);
+        if ((turned_to_floor ? now : !used_queue)
+            && !_in_wastes(abyss_coord)
+            && _abyss_terrain_may_change(p, abyss_genlevel_mask, morph))
+        {
+            abyss_batch_points.push_back(abyss_coord);
+            abyss_batch_index(p) = abyss_batch_points.size();
+        }
+    }
+}
+
+static void _abyss_end_batch()
+{
+    abyss_batch_points.clear();
+    abyss_batch_samples.clear();
+    abyss_batch_index.init(0);
+}
+
 static void _abyss_apply_terrain(const map_bitmask &abyss_genlevel_mask,
                                  bool morph = false, bool now = false)
 {
@@ -1307,6 +1380,7 @@ static void _abyss_apply_terrain(const map_bitmask &abyss_genlevel_mask,
 
     int ii = 0;
     int delta = you.time_taken * (you.abyss_speed + 40) / 200;
+    _abyss_start_batch(abyss_genlevel_mask, morph, now, used_queue);
     for (rectangle_iterator ri(MAPGEN_BORDER); ri; ++ri)
     {
         const coord_def p(*ri);
@@ -1344,6 +1418,7 @@ static void _abyss_apply_terrain(const map_bitmask &abyss_genlevel_mask,
                                    DNGN_ABYSSAL_STAIR,
                                    abyss_genlevel_mask);
     }
+    _abyss_end_batch();
     if (ii)
         dprf(DIAG_ABYSS, "Nuked %d features", ii);
     _ensure_player_habitable(false);
@@ -5,6 +5,8 @@
 
 #pragma once
 
+class ProceduralLayout;
+
 // When shifting areas in the abyss, shift the square containing player LOS
 // plus a little extra so that the player won't be disoriented by taking a
 // step backward after an abyss shift.
@@ -46,3 +48,5 @@ bool lugonu_corrupt_level(int power);
 void run_corruption_effects(int duration);
 void set_abyss_state(coord_def coord, uint32_t depth);
 void destroy_abyss();
+
+const ProceduralLayout *abyss_fixed_layout(const string &name);
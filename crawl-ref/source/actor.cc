@@ -8,6 +8,7 @@
 #include "areas.h"
 #include "art-enum.h"
 #include "attack.h"
+#include "beam.h"
 #include "chardump.h"
 #include "directn.h"
 #include "env.h"
@@ -137,6 +138,7 @@ void actor::set_position(const coord_def &c)
     const coord_def oldpos = position;
     position = c;
     los_actor_moved(this, oldpos);
+    invalidate_tracer_cache();
     areas_actor_moved(this, oldpos);
 }
 
@@ -67,6 +67,7 @@ LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c \
     $(CRAWL_PATH)/dgn-labyrinth.cc \
     $(CRAWL_PATH)/dgn-layouts.cc \
     $(CRAWL_PATH)/dgn-overview.cc \
+    $(CRAWL_PATH)/dgn-profile.cc \
     $(CRAWL_PATH)/dgn-proclayouts.cc \
     $(CRAWL_PATH)/dgn-shoals.cc \
     $(CRAWL_PATH)/dgn-swamp.cc \
@@ -10,6 +10,7 @@
 #include <stdexcept>
 
 #include "act-iter.h"
+#include "beam.h"
 #include "colour.h"
 #include "command.h"
 #include "dungeon.h"
@@ -970,6 +971,10 @@ namespace arena
             if (ties > 0)
                 fprintf(file, "-%d", ties);
             fprintf(file, "\n");
+#ifdef DEBUG_STATISTICS
+            fprintf(file, "tracers: %u fired, %u cached\n",
+                    tracer_stats.fired, tracer_stats.cached);
+#endif
         }
     }
 
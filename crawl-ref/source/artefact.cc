@@ -21,6 +21,7 @@
 #include "coordit.h"
 #include "database.h"
 #include "god-item.h"
+#include "hash.h"
 #include "item-name.h"
 #include "item-prop.h"
 #include "item-status-flag-type.h"
@@ -1066,6 +1067,32 @@ int artefact_known_property(const item_def &item, artefact_prop_type prop)
         return 0;
 }
 
+/**
+ * A hash of an artefact's properties and which of them the player knows,
+ * for caches of text that lists them. Learning a property changes it, even
+ * though that updates the item's props in place.
+ *
+ * @param item  The item; need not be an artefact.
+ * @return      The hash, or 0 for items that aren't artefacts.
+ */
+uint64_t artefact_props_hash(const item_def &item)
+{
+    if (!is_artefact(item))
+        return 0;
+
+    artefact_properties_t  proprt;
+    artefact_known_props_t known;
+    proprt.init(0);
+    known.init(0);
+
+    artefact_properties(item, proprt, known);
+
+    uint64_t hash = 0;
+    for (int i = 0; i < ART_PROPERTIES; i++)
+        hash = hash3(hash, proprt[i], known[i]);
+    return hash;
+}
+
 static int _artefact_num_props(const artefact_properties_t &proprt)
 {
     int num = 0;
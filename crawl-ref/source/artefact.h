@@ -117,6 +117,8 @@ int artefact_property(const item_def &item, artefact_prop_type prop);
 
 int artefact_known_property(const item_def &item, artefact_prop_type prop);
 
+uint64_t artefact_props_hash(const item_def &item);
+
 void artefact_learn_prop(item_def &item, artefact_prop_type prop);
 
 bool make_item_randart(item_def &item, bool force_mundane = false);
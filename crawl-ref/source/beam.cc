@@ -1069,7 +1069,11 @@ void bolt::fire()
         _undo_tracer(*this, boltcopy);
     }
     else
+    {
         do_fire();
+        // Whatever it hit may have died, moved or changed its mind.
+        invalidate_tracer_cache();
+    }
 
     //XXX: suspect, but code relies on path_taken being non-empty
     if (path_taken.empty())
@@ -2044,6 +2048,122 @@ int silver_damages_victim(actor* victim, int damage, string &dmg_msg)
     return ret;
 }
 
+tracer_cache_stats tracer_stats;
+
+// Monster AI often fires the same tracer several times while deciding what
+// to do: once per candidate wand, missile and spell, and again when setting
+// up the one it picks. Results are remembered until something happens that
+// could change them; see invalidate_tracer_cache().
+struct cached_tracer
+{
+    bool explode_only;
+    bool explosion_hole;
+    bolt input;
+    bolt result;
+};
+
+static vector<cached_tracer> tracer_cache;
+
+// The cache is linearly searched, so keep it small. A monster doesn't
+// have this many distinct tracers to fire in one turn.
+static const size_t MAX_CACHED_TRACERS = 32;
+
+/**
+ * Forget all remembered tracer results. Called whenever actors move, a real
+ * beam is fired, and at the start of each monster's and player's action,
+ * which between them cover everything a tracer looks at.
+ */
+void invalidate_tracer_cache()
+{
+    tracer_cache.clear();
+}
+
+// Can this tracer be answered from (and stored in) the cache? Tracers that
+// roll their flavour, or that carry state we can't compare cheaply, can't.
+static bool _tracer_cacheable(const bolt &beam)
+{
+    return !beam.special_explosion
+           && !beam.chose_ray
+           && beam.flavour != BEAM_CHAOS && beam.flavour != BEAM_RANDOM
+           && beam.real_flavour != BEAM_CHAOS
+           && beam.real_flavour != BEAM_RANDOM
+           && beam.real_flavour != BEAM_CRYSTAL;
+}
+
+// Would firing these two tracers give the same result? Compares everything
+// that's set by callers or left over from earlier use of the bolt, since on
+// a match the whole cached result is copied over the caller's bolt.
+static bool _same_tracer(const bolt &a, const bolt &b)
+{
+    return a.source_id == b.source_id
+        && a.source == b.source
+        && a.target == b.target
+        && a.range == b.range
+        && a.flavour == b.flavour
+        && a.real_flavour == b.real_flavour
+        && a.origin_spell == b.origin_spell
+        && a.damage.num == b.damage.num
+        && a.damage.size == b.damage.size
+        && a.ench_power == b.ench_power
+        && a.hit == b.hit
+        && a.thrower == b.thrower
+        && a.ex_size == b.ex_size
+        && a.attitude == b.attitude
+        && a.foe_ratio == b.foe_ratio
+        && a.item == b.item
+        && a.drop_item == b.drop_item
+        && a.pierce == b.pierce
+        && a.is_explosion == b.is_explosion
+        && a.aimed_at_spot == b.aimed_at_spot
+        && a.aimed_at_feet == b.aimed_at_feet
+        && a.affects_nothing == b.affects_nothing
+        && a.auto_hit == b.auto_hit
+        && a.use_target_as_pos == b.use_target_as_pos
+        && a.is_targeting == b.is_targeting
+        && a.effect_known == b.effect_known
+        && a.effect_wanton == b.effect_wanton
+        && a.was_missile == b.was_missile
+        && a.ac_rule == b.ac_rule
+        && a.seen == b.seen
+        && a.heard == b.heard
+        && a.obvious_effect == b.obvious_effect
+        && a.dont_stop_player == b.dont_stop_player
+        && a.dont_stop_trees == b.dont_stop_trees
+        && a.beam_cancelled == b.beam_cancelled
+        && a.reflector == b.reflector
+        && a.bounce_pos == b.bounce_pos
+        && a.glyph == b.glyph
+        && a.colour == b.colour
+        && a.loudness == b.loudness
+        && a.draw_delay == b.draw_delay
+        && a.explode_delay == b.explode_delay
+        && a.animate == b.animate
+#ifdef DEBUG_DIAGNOSTICS
+        && a.quiet_debug == b.quiet_debug
+#endif
+        && a.name == b.name
+        && a.short_name == b.short_name
+        && a.source_name == b.source_name
+        && a.aux_source == b.aux_source
+        && a.hit_verb == b.hit_verb
+        && a.hit_noise_msg == b.hit_noise_msg
+        && a.explode_noise_msg == b.explode_noise_msg;
+}
+
+static void _fire_tracer_now(bolt &pbolt, bool explode_only,
+                             bool explosion_hole)
+{
+    // Fire!
+    if (explode_only)
+        pbolt.explode(false, explosion_hole);
+    else
+        pbolt.fire();
+
+    // Unset tracer flag (convenience).
+    pbolt.is_tracer = false;
+    tracer_stats.fired++;
+}
+
 //  Used by monsters in "planning" which spell to cast. Fires off a "tracer"
 //  which tells the monster what it'll hit if it breathes/casts etc.
 //
@@ -2088,14 +2208,31 @@ void fire_tracer(const monster* mons, bolt &pbolt, bool explode_only,
 
     pbolt.in_explosion_phase = false;
 
-    // Fire!
-    if (explode_only)
-        pbolt.explode(false, explosion_hole);
-    else
-        pbolt.fire();
+    if (!_tracer_cacheable(pbolt))
+    {
+        _fire_tracer_now(pbolt, explode_only, explosion_hole);
+        return;
+    }
 
-    // Unset tracer flag (convenience).
-    pbolt.is_tracer = false;
+    for (const cached_tracer &entry : tracer_cache)
+    {
+        // explode() doesn't reset path_taken, so it's part of the input.
+        if (entry.explode_only == explode_only
+            && entry.explosion_hole == explosion_hole
+            && _same_tracer(entry.input, pbolt)
+            && (!explode_only || entry.input.path_taken == pbolt.path_taken))
+        {
+            pbolt = entry.result;
+            tracer_stats.cached++;
+            return;
+        }
+    }
+
+    if (tracer_cache.size() >= MAX_CACHED_TRACERS)
+        tracer_cache.clear();
+    const bolt input = pbolt;
+    _fire_tracer_now(pbolt, explode_only, explosion_hole);
+    tracer_cache.push_back({ explode_only, explosion_hole, input, pbolt });
 }
 
 static coord_def _random_point_hittable_from(const coord_def &c,
@@ -5881,6 +6018,7 @@ bool bolt::explode(bool show_more, bool hole_in_the_middle)
 
     if (!is_tracer)
     {
+        invalidate_tracer_cache();
         loudness = explosion_noise(r);
 
         // Not an "explosion", but still a bit noisy at the target location.
@@ -321,6 +321,14 @@ bool curare_actor(actor* source, actor* target, int levels, string name,
 int silver_damages_victim(actor* victim, int damage, string &dmg_msg);
 void fire_tracer(const monster* mons, bolt &pbolt,
                   bool explode_only = false, bool explosion_hole = false);
+
+struct tracer_cache_stats
+{
+    unsigned int fired;  // Tracers actually fired.
+    unsigned int cached; // Tracers answered from the cache instead.
+};
+extern tracer_cache_stats tracer_stats;
+void invalidate_tracer_cache();
 bool imb_can_splash(coord_def origin, coord_def center,
                     vector<coord_def> path_taken, coord_def target);
 spret_type zapping(zap_type ztype, int power, bolt &pbolt,
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <bitset>
+#include <cstring>
 
 #include "defines.h"
 
@@ -107,21 +108,146 @@ public:
     }
 };
 
+// Index of the lowest set bit of a non-zero word.
+static inline unsigned int lowest_set_bit(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    unsigned int i = 0;
+    while (!(word & 1))
+    {
+        word >>= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+// Number of set bits in a word.
+static inline unsigned int set_bit_count(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#else
+    unsigned int n = 0;
+    for (; word; word &= word - 1)
+        ++n;
+    return n;
+#endif
+}
+
+/**
+ * A 2D bit array, such as a mask of cells on the map.
+ *
+ * Each row is kept in whole 64-bit words, with the bits past SIZEX always
+ * clear, so that flood_fill() and the set operations can work on a word
+ * of cells at a time.
+ */
 template <unsigned int SIZEX, unsigned int SIZEY> class FixedBitArray
 {
+    enum
+    {
+        ROW_WORDS = (SIZEX + 63) / 64,
+    };
+
 protected:
-    std::bitset<SIZEX*SIZEY> data;
+    uint64_t rows[SIZEY][ROW_WORDS];
+
+    // The bits of word w of a row that are inside the array.
+    static uint64_t word_mask(int w)
+    {
+        return w < ROW_WORDS - 1 || SIZEX % 64 == 0
+               ? ~uint64_t(0)
+               : (uint64_t(1) << (SIZEX % 64)) - 1;
+    }
+
+    // Fill the runs of mask in one word that contain set bits of bits,
+    // doubling the distance covered at each step.
+    static uint64_t fill_word(uint64_t bits, uint64_t mask)
+    {
+        uint64_t up = bits, up_open = mask;
+        uint64_t down = bits, down_open = mask;
+        for (int shift = 1; shift < 64; shift *= 2)
+        {
+            up |= up_open & (up << shift);
+            up_open &= up_open << shift;
+            down |= down_open & (down >> shift);
+            down_open &= down_open >> shift;
+        }
+        return up | down;
+    }
+
+    // Fill the runs of mask in a row that contain set bits of row.
+    static void fill_row(uint64_t *row, const uint64_t *mask)
+    {
+        bool carried;
+        do
+        {
+            for (int w = 0; w < ROW_WORDS; ++w)
+                row[w] = fill_word(row[w], mask[w]);
+
+            // Runs that cross a word boundary need another round.
+            carried = false;
+            for (int w = 1; w < ROW_WORDS; ++w)
+            {
+                const uint64_t up = (row[w - 1] >> 63) & mask[w] & ~row[w];
+                const uint64_t down = (row[w] << 63) & mask[w - 1]
+                                      & ~row[w - 1];
+                if (up || down)
+                {
+                    row[w] |= up;
+                    row[w - 1] |= down;
+                    carried = true;
+                }
+            }
+        } while (carried);
+    }
+
+    // Add the cells of mask touching from, the next row over, to row, and
+    // fill its runs. Returns whether row changed.
+    static bool spread_row(uint64_t *row, const uint64_t *from,
+                           const uint64_t *mask)
+    {
+        uint64_t seeds[ROW_WORDS];
+        bool grew = false;
+        for (int w = 0; w < ROW_WORDS; ++w)
+        {
+            uint64_t touching = from[w] | from[w] << 1 | from[w] >> 1;
+            if (w > 0)
+                touching |= from[w - 1] >> 63;
+            if (w < ROW_WORDS - 1)
+                touching |= from[w + 1] << 63;
+            seeds[w] = row[w] | (touching & mask[w]);
+            grew |= seeds[w] != row[w];
+        }
+        if (!grew)
+            return false;
+
+        fill_row(seeds, mask);
+        memcpy(row, seeds, sizeof(seeds));
+        return true;
+    }
+
+    bool row_empty(int y) const
+    {
+        for (int w = 0; w < ROW_WORDS; ++w)
+            if (rows[y][w])
+                return false;
+        return true;
+    }
+
 public:
     void reset()
     {
-        data.reset();
+        memset(rows, 0, sizeof(rows));
     }
 
     void init(bool def)
     {
-        data.reset();
-        if (def)
-            data.flip();
+        for (unsigned int y = 0; y < SIZEY; ++y)
+            for (int w = 0; w < ROW_WORDS; ++w)
+                rows[y][w] = def ? word_mask(w) : 0;
     }
 
     FixedBitArray()
@@ -141,8 +267,7 @@ public:
         if (x < 0 || y < 0 || x >= (int)SIZEX || y >= (int)SIZEY)
             die("bit array range error: %d,%d / %u,%u", x, y, SIZEX, SIZEY);
 #endif
-        unsigned int i = y * SIZEX + x;
-        return data[i];
+        return rows[y][x / 64] & (uint64_t(1) << (x % 64));
     }
 
     template<class Indexer> inline bool get(const Indexer &i) const
@@ -166,8 +291,11 @@ public:
         if (x < 0 || y < 0 || x >= (int)SIZEX || y >= (int)SIZEY)
             die("bit array range error: %d,%d / %u,%u", x, y, SIZEX, SIZEY);
 #endif
-        unsigned int i = y * SIZEX + x;
-        data[i] = value;
+        const uint64_t bit = uint64_t(1) << (x % 64);
+        if (value)
+            rows[y][x / 64] |= bit;
+        else
+            rows[y][x / 64] &= ~bit;
     }
 
     template<class Indexer> inline void set(const Indexer &i, bool value = true)
@@ -175,15 +303,358 @@ public:
         return set(i.x, i.y, value);
     }
 
+    unsigned int count() const
+    {
+        unsigned int n = 0;
+        for (unsigned int y = 0; y < SIZEY; ++y)
+            for (int w = 0; w < ROW_WORDS; ++w)
+                n += set_bit_count(rows[y][w]);
+        return n;
+    }
+
+    bool any() const
+    {
+        for (unsigned int y = 0; y < SIZEY; ++y)
+            if (!row_empty(y))
+                return true;
+        return false;
+    }
+
+    // Whether any bit is set in both arrays.
+    bool intersects(const FixedBitArray<SIZEX, SIZEY> &x) const
+    {
+        for (unsigned int y = 0; y < SIZEY; ++y)
+            for (int w = 0; w < ROW_WORDS; ++w)
+                if (rows[y][w] & x.rows[y][w])
+                    return true;
+        return false;
+    }
+
     inline FixedBitArray<SIZEX, SIZEY>& operator|=(const FixedBitArray<SIZEX, SIZEY>&x)
     {
-        data |= x.data;
+        for (unsigned int y = 0; y < SIZEY; ++y)
+            for (int w = 0; w < ROW_WORDS; ++w)
+                rows[y][w] |= x.rows[y][w];
         return *this;
     }
 
     inline FixedBitArray<SIZEX, SIZEY>& operator&=(const FixedBitArray<SIZEX, SIZEY>&x)
     {
-        data &= x.data;
+        for (unsigned int y = 0; y < SIZEY; ++y)
+            for (int w = 0; w < ROW_WORDS; ++w)
+                rows[y][w] &= x.rows[y][w];
+        return *this;
+    }
+
+    inline FixedBitArray<SIZEX, SIZEY>& operator^=(const FixedBitArray<SIZEX, SIZEY>&x)
+    {
+        for (unsigned int y = 0; y < SIZEY; ++y)
+            for (int w = 0; w < ROW_WORDS; ++w)
+                rows[y][w] ^= x.rows[y][w];
         return *this;
     }
+
+    /**
+     * Find the first set bit at or after (x, y) in row-major order.
+     *
+     * @param[in,out] x, y  The position to start searching from. If a set
+     *                      bit is found, they are updated to its position.
+     *                      x may be SIZEX, meaning the start of row y + 1.
+     * @return whether a set bit was found.
+     */
+    bool find_next(int &x, int &y) const
+    {
+        if (x >= (int)SIZEX)
+        {
+            x = 0;
+            ++y;
+        }
+
+        for (; y < (int)SIZEY; ++y, x = 0)
+        {
+            for (int w = x / 64; w < ROW_WORDS; ++w)
+            {
+                uint64_t word = rows[y][w];
+                if (w == x / 64)
+                    word &= ~uint64_t(0) << (x % 64);
+                if (word)
+                {
+                    x = w * 64 + lowest_set_bit(word);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Spread the set bits to all the cells of mask that they are connected
+     * to through mask, diagonals included, and clear the bits outside mask.
+     *
+     * This works on whole rows: each row is filled along the runs of mask
+     * it touches, then the rows are swept downwards and upwards in turn,
+     * each seeded from the one before, until a sweep changes nothing. A
+     * sweep stops early once it is past the rows the fill has reached.
+     */
+    void flood_fill(const FixedBitArray<SIZEX, SIZEY> &mask)
+    {
+        int top = SIZEY, bottom = -1;
+        for (int y = 0; y < (int)SIZEY; ++y)
+        {
+            for (int w = 0; w < ROW_WORDS; ++w)
+                rows[y][w] &= mask.rows[y][w];
+            if (row_empty(y))
+                continue;
+            fill_row(rows[y], mask.rows[y]);
+            top = min(top, y);
+            bottom = y;
+        }
+        if (bottom < 0)
+            return;
+
+        for (bool down = true, first = true; ; down = !down, first = false)
+        {
+            bool changed = false;
+            if (down)
+            {
+                for (int y = top + 1; y < (int)SIZEY; ++y)
+                {
+                    if (spread_row(rows[y], rows[y - 1], mask.rows[y]))
+                    {
+                        changed = true;
+                        bottom = max(bottom, y);
+                    }
+                    else if (y > bottom)
+                        break;
+                }
+            }
+            else
+            {
+                for (int y = bottom - 1; y >= 0; --y)
+                {
+                    if (spread_row(rows[y], rows[y + 1], mask.rows[y]))
+                    {
+                        changed = true;
+                        top = min(top, y);
+                    }
+                    else if (y < top)
+                        break;
+                }
+            }
+
+            // The other direction was settled by the sweep before this one.
+            if (!changed && !first)
+                return;
+        }
+    }
+};
+
+/**
+ * An iterator over the zones of a FixedBitArray: its sets of set bits that
+ * are connected to each other, diagonals included.
+ *
+ * Zones come in the order in which a row-major scan first meets them, and
+ * are numbered from 1 in that order.
+ */
+template <unsigned int SIZEX, unsigned int SIZEY> class BitArrayZoneIterator
+{
+public:
+    BitArrayZoneIterator(const FixedBitArray<SIZEX, SIZEY> &cells)
+        : remaining(cells), x(0), y(0), nzone(0), done(false)
+    {
+        ++(*this);
+    }
+
+    operator bool() const { return !done; }
+
+    const FixedBitArray<SIZEX, SIZEY> &operator*() const { return zone; }
+    const FixedBitArray<SIZEX, SIZEY> *operator->() const { return &zone; }
+
+    void operator++()
+    {
+        if (!remaining.find_next(x, y))
+        {
+            done = true;
+            return;
+        }
+
+        // Zones don't touch, so filling through the cells not yet used by
+        // earlier zones finds the whole zone.
+        zone.reset();
+        zone.set(x, y);
+        zone.flood_fill(remaining);
+        remaining ^= zone;
+        ++nzone;
+    }
+
+    // The number of the current zone.
+    int number() const { return nzone; }
+
+    // Set grid[x][y] to the current zone's number for each of its cells.
+    template <class Grid> void label(Grid &grid) const
+    {
+        for (int lx = 0, ly = 0; zone.find_next(lx, ly); ++lx)
+            grid[lx][ly] = nzone;
+    }
+
+private:
+    FixedBitArray<SIZEX, SIZEY> remaining;
+    FixedBitArray<SIZEX, SIZEY> zone;
+    int x, y;
+    int nzone;
+    bool done;
+};
+
+/**
+ * A 2D bit array for sparse sets of cells, such as cells needing a redraw.
+ *
+ * Besides the bits themselves, a mask of non-empty rows is kept, so that
+ * find_next() can skip over empty rows and words. Walking all set bits
+ * costs time proportional to the number of set bits plus the number of
+ * rows, rather than to the area of the array.
+ */
+template <unsigned int SIZEX, unsigned int SIZEY> class SparseBitArray
+{
+    enum
+    {
+        ROW_WORDS = (SIZEX + 63) / 64,
+        MASK_WORDS = (SIZEY + 63) / 64,
+    };
+
+protected:
+    uint64_t rows[SIZEY][ROW_WORDS];
+    uint64_t row_mask[MASK_WORDS];
+    unsigned int nset;
+
+    bool row_empty(int y) const
+    {
+        for (int w = 0; w < ROW_WORDS; ++w)
+            if (rows[y][w])
+                return false;
+        return true;
+    }
+
+public:
+    SparseBitArray()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        memset(rows, 0, sizeof(rows));
+        memset(row_mask, 0, sizeof(row_mask));
+        nset = 0;
+    }
+
+    inline bool get(int x, int y) const
+    {
+#ifdef ASSERTS
+        if (x < 0 || y < 0 || x >= (int)SIZEX || y >= (int)SIZEY)
+            die("bit array range error: %d,%d / %u,%u", x, y, SIZEX, SIZEY);
+#endif
+        return rows[y][x / 64] & (uint64_t(1) << (x % 64));
+    }
+
+    template<class Indexer> inline bool get(const Indexer &i) const
+    {
+        return get(i.x, i.y);
+    }
+
+    inline bool operator () (int x, int y) const
+    {
+        return get(x, y);
+    }
+
+    template<class Indexer> inline bool operator () (const Indexer &i) const
+    {
+        return get(i.x, i.y);
+    }
+
+    inline void set(int x, int y, bool value = true)
+    {
+        if (get(x, y) == value)
+            return;
+
+        const uint64_t bit = uint64_t(1) << (x % 64);
+        if (value)
+        {
+            rows[y][x / 64] |= bit;
+            row_mask[y / 64] |= uint64_t(1) << (y % 64);
+            ++nset;
+        }
+        else
+        {
+            rows[y][x / 64] &= ~bit;
+            if (row_empty(y))
+                row_mask[y / 64] &= ~(uint64_t(1) << (y % 64));
+            --nset;
+        }
+    }
+
+    template<class Indexer> inline void set(const Indexer &i, bool value = true)
+    {
+        set(i.x, i.y, value);
+    }
+
+    inline unsigned int count() const
+    {
+        return nset;
+    }
+
+    inline bool any() const
+    {
+        return nset > 0;
+    }
+
+    /**
+     * Find the first set bit at or after (x, y) in row-major order.
+     *
+     * @param[in,out] x, y  The position to start searching from. If a set
+     *                      bit is found, they are updated to its position.
+     *                      x may be SIZEX, meaning the start of row y + 1.
+     * @return whether a set bit was found.
+     */
+    bool find_next(int &x, int &y) const
+    {
+        if (x >= (int)SIZEX)
+        {
+            x = 0;
+            ++y;
+        }
+
+        while (y < (int)SIZEY)
+        {
+            // Skip empty rows a mask word at a time.
+            uint64_t rmask = row_mask[y / 64] >> (y % 64);
+            if (!rmask)
+            {
+                y = (y / 64 + 1) * 64;
+                x = 0;
+                continue;
+            }
+            const int ny = y + lowest_set_bit(rmask);
+            if (ny != y)
+            {
+                y = ny;
+                x = 0;
+            }
+
+            for (int w = x / 64; w < ROW_WORDS; ++w)
+            {
+                uint64_t word = rows[y][w];
+                if (w == x / 64)
+                    word &= ~uint64_t(0) << (x % 64);
+                if (word)
+                {
+                    x = w * 64 + lowest_set_bit(word);
+                    return true;
+                }
+            }
+
+            x = 0;
+            ++y;
+        }
+        return false;
+    }
 };
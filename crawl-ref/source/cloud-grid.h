@@ -0,0 +1,59 @@
+/**
+ * @file
+ * @brief Storage for the clouds on the current level.
+**/
+
+#pragma once
+
+#include "coord.h"
+
+/**
+ * The clouds on a level, stored densely in a slot array with a grid of slot
+ * indices so that lookups by position are constant-time.
+ *
+ * Each cloud's pos is its key: clouds are added with insert() and only
+ * moved by erasing and reinserting them. Erasing moves the last cloud into
+ * the freed slot, so iteration order is arbitrary; code that needs a stable
+ * order, or that adds or removes clouds while walking them, should use
+ * positions().
+ */
+class cloud_grid
+{
+public:
+    cloud_grid();
+
+    cloud_struct *find(const coord_def &pos)
+    {
+        if (!map_bounds(pos))
+            return nullptr;
+        const unsigned short slot = slot_index(pos);
+        return slot ? &slots[slot - 1] : nullptr;
+    }
+
+    const cloud_struct *find(const coord_def &pos) const
+    {
+        return const_cast<cloud_grid *>(this)->find(pos);
+    }
+
+    cloud_struct &insert(const cloud_struct &cloud);
+    void erase(const coord_def &pos);
+    void clear();
+
+    vector<coord_def> positions() const;
+
+    size_t size() const { return slots.size(); }
+    bool empty() const { return slots.empty(); }
+
+    vector<cloud_struct>::iterator begin() { return slots.begin(); }
+    vector<cloud_struct>::iterator end() { return slots.end(); }
+    vector<cloud_struct>::const_iterator begin() const
+    {
+        return slots.begin();
+    }
+    vector<cloud_struct>::const_iterator end() const { return slots.end(); }
+
+private:
+    // Slot number plus one, or 0 if there's no cloud.
+    FixedArray<unsigned short, GXM, GYM> slot_index;
+    vector<cloud_struct> slots;
+};
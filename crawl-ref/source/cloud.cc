@@ -39,9 +39,63 @@
 #include "tiledef-main.h"
 #include "unwind.h"
 
+cloud_grid::cloud_grid()
+{
+    slot_index.init(0);
+}
+
+/// Add a cloud at cloud.pos, replacing any cloud that was already there.
+cloud_struct &cloud_grid::insert(const cloud_struct &cloud)
+{
+    ASSERT(map_bounds(cloud.pos));
+    if (cloud_struct *old = find(cloud.pos))
+    {
+        *old = cloud;
+        return *old;
+    }
+
+    slots.push_back(cloud);
+    slot_index(cloud.pos) = slots.size();
+    return slots.back();
+}
+
+void cloud_grid::erase(const coord_def &pos)
+{
+    const unsigned short slot = map_bounds(pos) ? slot_index(pos) : 0;
+    if (!slot)
+        return;
+
+    slot_index(pos) = 0;
+    if (slot != slots.size())
+    {
+        slots[slot - 1] = slots.back();
+        slot_index(slots[slot - 1].pos) = slot;
+    }
+    slots.pop_back();
+}
+
+void cloud_grid::clear()
+{
+    slot_index.init(0);
+    slots.clear();
+}
+
+/// The positions of all clouds, sorted the same way as coord_defs in a map.
+/// Clouds are processed in this order so that random rolls happen in the
+/// same sequence regardless of how the clouds are stored.
+vector<coord_def> cloud_grid::positions() const
+{
+    vector<coord_def> result;
+    result.reserve(slots.size());
+    for (const cloud_struct &cloud : slots)
+        result.push_back(cloud.pos);
+    sort(result.begin(), result.end());
+    return result;
+}
+
 cloud_struct* cloud_at(coord_def pos)
 {
-    return map_find(env.cloud, pos);
+    return env.cloud.find(pos);
 }
 
 /// damage = base + random2avg(random, random/15 + 1)
@@ -376,7 +430,8 @@ cloud_struct::cloud_struct(coord_def p, cloud_type c, int d, int spread,
         type = random_smoke_type();
 }
 
-static int _spread_cloud(const cloud_struct &cloud)
+// Takes a copy: adding clouds may move the others around in env.cloud.
+static int _spread_cloud(const cloud_struct cloud)
 {
     const int spreadch = cloud.decay > 30 ? 80 :
                          cloud.decay > 20 ? 50 :
@@ -402,10 +457,11 @@ static int _spread_cloud(const cloud_struct &cloud)
         if (newdecay >= cloud.decay)
             newdecay = cloud.decay - 1;
 
-        env.cloud[*ai] = cloud;
-        env.cloud[*ai].pos = *ai;
-        env.cloud[*ai].decay = newdecay;
-        _los_cloud_changed(env.cloud[*ai].pos, env.cloud[*ai].type, CLOUD_NONE);
+        cloud_struct spread = cloud;
+        spread.pos = *ai;
+        spread.decay = newdecay;
+        env.cloud.insert(spread);
+        _los_cloud_changed(spread.pos, spread.type, CLOUD_NONE);
 
         extra_decay += 8;
     }
@@ -413,7 +469,7 @@ static int _spread_cloud(const cloud_struct &cloud)
     return extra_decay;
 }
 
-static void _spread_fire(const cloud_struct &cloud)
+static void _spread_fire(const cloud_struct cloud)
 {
     int make_flames = one_chance_in(5);
 
@@ -429,10 +485,11 @@ static void _spread_fire(const cloud_struct &cloud)
         // burning trees produce flames all around
         if (!cell_is_solid(*ai) && make_flames)
         {
-            env.cloud[*ai] = cloud;
-            env.cloud[*ai].type = CLOUD_FIRE;
-            env.cloud[*ai].pos = *ai;
-            env.cloud[*ai].decay = cloud.decay / 2 + 1;
+            cloud_struct flames = cloud;
+            flames.type = CLOUD_FIRE;
+            flames.pos = *ai;
+            flames.decay = cloud.decay / 2 + 1;
+            env.cloud.insert(flames);
         }
 
         // forest fire doesn't spread in all directions at once,
@@ -446,9 +503,10 @@ static void _spread_fire(const cloud_struct &cloud)
         if (you.see_cell(*ai))
             mpr("The forest fire spreads!");
         destroy_wall(*ai);
-        env.cloud[*ai] = cloud;
-        env.cloud[*ai].pos = *ai;
-        env.cloud[*ai].decay = random2(30) + 25;
+        cloud_struct fire = cloud;
+        fire.pos = *ai;
+        fire.decay = random2(30) + 25;
+        env.cloud.insert(fire);
         if (cloud.whose == KC_YOU)
             did_god_conduct(DID_KILL_PLANT, 1);
         else if (cloud.whose == KC_FRIENDLY && !crawl_state.game_is_arena())
@@ -457,7 +515,7 @@ static void _spread_fire(const cloud_struct &cloud)
     }
 }
 
-static void _cloud_interacts_with_terrain(const cloud_struct &cloud)
+static void _cloud_interacts_with_terrain(const cloud_struct cloud)
 {
     if (cloud.type != CLOUD_FIRE && cloud.type != CLOUD_FOREST_FIRE)
         return;
@@ -472,10 +530,11 @@ static void _cloud_interacts_with_terrain(const cloud_struct &cloud)
             && one_chance_in(14))
         {
             const cloud_type old = cloud_type_at(p);
-            env.cloud[p] = cloud_struct(p, CLOUD_STEAM, 2 + random2(5),
-                                        11, cloud.whose, cloud.killer,
-                                        cloud.source, -1);
-            _los_cloud_changed(p, env.cloud[p].type, old);
+            const cloud_struct &steam =
+                env.cloud.insert(cloud_struct(p, CLOUD_STEAM, 2 + random2(5),
+                                              11, cloud.whose, cloud.killer,
+                                              cloud.source, -1));
+            _los_cloud_changed(p, steam.type, old);
         }
     }
 }
@@ -506,22 +565,25 @@ static int _cloud_dissipation_rate(const cloud_struct &cloud)
     return dissipate;
 }
 
-static void _dissipate_cloud(cloud_struct& cloud)
+static void _dissipate_cloud(const coord_def pos)
 {
     // Apply calculated rate to the actual cloud.
-    cloud.decay -= _cloud_dissipation_rate(cloud);
+    cloud_struct *cloud = cloud_at(pos);
+    cloud->decay -= _cloud_dissipation_rate(*cloud);
 
-    if (cloud.type == CLOUD_FOREST_FIRE)
-        _spread_fire(cloud);
-    else if (x_chance_in_y(cloud.spread_rate, 100))
+    // Spreading adds clouds, so look this one up again afterwards.
+    if (cloud->type == CLOUD_FOREST_FIRE)
+        _spread_fire(*cloud);
+    else if (x_chance_in_y(cloud->spread_rate, 100))
     {
-        cloud.spread_rate -= div_rand_round(cloud.spread_rate, 10);
-        cloud.decay       -= _spread_cloud(cloud);
+        cloud->spread_rate -= div_rand_round(cloud->spread_rate, 10);
+        const int extra_decay = _spread_cloud(*cloud);
+        cloud_at(pos)->decay -= extra_decay;
     }
 
     // Check for total dissipation and handle accordingly.
-    if (cloud.decay < 1)
-        delete_cloud(cloud.pos);
+    if (cloud_at(pos)->decay < 1)
+        delete_cloud(pos);
 }
 
 static void _handle_spectral_cloud(const cloud_struct& cloud)
@@ -562,15 +624,15 @@ static void _handle_spectral_cloud(const cloud_struct& cloud)
 
 void manage_clouds()
 {
-    // We can't iterate over env.cloud directly because _dissipate_cloud
-    // will remove this cloud and invalidate our iterator.
-    vector<cloud_struct *> cloud_ptrs;
-    for (auto& entry : env.cloud)
-        cloud_ptrs.push_back(&entry.second);
-
-    for (auto ptr : cloud_ptrs)
+    // We can't iterate over env.cloud directly because spreading adds
+    // clouds and _dissipate_cloud removes them, both of which shuffle the
+    // storage. Clouds that spread this turn aren't processed until the next.
+    for (const coord_def &pos : env.cloud.positions())
     {
-        cloud_struct& cloud = *ptr;
+        const cloud_struct *current = cloud_at(pos);
+        if (!current)
+            continue;
+        const cloud_struct cloud = *current;
 
 #ifdef ASSERTS
         if (cell_is_solid(cloud.pos))
@@ -596,7 +658,7 @@ void manage_clouds()
 
         _cloud_interacts_with_terrain(cloud);
 
-        _dissipate_cloud(cloud);
+        _dissipate_cloud(pos);
     }
 
     update_cloud_knowledge();
@@ -651,11 +713,7 @@ void delete_all_clouds()
 {
     // We can't iterate over env.cloud directly because delete_cloud
     // will remove this cloud and invalidate our iterator.
-    vector<coord_def> cloud_locs;
-    for (auto& entry : env.cloud)
-        cloud_locs.push_back(entry.first);
-
-    for (auto pos : cloud_locs)
+    for (const coord_def &pos : env.cloud.positions())
         delete_cloud(pos);
 }
 
@@ -669,11 +727,12 @@ void move_cloud(coord_def src, coord_def newpos)
 
     const cloud_type old = cloud_type_at(newpos);
 
-    env.cloud[newpos] = env.cloud[src];
+    cloud_struct cloud = *cloud_at(src);
+    cloud.pos = newpos;
     env.cloud.erase(src);
-    env.cloud[newpos].pos = newpos;
-    _los_cloud_changed(src, CLOUD_NONE, env.cloud[newpos].type);
-    _los_cloud_changed(newpos, env.cloud[newpos].type, old);
+    env.cloud.insert(cloud);
+    _los_cloud_changed(src, CLOUD_NONE, cloud.type);
+    _los_cloud_changed(newpos, cloud.type, old);
 }
 
 void swap_clouds(coord_def p1, coord_def p2)
@@ -691,13 +750,13 @@ void swap_clouds(coord_def p1, coord_def p2)
         return;
     }
 
-    cloud_struct temp = env.cloud[p1];
-    env.cloud[p1] = env.cloud[p2];
-    env.cloud[p2] = temp;
-    env.cloud[p1].pos = p1;
-    env.cloud[p2].pos = p2;
-    _los_cloud_changed(p1, env.cloud[p1].type, env.cloud[p2].type);
-    _los_cloud_changed(p2, env.cloud[p2].type, env.cloud[p1].type);
+    cloud_struct &c1 = *cloud_at(p1);
+    cloud_struct &c2 = *cloud_at(p2);
+    swap(c1, c2);
+    c1.pos = p1;
+    c2.pos = p2;
+    _los_cloud_changed(p1, c1.type, c2.type);
+    _los_cloud_changed(p2, c2.type, c1.type);
 }
 
 // Places a cloud with the given stats assuming one doesn't already
@@ -764,10 +823,11 @@ void place_cloud(cloud_type cl_type, const coord_def& ctarget, int cl_range,
 
     const int spread_rate = _actual_spread_rate(cl_type, _spread_rate);
 
-    env.cloud[ctarget] = cloud_struct(ctarget, cl_type, cl_range * 10,
+    const cloud_struct &cloud =
+        env.cloud.insert(cloud_struct(ctarget, cl_type, cl_range * 10,
                                       spread_rate, whose, killer, source,
-                                      excl_rad);
-    _los_cloud_changed(ctarget, env.cloud[ctarget].type, old);
+                                      excl_rad));
+    _los_cloud_changed(ctarget, cloud.type, old);
 }
 
 bool is_opaque_cloud(cloud_type ctype)
@@ -1708,13 +1768,12 @@ void remove_tornado_clouds(mid_t whose)
 
     // We can't iterate over env.cloud directly because delete_cloud
     // will remove this cloud and invalidate our iterator.
-    vector<coord_def> tornados;
-    for (auto& entry : env.cloud)
-        if (entry.second.type == CLOUD_TORNADO && entry.second.source == whose)
-            tornados.push_back(entry.first);
-
-    for (auto pos : tornados)
-        delete_cloud(pos);
+    for (const coord_def &pos : env.cloud.positions())
+    {
+        const cloud_struct &cloud = *cloud_at(pos);
+        if (cloud.type == CLOUD_TORNADO && cloud.source == whose)
+            delete_cloud(pos);
+    }
 }
 
 static void _spread_cloud(coord_def pos, cloud_type type, int radius, int pow,
@@ -24,6 +24,7 @@
 #include "cluautil.h"
 #include "coordit.h"
 #include "dlua.h"
+#include "dungeon.h"
 #include "end.h"
 #include "errors.h"
 #include "files.h"
@@ -36,6 +37,7 @@
 #include "mon-place.h"
 #include "mon-util.h"
 #include "ng-init.h"
+#include "pattern.h"
 #include "state.h"
 #include "stringutil.h"
 #include "xom.h"
@@ -184,7 +186,12 @@ void run_tests()
     _run_test("mon-data", debug_mondata);
     _run_test("mon-spell", debug_monspells);
     _run_test("coordit", coordit_tests);
+    _run_test("zones", dgn_zone_tests);
     _run_test("makename", make_name_tests);
+    _run_test("pattern", pattern_tests);
+    _run_test("pregen", pregen_tests);
+    _run_test("seeded-levels", seeded_level_tests);
+    _run_test("random", random_tests);
     _run_test("job-data", debug_jobdata);
     _run_test("mon-bands", debug_bands);
     _run_test("xom-data", validate_xom_events);
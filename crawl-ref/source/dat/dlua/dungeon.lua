@@ -242,6 +242,10 @@ end
 -- value of the last chunk. If the caller is interested in the return
 -- values of all the chunks, this function may be called multiple
 -- times, once for each chunk.
+--
+-- Chunk functions are cached and shared by maps with identical chunks,
+-- so each function's old environment is put back afterwards, in case
+-- it is still running further up the stack for another map.
 function dgn_run_map(...)
   local map_chunk_functions = { ... }
   if #map_chunk_functions > 0 then
@@ -252,7 +256,9 @@ function dgn_run_map(...)
     local env = dgn_map_meta_wrap(g_dgn_curr_map, dgn)
     for _, map_chunk_function in pairs(map_chunk_functions) do
       if map_chunk_function then
+        local old_env = getfenv(map_chunk_function)
         ret = setfenv(map_chunk_function, env)()
+        setfenv(map_chunk_function, old_env)
       end
     end
     return ret
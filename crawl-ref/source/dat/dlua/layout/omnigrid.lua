@@ -401,8 +401,8 @@ end
 function omnigrid.fill_cell(e,cell,fill)
   for x = cell.x1,cell.x2,1 do
     for y = cell.y1,cell.y2,1 do
-      local r = fill(x,y,e.mapgrd[x][y])
-      if r ~= nil then e.mapgrd[x][y] = r end
+      local r = fill(x,y,e.mapgrd:get(x, y))
+      if r ~= nil then e.mapgrd:set(x, y, r) end
     end
   end
 end
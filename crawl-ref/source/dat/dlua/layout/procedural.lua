@@ -466,7 +466,7 @@ function procedural.render_map(e, fval, fresult)
     for y = 1,gym-2,1 do
       local val = fval(x,y)
       local r = fresult(val,x,y)
-      if r ~= nil then e.mapgrd[x][y] = r end
+      if r ~= nil then e.mapgrd:set(x, y, r) end
     end
   end
 
@@ -481,7 +481,7 @@ function procedural.render_map_area(e,x1,y1,x2,y2,fval,brush,space)
     for y = y1,y2,1 do
       local val = fval(x-x1,y-y1,x,y)
       local r = fbrush(val,x,y)
-      if r ~= nil then e.mapgrd[x][y] = r end
+      if r ~= nil then e.mapgrd:set(x, y, r) end
     end
   end
 end
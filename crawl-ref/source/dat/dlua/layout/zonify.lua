@@ -8,6 +8,9 @@ require("dlua/layout/vector.lua")
 
 zonify = {}
 
+-- The glyphs zonify.map_map() and zonify.map_fill_zones() treat as wall.
+zonify.map_wall_glyphs = "wlxcvbtg"
+
 function zonify.map(bounds,fcell,fgroup)
   local x1,x2,y1,y2 = bounds.x1,bounds.x2,bounds.y1,bounds.y2
   local zonemap = {}
@@ -140,7 +143,7 @@ function zonify.map_map(e)
   -- TODO: Are there mapgrid function to check solidity after SUBST etc.?
   --       There is dgn.inspect_map but it requires a vault_placement rather than a map...
   -- local floor = ".W+({[)}]<>_"
-  local wall = "wlxcvbtg"
+  local wall = zonify.map_wall_glyphs
 
   -- TODO: Can we check size of current map after extend_map?
   local gxm,gym = dgn.max_bounds()
@@ -161,9 +164,11 @@ function zonify.map_fill_zones(e, num_to_keep, glyph, min_zone_size)
   if glyph == nil then glyph = 'x' end
   if min_zone_size == nil then min_zone_size = 1 end
 
-  local zonemap = zonify.map_map(e)
-  zonify.fill_smallest_zones(zonemap, num_to_keep, "floor",
-                             function(x,y,cell) e.mapgrd[x][y] = glyph end, min_zone_size)
+  -- Same as filling the smallest "floor" zones of zonify.map_map(e), but
+  -- done in one call.
+  e.fill_small_zones { keep = num_to_keep, fill = glyph,
+                       min_size = min_zone_size,
+                       wall = zonify.map_wall_glyphs }
 end
 
 function zonify.map_fill_lava_zones(e, num_to_keep, glyph, min_zone_size)
@@ -171,21 +176,8 @@ function zonify.map_fill_lava_zones(e, num_to_keep, glyph, min_zone_size)
   if glyph == nil then glyph = 'x' end
   if min_zone_size == nil then min_zone_size = 1 end
 
-  local wall = "wxcvbtg"
-
-  -- TODO: Can we check size of current map after extend_map?
-  local gxm,gym = dgn.max_bounds()
-  local zonemap = zonify.map(
-    { x1 = 1, y1 = 1, x2 = gxm-2, y2 = gym-2 },
-    function(x,y)
-      return dgn.in_bounds(x,y) and { glyph = e.mapgrd[x][y] } or nil
-    end,
-    function(val)
-      return string.find(wall,val.glyph,1,true) and "wall" or "floor"
-    end
-  )
-  zonify.fill_smallest_zones(zonemap, num_to_keep, "floor",
-                             function(x,y,cell) e.mapgrd[x][y] = glyph end, min_zone_size)
+  e.fill_small_zones { keep = num_to_keep, fill = glyph,
+                       min_size = min_zone_size, wall = "wxcvbtg" }
 end
 
 -- Zonifies the current dungeon grid
@@ -14,6 +14,7 @@
 #include "crash.h"
 #include "dbg-scan.h"
 #include "dbg-util.h"
+#include "dgn-profile.h"
 #include "delay.h"
 #include "directn.h"
 #include "dlua.h"
@@ -121,6 +122,7 @@ static void _dump_level_info(FILE* file)
     }
 
     debug_dump_levgen();
+    builder_profile_dump(file);
 }
 
 static void _dump_player(FILE *file)
@@ -7,6 +7,15 @@
 
 #include "dbg-maps.h"
 
+#include <chrono>
+#ifdef UNIX
+# include <fcntl.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+#include "act-iter.h"
+#include "artefact.h"
 #include "branch.h"
 #include "chardump.h"
 #include "crash.h"
@@ -22,6 +31,7 @@
 #include "shopping.h"
 #include "state.h"
 #include "stringutil.h"
+#include "version.h"
 #include "view.h"
 
 #ifdef DEBUG_STATISTICS
@@ -223,6 +233,17 @@ static bool _build_dungeon()
     return true;
 }
 
+// Forget the uniques and unique vaults of the dungeon built last.
+static void _reset_dungeon()
+{
+    dlua.callfn("dgn_clear_data", "");
+    you.uniq_map_tags.clear();
+    you.uniq_map_names.clear();
+    you.unique_creatures.reset();
+    initialise_branch_depths();
+    init_level_connectivity();
+}
+
 /**
  * Build dungeon levels for mapstat or objstat.
  *
@@ -254,12 +275,7 @@ bool mapstat_build_levels()
              build_attempts ? level_vetoes * 100.0 / build_attempts : 0.0);
         printf("%d..", i + 1);
         fflush(stdout);
-        dlua.callfn("dgn_clear_data", "");
-        you.uniq_map_tags.clear();
-        you.uniq_map_names.clear();
-        you.unique_creatures.reset();
-        initialise_branch_depths();
-        init_level_connectivity();
+        _reset_dungeon();
         if (!_build_dungeon())
             return false;
         if (crawl_state.obj_stat_gen)
@@ -330,6 +346,11 @@ static void _write_map_stats()
     fprintf(outf, "Levels attempted: %d, built: %d, failed: %d\n",
             levels_tried, levels_tried - levels_failed,
             levels_failed);
+
+    int chunk_loads, chunk_cache_hits;
+    dlua_chunk::cache_counts(chunk_loads, chunk_cache_hits);
+    fprintf(outf, "Lua chunks loaded: %d, reused from cache: %d\n",
+            chunk_loads, chunk_cache_hits);
     if (!errors.empty())
     {
         fprintf(outf, "\n\nMap errors:\n");
@@ -531,4 +552,437 @@ void mapstat_generate_stats()
     printf("Map stats complete.\n");
 }
 
+// Level hashes for -levelhash: FNV-1a over the words added.
+class level_hasher
+{
+public:
+    void add(int value)
+    {
+        uint32_t word = value;
+        for (int i = 0; i < 4; ++i, word >>= 8)
+            hash = (hash ^ (word & 0xff)) * 16777619U;
+    }
+
+    void add(const string &str)
+    {
+        add(str.length());
+        for (const char c : str)
+            hash = (hash ^ uint8_t(c)) * 16777619U;
+    }
+
+    uint32_t value() const { return hash; }
+
+private:
+    uint32_t hash = 2166136261U;
+};
+
+static void _hash_item(level_hasher &hash, const item_def &item)
+{
+    hash.add(item.base_type);
+    hash.add(item.sub_type);
+    hash.add(item.plus);
+    hash.add(item.plus2);
+    hash.add(item.special);
+    hash.add(item.quantity);
+    hash.add(item.flags);
+    hash.add(item.pos.x);
+    hash.add(item.pos.y);
+
+    if (is_artefact(item))
+    {
+        artefact_properties_t props;
+        artefact_properties(item, props);
+        for (const int prop : props)
+            hash.add(prop);
+        hash.add(get_artefact_name(item, true));
+    }
+}
+
+// A line of levelhash.log: the level and the hashes of its terrain, items,
+// monsters and vaults, then a comment with the build time and the vaults.
+static string _level_hash_line(const level_id &place, double ms)
+{
+    level_hasher terrain, items, monsters, vaults;
+
+    for (int y = 0; y < GYM; ++y)
+        for (int x = 0; x < GXM; ++x)
+            terrain.add(grd[x][y]);
+
+    for (const item_def &item : mitm)
+        if (item.defined())
+            _hash_item(items, item);
+    for (const auto &entry : env.shop)
+    {
+        const shop_struct &shop = entry.second;
+        items.add(shop.type);
+        items.add(shop.pos.x);
+        items.add(shop.pos.y);
+        for (const item_def &item : shop.stock)
+            _hash_item(items, item);
+    }
+
+    for (monster_iterator mi; mi; ++mi)
+    {
+        monsters.add(mi->type);
+        monsters.add(mi->base_monster);
+        monsters.add(mi->pos().x);
+        monsters.add(mi->pos().y);
+        monsters.add(mi->hit_points);
+        monsters.add(mi->max_hit_points);
+        monsters.add(mi->number);
+        monsters.add(mi->attitude);
+        // The items, not their indices in mitm, which depend on what was
+        // placed and destroyed before.
+        for (const short slot : mi->inv)
+        {
+            if (slot == NON_ITEM)
+                monsters.add(NON_ITEM);
+            else
+                _hash_item(monsters, mitm[slot]);
+        }
+    }
+
+    vector<string> names;
+    for (const auto &vault : env.level_vaults)
+    {
+        vaults.add(vault->map.name);
+        vaults.add(vault->pos.x);
+        vaults.add(vault->pos.y);
+        names.push_back(vault->map.name);
+    }
+
+    return make_stringf("%-12s %08x %08x %08x %08x  # %.1f ms: %s",
+                        place.describe().c_str(), terrain.value(),
+                        items.value(), monsters.value(), vaults.value(), ms,
+                        comma_separated_line(names.begin(), names.end(),
+                                             ", ", ", ").c_str());
+}
+
+// What the player looked like before the first branch was built.
+static FixedVector<unique_item_status_type, MAX_UNRANDARTS> hash_unique_items;
+static CrawlHashTable hash_props;
+
+static string _level_hash_tmp_file(int worker)
+{
+    return make_stringf("levelhash.%d.tmp", worker);
+}
+
+/**
+ * Build and hash the branches that fall to one worker.
+ *
+ * Each branch starts from the same state and each level uses its own
+ * stream seeded from the game seed, so the hashes don't depend on which
+ * worker builds a branch or how many workers there are.
+ */
+static bool _hash_worker(const vector<branch_type> &hash_branches,
+                         int workers, int worker)
+{
+    FILE *outf = fopen(_level_hash_tmp_file(worker).c_str(), "w");
+    if (!outf)
+        return false;
+
+    bool ok = true;
+    for (int i = worker; ok && i < (int) hash_branches.size(); i += workers)
+    {
+        seed_rng(Options.seed);
+        you.unique_items = hash_unique_items;
+        you.props = hash_props;
+        _reset_dungeon();
+
+        for (const level_id &lid : generated_levels)
+        {
+            if (lid.branch != hash_branches[i])
+                continue;
+
+            you.where_are_you = lid.branch;
+            you.depth = lid.depth;
+
+            const int failed = levels_failed;
+            const auto start = chrono::steady_clock::now();
+            {
+                seeded_rng_scope level_rng(you.game_seed, lid.branch,
+                                           lid.depth);
+                ok = _do_build_level();
+            }
+            const chrono::duration<double, milli> time =
+                chrono::steady_clock::now() - start;
+            if (!ok)
+                break;
+
+            if (levels_failed > failed)
+            {
+                fprintf(outf, "%-12s failed  # %.1f ms\n",
+                        lid.describe().c_str(), time.count());
+            }
+            else
+            {
+                fprintf(outf, "%s\n",
+                        _level_hash_line(lid, time.count()).c_str());
+            }
+        }
+    }
+
+    fclose(outf);
+    return ok;
+}
+
+#ifdef UNIX
+static bool _run_hash_workers(const vector<branch_type> &hash_branches,
+                              int workers)
+{
+    vector<pid_t> pids;
+    for (int i = 0; i < workers; ++i)
+    {
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            // Several processes drawing on the terminal would only make a
+            // mess of it.
+            const int null_fd = open("/dev/null", O_RDWR);
+            if (null_fd >= 0)
+            {
+                dup2(null_fd, STDIN_FILENO);
+                dup2(null_fd, STDOUT_FILENO);
+                if (null_fd > STDERR_FILENO)
+                    close(null_fd);
+            }
+            _exit(_hash_worker(hash_branches, workers, i) ? 0 : 1);
+        }
+        else if (pid < 0)
+        {
+            fprintf(stderr, "Can't start level hash worker: %s\n",
+                    strerror(errno));
+            break;
+        }
+        pids.push_back(pid);
+    }
+
+    bool ok = (int) pids.size() == workers;
+    for (const pid_t pid : pids)
+    {
+        int status = 0;
+        if (waitpid(pid, &status, 0) != pid
+            || !WIFEXITED(status) || WEXITSTATUS(status))
+        {
+            fprintf(stderr, "Level hash worker %d failed.\n", (int) pid);
+            ok = false;
+        }
+    }
+    return ok;
+}
+#endif
+
+static vector<string> _read_lines(const string &file)
+{
+    vector<string> lines;
+    FILE *inf = fopen(file.c_str(), "r");
+    if (!inf)
+        return lines;
+
+    char buf[1024];
+    string line;
+    while (fgets(buf, sizeof(buf), inf))
+    {
+        line += buf;
+        if (line.back() != '\n')
+            continue;
+        line.pop_back();
+        lines.push_back(line);
+        line.clear();
+    }
+    if (!line.empty())
+        lines.push_back(line);
+    fclose(inf);
+    return lines;
+}
+
+// The hash fields of each level in a levelhash.log, by level.
+static map<string, vector<string>> _parse_level_hashes(
+    const vector<string> &lines)
+{
+    map<string, vector<string>> hashes;
+    for (const string &line : lines)
+    {
+        vector<string> fields =
+            split_string(" ", line.substr(0, line.find('#')), true, false);
+        if (fields.empty())
+            continue;
+        const string place = fields[0];
+        fields.erase(fields.begin());
+        hashes[place] = fields;
+    }
+    return hashes;
+}
+
+/**
+ * Print the levels whose hashes differ from those in a previous run's log.
+ *
+ * @return Whether all the levels matched.
+ */
+static bool _diff_level_hashes(const vector<string> &lines,
+                               const vector<string> &baseline_lines,
+                               const string &baseline_file)
+{
+    static const char *parts[] = { "terrain", "items", "monsters", "vaults" };
+    const auto baseline = _parse_level_hashes(baseline_lines);
+    const auto current = _parse_level_hashes(lines);
+
+    int diffs = 0;
+    for (const level_id &lid : generated_levels)
+    {
+        const string place = lid.describe();
+        const auto old_hash = baseline.find(place);
+        const auto new_hash = current.find(place);
+        if (old_hash == baseline.end() || new_hash == current.end())
+        {
+            printf("%s: not in %s\n", place.c_str(),
+                   old_hash == baseline.end() ? baseline_file.c_str()
+                                              : "this run");
+            ++diffs;
+            continue;
+        }
+
+        const vector<string> &a = old_hash->second;
+        const vector<string> &b = new_hash->second;
+        if (a == b)
+            continue;
+        ++diffs;
+
+        vector<string> changed;
+        if (a.size() != ARRAYSZ(parts) || b.size() != ARRAYSZ(parts))
+            changed.push_back("build result");
+        else
+        {
+            for (unsigned int i = 0; i < ARRAYSZ(parts); ++i)
+                if (a[i] != b[i])
+                    changed.push_back(parts[i]);
+        }
+        printf("%s: %s differ\n", place.c_str(),
+               comma_separated_line(changed.begin(), changed.end()).c_str());
+    }
+
+    printf("%d of %d levels differ from %s.\n", diffs,
+           (int) generated_levels.size(), baseline_file.c_str());
+    return !diffs;
+}
+
+/**
+ * Build every level of the dungeon (or of the -levelhash range) for the
+ * seed given with -seed, and write a hash of each to levelhash.log.
+ *
+ * @return Whether every level was built, and matched the levels in the
+ *         -levelhash-diff file if there was one.
+ */
+bool mapstat_hash_levels()
+{
+    if (!Options.seed)
+    {
+        printf("-levelhash needs a seed, given with -seed.\n");
+        return false;
+    }
+
+    // Read this first, in case it's the log we are about to replace.
+    const string &baseline_file = SysEnv.level_hash_baseline;
+    vector<string> baseline_lines;
+    if (!baseline_file.empty())
+    {
+        baseline_lines = _read_lines(baseline_file);
+        if (baseline_lines.empty())
+        {
+            printf("Can't read level hashes from %s.\n",
+                   baseline_file.c_str());
+            return false;
+        }
+    }
+
+    you.wizard = true;
+    you.species = SP_HUMAN;
+    seed_rng(Options.seed);
+    // As _setup_generic() does for a new game started with -seed, so that
+    // the hashes are those of that game's levels.
+    you.game_seed = Options.seed;
+    you.props[SEEDED_GAME_KEY] = true;
+
+    initialise_item_descriptions();
+    initialise_branch_depths();
+    run_map_global_preludes();
+    run_map_local_preludes();
+    _dungeon_places();
+
+    hash_unique_items = you.unique_items;
+    hash_props = you.props;
+
+    vector<branch_type> hash_branches;
+    for (const level_id &lid : generated_levels)
+        if (hash_branches.empty() || hash_branches.back() != lid.branch)
+            hash_branches.push_back(lid.branch);
+
+#ifdef UNIX
+    const int workers = min(SysEnv.map_gen_workers,
+                            max(1, (int) hash_branches.size()));
+#else
+    const int workers = 1;
+#endif
+
+    clear_messages();
+    mpr("Hashing dungeon levels");
+    printf("Hashing %d level(s) over %d branch(es) for seed %x with %d "
+           "worker(s).\n", (int) generated_levels.size(), branch_count,
+           Options.seed, workers);
+    fflush(stdout);
+
+    const auto start = chrono::steady_clock::now();
+#ifdef UNIX
+    bool ok = workers > 1 ? _run_hash_workers(hash_branches, workers)
+                          : _hash_worker(hash_branches, 1, 0);
+#else
+    bool ok = _hash_worker(hash_branches, 1, 0);
+#endif
+    const chrono::duration<double> time = chrono::steady_clock::now() - start;
+
+    // Put the workers' levels back in dungeon order.
+    map<string, string> level_lines;
+    for (int i = 0; i < workers; ++i)
+    {
+        const string tmp = _level_hash_tmp_file(i);
+        for (const string &line : _read_lines(tmp))
+            level_lines[line.substr(0, line.find(' '))] = line;
+        unlink(tmp.c_str());
+    }
+
+    vector<string> lines;
+    for (const level_id &lid : generated_levels)
+    {
+        const string place = lid.describe();
+        if (level_lines.count(place))
+            lines.push_back(level_lines[place]);
+        else
+            ok = false;
+    }
+
+    const char *out_file = "levelhash.log";
+    FILE *outf = fopen(out_file, "w");
+    if (!outf)
+    {
+        printf("Can't write %s: %s\n", out_file, strerror(errno));
+        return false;
+    }
+    fprintf(outf, "# Level hashes for seed %x, built by %s\n", Options.seed,
+            Version::Long);
+    fprintf(outf, "# %d of %d levels in %.1f s with %d worker(s)\n",
+            (int) lines.size(), (int) generated_levels.size(), time.count(),
+            workers);
+    fprintf(outf, "# %-10s %8s %8s %8s %8s\n", "level", "terrain", "items",
+            "monsters", "vaults");
+    for (const string &line : lines)
+        fprintf(outf, "%s\n", line.c_str());
+    fclose(outf);
+    printf("Wrote %d level hash(es) to %s in %.1f s.\n", (int) lines.size(),
+           out_file, time.count());
+
+    if (!baseline_file.empty())
+        ok = _diff_level_hashes(lines, baseline_lines, baseline_file) && ok;
+    return ok;
+}
+
 #endif // DEBUG_STATISTICS
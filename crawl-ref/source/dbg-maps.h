@@ -17,4 +17,5 @@ void mapstat_report_map_veto(const string &message);
 void mapstat_generate_stats();
 bool mapstat_build_levels();
 bool mapstat_find_forced_map();
+bool mapstat_hash_levels();
 #endif
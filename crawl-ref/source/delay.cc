@@ -372,7 +372,10 @@ static command_type _get_running_command()
     {
         you.running.rest();
 
-#ifdef USE_TILE
+#ifdef USE_TILE_WEB
+        if (Options.rest_delay >= 0 && tiles.need_redraw())
+            tiles.redraw(true);
+#elif defined(USE_TILE)
         if (Options.rest_delay >= 0 && tiles.need_redraw())
             tiles.redraw();
 #endif
@@ -11,6 +11,7 @@
 #include "coord.h"
 #include "coordit.h"
 #include "files.h"
+#include "hash.h"
 #include "perlin.h"
 #include "terrain.h"
 
@@ -31,6 +32,51 @@ static dungeon_feature_type _pick_pseudorandom_wall(uint64_t val)
     return features[val%9];
 }
 
+void ProceduralLayout::sample(const vector<coord_def> &points,
+                              const uint32_t offset,
+                              vector<ProceduralSample> &out) const
+{
+    out.clear();
+    out.reserve(points.size());
+    for (const coord_def &p : points)
+        out.push_back((*this)(p, offset));
+}
+
+uint32_t layout_digest(const ProceduralLayout &layout, const coord_def &corner,
+                       int width, int height, uint32_t offset, bool batched)
+{
+    vector<coord_def> points;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            points.push_back(corner + coord_def(x, y));
+
+    vector<ProceduralSample> samples;
+    if (batched)
+        layout.sample(points, offset, samples);
+    else
+    {
+        for (const coord_def &p : points)
+            samples.push_back(layout(p, offset));
+    }
+
+    vector<uint32_t> data;
+    for (const ProceduralSample &sample : samples)
+    {
+        data.push_back(sample.feat());
+        data.push_back(sample.changepoint());
+    }
+    return hash32(data.data(), data.size() * sizeof(uint32_t));
+}
+
+static vector<worley::noise_datum> _worley_batch(const vector<double> &x,
+                                                 const vector<double> &y,
+                                                 const vector<double> &z)
+{
+    vector<worley::noise_datum> noise(x.size());
+    worley::noise(x.data(), y.data(), z.data(), x.size(), noise.data());
+    return noise;
+}
+
 ProceduralSample
 ColumnLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -65,6 +111,20 @@ static uint32_t _get_changepoint(const worley::noise_datum &n, const double scal
     return max(1, (int) floor((n.distance[1] - n.distance[0]) * scale) - 5);
 }
 
+// Which of the layouts the sample at p comes from, and where in that layout.
+size_t WorleyLayout::_pick(const coord_def &p, const worley::noise_datum &n,
+                           coord_def &pd) const
+{
+    const uint8_t size = layouts.size();
+    bool parity = n.id[0] % 4;
+    uint32_t id = n.id[0] / 4;
+    const uint8_t choice = parity
+        ? id % size
+        : min(id % size, (id / size) % size);
+    pd = p + id;
+    return (choice + seed) % size;
+}
+
 ProceduralSample
 WorleyLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -75,19 +135,56 @@ WorleyLayout::operator()(const coord_def &p, const uint32_t offset) const
     worley::noise_datum n = worley::noise(x, y, z + seed);
 
     const uint32_t changepoint = offset + _get_changepoint(n, offset_scale);
-    const uint8_t size = layouts.size();
-    bool parity = n.id[0] % 4;
-    uint32_t id = n.id[0] / 4;
-    const uint8_t choice = parity
-        ? id % size
-        : min(id % size, (id / size) % size);
-    const coord_def pd = p + id;
-    ProceduralSample sample = (*layouts[(choice + seed) % size])(pd, offset);
+    coord_def pd;
+    const size_t pick = _pick(p, n, pd);
+    ProceduralSample sample = (*layouts[pick])(pd, offset);
 
     return ProceduralSample(p, sample.feat(),
                 min(changepoint, sample.changepoint()));
 }
 
+void WorleyLayout::sample(const vector<coord_def> &points,
+                          const uint32_t offset,
+                          vector<ProceduralSample> &out) const
+{
+    const double offset_scale = 5000.0;
+    const double z = offset / offset_scale;
+    const size_t count = points.size();
+    vector<double> xs(count), ys(count), zs(count, z + seed);
+    for (size_t i = 0; i < count; ++i)
+    {
+        xs[i] = points[i].x / scale;
+        ys[i] = points[i].y / scale;
+    }
+    const vector<worley::noise_datum> noise = _worley_batch(xs, ys, zs);
+
+    // Sample each layout once, at all the points that picked it.
+    vector<size_t> picks(count);
+    vector<vector<coord_def>> picked(layouts.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+        coord_def pd;
+        picks[i] = _pick(points[i], noise[i], pd);
+        picked[picks[i]].push_back(pd);
+    }
+    vector<vector<ProceduralSample>> samples(layouts.size());
+    for (size_t l = 0; l < layouts.size(); ++l)
+        if (!picked[l].empty())
+            layouts[l]->sample(picked[l], offset, samples[l]);
+
+    vector<size_t> used(layouts.size(), 0);
+    out.clear();
+    out.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const ProceduralSample &sample = samples[picks[i]][used[picks[i]]++];
+        const uint32_t changepoint =
+            offset + _get_changepoint(noise[i], offset_scale);
+        out.emplace_back(points[i], sample.feat(),
+                         min(changepoint, sample.changepoint()));
+    }
+}
+
 ProceduralSample
 ChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -106,11 +203,39 @@ RoilingChaosLayout::operator()(const coord_def &p, const uint32_t offset) const
     double y = p.y;
     double z = offset / scale;
     worley::noise_datum n = worley::noise(x, y, z);
+    return _sample(p, offset, n);
+}
+
+ProceduralSample
+RoilingChaosLayout::_sample(const coord_def &p, const uint32_t offset,
+                            const worley::noise_datum &n) const
+{
+    const double scale = (density - 350) + 4800;
     const uint32_t changepoint = offset + _get_changepoint(n, scale);
     ProceduralSample sample = ChaosLayout(n.id[0] + seed, density)(p, offset);
     return ProceduralSample(p, sample.feat(), min(sample.changepoint(), changepoint));
 }
 
+void RoilingChaosLayout::sample(const vector<coord_def> &points,
+                                const uint32_t offset,
+                                vector<ProceduralSample> &out) const
+{
+    const double scale = (density - 350) + 4800;
+    const size_t count = points.size();
+    vector<double> xs(count), ys(count), zs(count, offset / scale);
+    for (size_t i = 0; i < count; ++i)
+    {
+        xs[i] = points[i].x;
+        ys[i] = points[i].y;
+    }
+    const vector<worley::noise_datum> noise = _worley_batch(xs, ys, zs);
+
+    out.clear();
+    out.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        out.push_back(_sample(points[i], offset, noise[i]));
+}
+
 ProceduralSample
 WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
@@ -118,6 +243,13 @@ WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
     double y = p.y;
     double z = offset / 3;
     worley::noise_datum n = worley::noise(x, y, z);
+    return _sample(p, offset, n);
+}
+
+ProceduralSample
+WastesLayout::_sample(const coord_def &p, const uint32_t offset,
+                      const worley::noise_datum &n) const
+{
     const uint32_t changepoint = offset + _get_changepoint(n, 3);
     ProceduralSample sample = ChaosLayout(n.id[0], 10)(p, offset);
     dungeon_feature_type feat = feat_is_solid(sample.feat())
@@ -125,41 +257,161 @@ WastesLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, min(sample.changepoint(), changepoint));
 }
 
+void WastesLayout::sample(const vector<coord_def> &points,
+                          const uint32_t offset,
+                          vector<ProceduralSample> &out) const
+{
+    const size_t count = points.size();
+    vector<double> xs(count), ys(count), zs(count, offset / 3);
+    for (size_t i = 0; i < count; ++i)
+    {
+        xs[i] = points[i].x;
+        ys[i] = points[i].y;
+    }
+    const vector<worley::noise_datum> noise = _worley_batch(xs, ys, zs);
+
+    out.clear();
+    out.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        out.push_back(_sample(points[i], offset, noise[i]));
+}
+
+static const double river_scale = 10000;
+static const double river_scalar = 90.0;
+
 ProceduralSample
 RiverLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
-    const double scale = 10000;
-    const double scalar = 90.0;
+    const double scalar = river_scalar;
     double x = (p.x + perlin::fBM(p.x/4.0, p.y/4.0, seed, 5) * 3) / scalar;
     double y = (p.y + perlin::fBM(p.x/4.0 + 3.7, p.y/4.0 + 1.9, seed + 4, 5) * 3) / scalar;
-    worley::noise_datum n = worley::noise(x, y, offset / scale + seed);
-    const uint32_t changepoint = offset + _get_changepoint(n, scale);
+    worley::noise_datum n = worley::noise(x, y, offset / river_scale + seed);
+
+    dungeon_feature_type feat;
+    uint32_t changepoint;
+    if (_river(p, offset, n, feat, changepoint))
+        return ProceduralSample(p, feat, changepoint);
+    return layout(p, offset);
+}
+
+// Is there river at p? If not, the underlying layout shows through.
+bool RiverLayout::_river(const coord_def &p, const uint32_t offset,
+                         const worley::noise_datum &n,
+                         dungeon_feature_type &feat,
+                         uint32_t &changepoint) const
+{
     if ((n.id[0] ^ n.id[1] ^ seed) % 4)
-        return layout(p, offset);
+        return false;
 
     double delta = n.distance[1] - n.distance[0];
-    if (delta < 1.5/scalar)
+    if (delta < 1.5/river_scalar)
     {
-        dungeon_feature_type feat = DNGN_SHALLOW_WATER;
+        feat = DNGN_SHALLOW_WATER;
         uint64_t hash = hash3(p.x, p.y, n.id[0] + seed);
         if (!(hash % 5))
             feat = DNGN_DEEP_WATER;
         if (!(hash % 23))
             feat = DNGN_TREE;
-        return ProceduralSample(p, feat, changepoint);
+        changepoint = offset + _get_changepoint(n, river_scale);
+        return true;
+    }
+    return false;
+}
+
+void RiverLayout::sample(const vector<coord_def> &points,
+                         const uint32_t offset,
+                         vector<ProceduralSample> &out) const
+{
+    const double scalar = river_scalar;
+    const size_t count = points.size();
+
+    // The two distortions are sampled along rows, where fBM() can share
+    // most of its octaves between neighbouring cells.
+    vector<double> ax(count), ay(count), az(count, seed);
+    vector<double> bx(count), by(count), bz(count, seed + 4);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const coord_def &p = points[i];
+        ax[i] = p.x/4.0;
+        ay[i] = p.y/4.0;
+        bx[i] = p.x/4.0 + 3.7;
+        by[i] = p.y/4.0 + 1.9;
+    }
+    vector<double> fa(count), fb(count);
+    perlin::fBM(ax.data(), ay.data(), az.data(), count, 5, fa.data());
+    perlin::fBM(bx.data(), by.data(), bz.data(), count, 5, fb.data());
+
+    vector<double> xs(count), ys(count),
+                   zs(count, offset / river_scale + seed);
+    for (size_t i = 0; i < count; ++i)
+    {
+        xs[i] = (points[i].x + fa[i] * 3) / scalar;
+        ys[i] = (points[i].y + fb[i] * 3) / scalar;
+    }
+    const vector<worley::noise_datum> noise = _worley_batch(xs, ys, zs);
+
+    vector<bool> river(count);
+    vector<dungeon_feature_type> feats(count, DNGN_FLOOR);
+    vector<uint32_t> changepoints(count, 0);
+    vector<coord_def> under;
+    for (size_t i = 0; i < count; ++i)
+    {
+        river[i] = _river(points[i], offset, noise[i], feats[i],
+                          changepoints[i]);
+        if (!river[i])
+            under.push_back(points[i]);
+    }
+    vector<ProceduralSample> under_samples;
+    layout.sample(under, offset, under_samples);
+
+    out.clear();
+    out.reserve(count);
+    size_t next = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (river[i])
+            out.emplace_back(points[i], feats[i], changepoints[i]);
+        else
+            out.push_back(under_samples[next++]);
     }
-    return layout(p, offset);
 }
 
 ProceduralSample
 NewAbyssLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
     const double scale = 1.0 / 3.2;
-    uint64_t base = hash3(p.x, p.y, seed);
     worley::noise_datum noise = worley::noise(
             p.x * scale,
             p.y * scale,
             offset / 1000.0);
+    return _sample(p, offset, noise);
+}
+
+void NewAbyssLayout::sample(const vector<coord_def> &points,
+                            const uint32_t offset,
+                            vector<ProceduralSample> &out) const
+{
+    const double scale = 1.0 / 3.2;
+    const size_t count = points.size();
+    vector<double> xs(count), ys(count), zs(count, offset / 1000.0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        xs[i] = points[i].x * scale;
+        ys[i] = points[i].y * scale;
+    }
+    const vector<worley::noise_datum> noise = _worley_batch(xs, ys, zs);
+
+    out.clear();
+    out.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        out.push_back(_sample(points[i], offset, noise[i]));
+}
+
+ProceduralSample
+NewAbyssLayout::_sample(const coord_def &p, const uint32_t offset,
+                        const worley::noise_datum &noise) const
+{
+    uint64_t base = hash3(p.x, p.y, seed);
     dungeon_feature_type feat = DNGN_FLOOR;
 
     int dist = noise.distance[0] * 100;
@@ -280,23 +532,67 @@ LevelLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, feat, offset + 4096);
 }
 
+void LevelLayout::sample(const vector<coord_def> &points,
+                         const uint32_t offset,
+                         vector<ProceduralSample> &out) const
+{
+    vector<coord_def> unseen;
+    for (const coord_def &p : points)
+        if (grid(clip(p)) == DNGN_UNSEEN)
+            unseen.push_back(p);
+    vector<ProceduralSample> unseen_samples;
+    layout.sample(unseen, offset, unseen_samples);
+
+    out.clear();
+    out.reserve(points.size());
+    size_t next = 0;
+    for (const coord_def &p : points)
+    {
+        const dungeon_feature_type feat = grid(clip(p));
+        if (feat == DNGN_UNSEEN)
+            out.push_back(unseen_samples[next++]);
+        else
+            out.emplace_back(p, feat, offset + 4096);
+    }
+}
+
 ProceduralSample
 NoiseLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
     return ProceduralSample(p, DNGN_FLOOR, offset + 4096);
 }
 
+const static WorleyFunction forest_base(0.32,0.4,0.5,0,0,0);
+const static WorleyFunction forest_offx(0.6,0.6,0.2,854.3,123.4,0.0);
+const static WorleyFunction forest_offy(0.6,0.6,0.2,123.2,3623.51,0.0);
+const static WorleyDistortFunction forest_func(forest_base,forest_offx,2.0,
+                                               forest_offy,1.5);
+
 ProceduralSample
 ForestLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
-    dungeon_feature_type feat = DNGN_FLOOR;
+    worley::noise_datum fn = forest_func.datum(p.x,p.y,offset);
+    return _sample(p, offset, fn);
+}
+
+void ForestLayout::sample(const vector<coord_def> &points,
+                          const uint32_t offset,
+                          vector<ProceduralSample> &out) const
+{
+    vector<worley::noise_datum> noise;
+    forest_func.datum(points, offset, noise);
 
-    const static WorleyFunction base(0.32,0.4,0.5,0,0,0);
-    const static WorleyFunction offx(0.6,0.6,0.2,854.3,123.4,0.0);
-    const static WorleyFunction offy(0.6,0.6,0.2,123.2,3623.51,0.0);
-    const static WorleyDistortFunction tfunc(base,offx,2.0,offy,1.5);
+    out.clear();
+    out.reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        out.push_back(_sample(points[i], offset, noise[i]));
+}
 
-    worley::noise_datum fn = tfunc.datum(p.x,p.y,offset);
+ProceduralSample
+ForestLayout::_sample(const coord_def &p, const uint32_t offset,
+                      const worley::noise_datum &fn) const
+{
+    dungeon_feature_type feat = DNGN_FLOOR;
 
     // Split the id into some 8-bit numbers to use for randomness
     uint8_t rand[2] = { (uint8_t)(fn.id[0] >> 24), (uint8_t)(fn.id[0] >> 16) };
@@ -344,36 +640,36 @@ ClampLayout::operator()(const coord_def &p, const uint32_t offset) const
     return ProceduralSample(p, sample.feat(), cp);
 }
 
+// Define various environmental functions based on noise. These factors
+// combine to determine what terrain gets drawn at a given coordinate.
+
+// Wetness gives us features like water, and optimal wetness will be required for plants
+const static SimplexFunction func_wet(0.5,0.5,3.0,3463.128,-3737.987,0,2);
+// Terrain height gives us mountains, rivers, ocean
+const static SimplexFunction func_height(0.3,0.3,1.0,7.543,2.123,0,4);
+// Temperament. Plants struggle to grow in extreme temperatures, and we only see lava in hot places.
+const static SimplexFunction func_hot(0.1,0.1,2.0,111.612,11.243,0,1);
+// Citification; areas with a high settle factor will tend  to feature "man"-made architecture
+// TODO: Citi/gentrification could use a worley layer instead (or a mix) to have better geometry
+// and stop things like wall types suddenly changing halfway through a city.
+const static SimplexFunction func_city(0.2,0.2,1.0,2.732,22.43,0,1);
+// Gentrification; some cities are richer than others, this affects wall types
+// but we can also choose what features to build inside the cities, influencing
+// features like statues, fountains, plants, regularness, and even monsters/loot
+const static SimplexFunction func_rich(0.05,0.05,1,9.543,5.543,0,1);
+
+// To create lots of lines everywhere that can often be perpendicular to other
+// features; for creating bridges, dividing walls
+const static WorleyFunction func_lateral(0.2,0.2,1,2000.543,1414.823,0);
+
+// Jitter needs to be completely random everywhere, so this can be used
+// instead of normal random methods:
+// if (jitter < (chance_in_1)) { ... }
+const static SimplexFunction func_jitter(10,10,0.5,1123.543,2451.143,0,5);
+
 ProceduralSample
 UnderworldLayout::operator()(const coord_def &p, const uint32_t offset) const
 {
-    // Define various environmental functions based on noise. These factors
-    // combine to determine what terrain gets drawn at a given coordinate.
-
-    // Wetness gives us features like water, and optimal wetness will be required for plants
-    const static SimplexFunction func_wet(0.5,0.5,3.0,3463.128,-3737.987,0,2);
-    // Terrain height gives us mountains, rivers, ocean
-    const static SimplexFunction func_height(0.3,0.3,1.0,7.543,2.123,0,4);
-    // Temperament. Plants struggle to grow in extreme temperatures, and we only see lava in hot places.
-    const static SimplexFunction func_hot(0.1,0.1,2.0,111.612,11.243,0,1);
-    // Citification; areas with a high settle factor will tend  to feature "man"-made architecture
-    // TODO: Citi/gentrification could use a worley layer instead (or a mix) to have better geometry
-    // and stop things like wall types suddenly changing halfway through a city.
-    const static SimplexFunction func_city(0.2,0.2,1.0,2.732,22.43,0,1);
-    // Gentrification; some cities are richer than others, this affects wall types
-    // but we can also choose what features to build inside the cities, influencing
-    // features like statues, fountains, plants, regularness, and even monsters/loot
-    const static SimplexFunction func_rich(0.05,0.05,1,9.543,5.543,0,1);
-
-    // To create lots of lines everywhere that can often be perpendicular to other
-    // features; for creating bridges, dividing walls
-    const static WorleyFunction func_lateral(0.2,0.2,1,2000.543,1414.823,0);
-
-    // Jitter needs to be completely random everywhere, so this can be used
-    // instead of normal random methods:
-    // if (jitter < (chance_in_1)) { ... }
-    const static SimplexFunction func_jitter(10,10,0.5,1123.543,2451.143,0,5);
-
     // Compute all our environment factors at the current spot
     double wet = func_wet(p, offset);
     double height = func_height(p, offset);
@@ -383,6 +679,36 @@ UnderworldLayout::operator()(const coord_def &p, const uint32_t offset) const
     double lateral = func_lateral(p, offset);
     double jitter = func_jitter(p, offset);
 
+    return _sample(p, offset, wet, height, hot, city, rich, lateral, jitter);
+}
+
+void UnderworldLayout::sample(const vector<coord_def> &points,
+                              const uint32_t offset,
+                              vector<ProceduralSample> &out) const
+{
+    vector<double> wet, height, hot, city, rich, lateral, jitter;
+    func_wet(points, offset, wet);
+    func_height(points, offset, height);
+    func_hot(points, offset, hot);
+    func_city(points, offset, city);
+    func_rich(points, offset, rich);
+    func_lateral(points, offset, lateral);
+    func_jitter(points, offset, jitter);
+
+    out.clear();
+    out.reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        out.push_back(_sample(points[i], offset, wet[i], height[i], hot[i],
+                              city[i], rich[i], lateral[i], jitter[i]));
+    }
+}
+
+ProceduralSample
+UnderworldLayout::_sample(const coord_def &p, const uint32_t offset,
+                          double wet, double height, double hot, double city,
+                          double rich, double lateral, double jitter) const
+{
     // TODO: The abyss doesn't support all of these yet but would be nice if:
     //  * Clusters of plants around water edge
     //  * Hot and wet areas are "tropical" with plants/trees (and steam)
@@ -571,6 +897,28 @@ double SimplexFunction::operator()(double x, double y, double z) const
     return perlin::fBM(hx, hy, hz, octaves) / 2.0 + 0.5;
 }
 
+void SimplexFunction::operator()(const vector<coord_def> &points,
+                                 const uint32_t offset,
+                                 vector<double> &out) const
+{
+    const size_t count = points.size();
+    const double z = offset;
+    vector<double> hx(count), hy(count),
+                   hz(count, (z / (double)10000 + seed_z) * scale_z);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double x = points[i].x;
+        const double y = points[i].y;
+        hx[i] = (x / (double)10 + seed_x) * scale_x;
+        hy[i] = (y / (double)10 + seed_y) * scale_y;
+    }
+
+    out.resize(count);
+    perlin::fBM(hx.data(), hy.data(), hz.data(), count, octaves, out.data());
+    for (double &value : out)
+        value = value / 2.0 + 0.5;
+}
+
 double WorleyFunction::operator()(const coord_def &p, const uint32_t offset) const
 {
     return WorleyFunction::operator()(p.x,p.y,offset);
@@ -582,6 +930,25 @@ double WorleyFunction::operator()(double x, double y, double z) const
     return d.distance[1]-d.distance[0];
 }
 
+void WorleyFunction::operator()(const vector<coord_def> &points,
+                                const uint32_t offset,
+                                vector<double> &out) const
+{
+    const size_t count = points.size();
+    vector<double> xs(count), ys(count), zs(count, offset);
+    for (size_t i = 0; i < count; ++i)
+    {
+        xs[i] = points[i].x;
+        ys[i] = points[i].y;
+    }
+    vector<worley::noise_datum> d;
+    datum(xs, ys, zs, d);
+
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        out[i] = d[i].distance[1]-d[i].distance[0];
+}
+
 worley::noise_datum WorleyFunction::datum(double x, double y, double z) const
 {
     double hx = (x * (double)0.8 + seed_x) * scale_x;
@@ -590,6 +957,19 @@ worley::noise_datum WorleyFunction::datum(double x, double y, double z) const
     return worley::noise(hx, hy, hz);
 }
 
+void WorleyFunction::datum(vector<double> x, vector<double> y,
+                           vector<double> z,
+                           vector<worley::noise_datum> &out) const
+{
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        x[i] = (x[i] * (double)0.8 + seed_x) * scale_x;
+        y[i] = (y[i] * (double)0.8 + seed_y) * scale_y;
+        z[i] = (z[i] * (double)0.0008 + seed_z) * scale_z;
+    }
+    out = _worley_batch(x, y, z);
+}
+
 double DistortFunction::operator()(double x, double y, double z) const
 {
     double offx = off_x(x,y,z);
@@ -603,3 +983,19 @@ worley::noise_datum WorleyDistortFunction::datum(double x, double y, double z) c
     double offy = off_y(x,y,z);
     return wbase.datum(x+offx,y+offy,z);
 }
+
+void WorleyDistortFunction::datum(const vector<coord_def> &points,
+                                  const uint32_t offset,
+                                  vector<worley::noise_datum> &out) const
+{
+    const size_t count = points.size();
+    vector<double> xs(count), ys(count), zs(count, offset);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double x = points[i].x;
+        const double y = points[i].y;
+        xs[i] = x + off_x(x, y, zs[i]);
+        ys[i] = y + off_y(x, y, zs[i]);
+    }
+    wbase.datum(xs, ys, zs, out);
+}
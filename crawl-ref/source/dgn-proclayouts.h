@@ -54,9 +54,20 @@ class ProceduralLayout
     public:
         virtual ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const = 0;
+        // Replace out with the samples at each of points. The samples are
+        // exactly what operator() would give, but layouts built on noise
+        // share work between the points, so sampling a whole block this way
+        // is faster than going cell by cell.
+        virtual void sample(const vector<coord_def> &points,
+            const uint32_t offset, vector<ProceduralSample> &out) const;
         virtual ~ProceduralLayout() { }
 };
 
+// A hash of a layout's samples over a width x height block, taken one cell
+// at a time or in a batch; for checking that layouts don't change.
+uint32_t layout_digest(const ProceduralLayout &layout, const coord_def &corner,
+                       int width, int height, uint32_t offset, bool batched);
+
 // Geometric layout that generates columns with width cw, col spacing cs, row width rw, and row spacing rs.
 // cw is the only required parameter and will generate uniform columns.
 class ColumnLayout : public ProceduralLayout
@@ -97,7 +108,12 @@ class WorleyLayout : public ProceduralLayout
             seed(_seed), layouts(_layouts), scale(_scale) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
+        size_t _pick(const coord_def &p, const worley::noise_datum &n,
+            coord_def &pd) const;
+
         const uint32_t seed;
         const vector<const ProceduralLayout*> layouts;
         const float scale;
@@ -129,7 +145,12 @@ class RoilingChaosLayout : public ProceduralLayout
             seed(_seed), density(_density) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
+        ProceduralSample _sample(const coord_def &p, const uint32_t offset,
+            const worley::noise_datum &n) const;
+
         const uint32_t seed;
         const uint32_t density;
 };
@@ -141,6 +162,11 @@ class WastesLayout : public ProceduralLayout
         WastesLayout() { };
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
+    private:
+        ProceduralSample _sample(const coord_def &p, const uint32_t offset,
+            const worley::noise_datum &n) const;
 };
 
 class RiverLayout : public ProceduralLayout
@@ -150,7 +176,13 @@ class RiverLayout : public ProceduralLayout
             seed(_seed), layout(_layout) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
+        bool _river(const coord_def &p, const uint32_t offset,
+            const worley::noise_datum &n, dungeon_feature_type &feat,
+            uint32_t &changepoint) const;
+
         const uint32_t seed;
         const ProceduralLayout &layout;
 };
@@ -162,7 +194,12 @@ class NewAbyssLayout : public ProceduralLayout
         NewAbyssLayout(uint32_t _seed) : seed(_seed) {}
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
+        ProceduralSample _sample(const coord_def &p, const uint32_t offset,
+            const worley::noise_datum &noise) const;
+
         const uint32_t seed;
 };
 
@@ -175,6 +212,8 @@ class LevelLayout : public ProceduralLayout
             const ProceduralLayout &_layout);
         ProceduralSample operator()(const coord_def &p,
             const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
     private:
         feature_grid grid;
         uint32_t seed;
@@ -219,6 +258,11 @@ class ForestLayout : public NoiseLayout
     public:
         ForestLayout() { };
         ProceduralSample operator()(const coord_def &p, const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
+    private:
+        ProceduralSample _sample(const coord_def &p, const uint32_t offset,
+            const worley::noise_datum &fn) const;
 };
 
 class UnderworldLayout : public NoiseLayout
@@ -226,6 +270,12 @@ class UnderworldLayout : public NoiseLayout
     public:
         UnderworldLayout() { };
         ProceduralSample operator()(const coord_def &p, const uint32_t offset = 0) const override;
+        void sample(const vector<coord_def> &points, const uint32_t offset,
+            vector<ProceduralSample> &out) const override;
+    private:
+        ProceduralSample _sample(const coord_def &p, const uint32_t offset,
+            double wet, double height, double hot, double city, double rich,
+            double lateral, double jitter) const;
 };
 
 // ProceduralFunctions abstract a noise calculation for x,y,z coordinates (which could
@@ -251,6 +301,8 @@ class SimplexFunction : public ProceduralFunction
 
         double operator()(const coord_def &p, const uint32_t offset) const;
         double operator()(double x, double y, double z) const;
+        void operator()(const vector<coord_def> &points,
+                        const uint32_t offset, vector<double> &out) const;
 
     private:
         const double scale_x;
@@ -271,7 +323,11 @@ class WorleyFunction : public ProceduralFunction
               seed_x(_seed_x), seed_y(_seed_y), seed_z(_seed_z) { };
         double operator()(const coord_def &p, const uint32_t offset) const;
         double operator()(double x, double y, double z) const;
+        void operator()(const vector<coord_def> &points,
+                        const uint32_t offset, vector<double> &out) const;
         worley::noise_datum datum(double x, double y, double z) const;
+        void datum(vector<double> x, vector<double> y, vector<double> z,
+                   vector<worley::noise_datum> &out) const;
 
     private:
         const double scale_x;
@@ -308,6 +364,8 @@ class WorleyDistortFunction : public DistortFunction
                               const ProceduralFunction &_offy, double _scaley)
             : DistortFunction(_base,_offx,_scalex,_offy,_scaley), wbase(_base) { };
         worley::noise_datum datum(double x, double y, double z) const;
+        void datum(const vector<coord_def> &points, const uint32_t offset,
+                   vector<worley::noise_datum> &out) const;
 
     private:
         const WorleyFunction &wbase;
@@ -0,0 +1,355 @@
+/**
+ * @file
+ * @brief Phase timing and veto telemetry for the level builder.
+ *
+ * The builder always keeps track of the phase it is in and of the reasons
+ * for its recent vetoes, so that crash dumps can say what it was doing.
+ * Timing is only done once -builder-profile has turned it on; a report of
+ * where level generation spent its time, and on which levels, layouts and
+ * vaults, is then written when crawl exits.
+**/
+
+#include "AppHdr.h"
+
+#include "dgn-profile.h"
+
+#include <chrono>
+
+#include "dungeon.h"
+#include "env.h"
+#include "mapdef.h"
+#include "state.h"
+#include "stringutil.h"
+
+typedef chrono::steady_clock profile_clock;
+typedef profile_clock::duration profile_time;
+
+static const char *phase_names[] =
+{
+    "other", "layout", "primary vault", "minivaults", "items", "monsters",
+    "connectivity", "Lua validation", "epilogues",
+};
+COMPILE_CHECK(ARRAYSZ(phase_names) == NUM_BUILDER_PHASES);
+
+struct level_profile
+{
+    int builds = 0;
+    int failures = 0;
+    int attempts = 0;
+    int vetoes = 0;
+    profile_time phases[NUM_BUILDER_PHASES] = {};
+
+    profile_time total() const
+    {
+        profile_time sum = profile_time::zero();
+        for (const profile_time &phase : phases)
+            sum += phase;
+        return sum;
+    }
+};
+
+// Layouts and vaults.
+struct build_profile
+{
+    int tries = 0;
+    int vetoes = 0;
+    profile_time time = profile_time::zero();
+};
+
+static bool profiling = false;
+static string report_filename;
+
+static builder_phase current_phase = BPHASE_OTHER;
+static profile_clock::time_point phase_start;
+
+// The level being built, or the last one built, and its vetoes so far.
+static bool have_level = false;
+static level_id building;
+static int attempt = 0;
+static vector<string> vetoes;
+
+static level_profile *current_profile = nullptr;
+static profile_clock::time_point attempt_start;
+
+static map<level_id, level_profile> level_profiles;
+static map<string, build_profile> layout_profiles;
+static map<string, build_profile> vault_profiles;
+static map<string, int> veto_counts;
+
+struct vault_timer
+{
+    string name;
+    profile_clock::time_point start;
+};
+static vector<vault_timer> vault_timers;
+
+static double _ms(profile_time time)
+{
+    return chrono::duration<double, milli>(time).count();
+}
+
+// Charge the time since the last phase change to the current phase.
+static void _charge_phase()
+{
+    if (!current_profile)
+        return;
+
+    const profile_clock::time_point now = profile_clock::now();
+    current_profile->phases[current_phase] += now - phase_start;
+    phase_start = now;
+}
+
+builder_phase_scope::builder_phase_scope(builder_phase phase)
+    : outer(current_phase)
+{
+    _charge_phase();
+    current_phase = phase;
+}
+
+builder_phase_scope::~builder_phase_scope()
+{
+    _charge_phase();
+    current_phase = outer;
+}
+
+builder_vault_scope::builder_vault_scope(const string &vault_name)
+    : active(profiling)
+{
+    if (active)
+        vault_timers.push_back({ vault_name, profile_clock::now() });
+}
+
+builder_vault_scope::~builder_vault_scope()
+{
+    if (!active)
+        return;
+
+    const vault_timer &timer = vault_timers.back();
+    build_profile &vault = vault_profiles[timer.name];
+    ++vault.tries;
+    vault.time += profile_clock::now() - timer.start;
+    vault_timers.pop_back();
+}
+
+void builder_profile_enable(const string &report_file)
+{
+    profiling = true;
+    report_filename = report_file;
+}
+
+void builder_profile_level_start()
+{
+    have_level = true;
+    building = level_id::current();
+    attempt = 0;
+    vetoes.clear();
+
+    if (!profiling)
+        return;
+
+    current_profile = &level_profiles[building];
+    phase_start = profile_clock::now();
+}
+
+void builder_profile_attempt_start()
+{
+    ++attempt;
+    if (profiling)
+        attempt_start = profile_clock::now();
+}
+
+void builder_profile_veto(const string &reason)
+{
+    vetoes.push_back(make_stringf("attempt %d: %s", attempt, reason.c_str()));
+
+    if (!profiling)
+        return;
+
+    ++veto_counts[reason];
+    // Blame every vault on the level for the retry; the ones that are
+    // really at fault will stand out by how often they are blamed.
+    for (const auto &vault : env.level_vaults)
+        ++vault_profiles[vault->map.name].vetoes;
+}
+
+static string _attempt_layout(bool success)
+{
+    // A successful build has already cleared the layout types.
+    string layout;
+    if (success && env.properties.exists(LAYOUT_TYPE_KEY))
+        layout = env.properties[LAYOUT_TYPE_KEY].get_string();
+    else
+    {
+        layout = comma_separated_line(env.level_layout_types.begin(),
+                                      env.level_layout_types.end(), ", ");
+    }
+    return layout.empty() ? "(none)" : layout;
+}
+
+void builder_profile_attempt_end(bool success)
+{
+    if (!profiling)
+        return;
+
+    _charge_phase();
+    ++current_profile->attempts;
+    if (!success)
+        ++current_profile->vetoes;
+
+    build_profile &layout = layout_profiles[_attempt_layout(success)];
+    ++layout.tries;
+    if (!success)
+        ++layout.vetoes;
+    layout.time += profile_clock::now() - attempt_start;
+}
+
+void builder_profile_level_end(bool built)
+{
+    if (!profiling)
+        return;
+
+    _charge_phase();
+    if (built)
+        ++current_profile->builds;
+    else
+        ++current_profile->failures;
+}
+
+template <typename T, typename K>
+static vector<pair<K, T>> _sorted_by(const map<K, T> &profiles,
+                                     function<double(const T&)> key)
+{
+    vector<pair<K, T>> sorted(profiles.begin(), profiles.end());
+    stable_sort(sorted.begin(), sorted.end(),
+                [&key](const pair<K, T> &a, const pair<K, T> &b)
+                {
+                    return key(a.second) > key(b.second);
+                });
+    return sorted;
+}
+
+static void _write_build_profiles(FILE *outf,
+                                  const map<string, build_profile> &profiles)
+{
+    fprintf(outf, "%10s %6s %6s %10s  %s\n",
+            "total ms", "tries", "vetoes", "mean ms", "name");
+    for (const auto &entry : _sorted_by<build_profile, string>(profiles,
+             [](const build_profile &p) { return _ms(p.time); }))
+    {
+        const build_profile &p = entry.second;
+        fprintf(outf, "%10.1f %6d %6d %10.2f  %s\n",
+                _ms(p.time), p.tries, p.vetoes,
+                _ms(p.time) / max(1, p.tries), entry.first.c_str());
+    }
+}
+
+/**
+ * Write the report asked for with -builder-profile, if any.
+ */
+void builder_profile_write_report()
+{
+    if (!profiling)
+        return;
+
+    FILE *outf = fopen(report_filename.c_str(), "w");
+    if (!outf)
+    {
+        fprintf(stderr, "Unable to write builder profile to %s: %s\n",
+                report_filename.c_str(), strerror(errno));
+        return;
+    }
+
+    level_profile all;
+    for (const auto &entry : level_profiles)
+    {
+        const level_profile &level = entry.second;
+        all.builds += level.builds;
+        all.failures += level.failures;
+        all.attempts += level.attempts;
+        all.vetoes += level.vetoes;
+        for (int i = 0; i < NUM_BUILDER_PHASES; ++i)
+            all.phases[i] += level.phases[i];
+    }
+    const double total_ms = _ms(all.total());
+
+    fprintf(outf, "Level Builder Profile\n\n");
+    fprintf(outf, "Levels built: %d, failed: %d, attempts: %d, vetoes: %d\n",
+            all.builds, all.failures, all.attempts, all.vetoes);
+    fprintf(outf, "Total time: %.1f ms\n", total_ms);
+
+    fprintf(outf, "\nTime by phase:\n");
+    for (int i = 0; i < NUM_BUILDER_PHASES; ++i)
+    {
+        const double ms = _ms(all.phases[i]);
+        fprintf(outf, "%10.1f %5.1f%%  %s\n", ms,
+                total_ms > 0 ? 100.0 * ms / total_ms : 0.0, phase_names[i]);
+    }
+
+    fprintf(outf, "\nLevels by total time:\n");
+    fprintf(outf, "%10s %6s %6s %6s %6s %10s  %s\n", "total ms", "builds",
+            "failed", "tries", "vetoes", "mean ms", "level");
+    for (const auto &entry : _sorted_by<level_profile, level_id>(
+             level_profiles,
+             [](const level_profile &p) { return _ms(p.total()); }))
+    {
+        const level_profile &p = entry.second;
+        const int built = max(1, p.builds + p.failures);
+        fprintf(outf, "%10.1f %6d %6d %6d %6d %10.2f  %s\n",
+                _ms(p.total()), p.builds, p.failures, p.attempts, p.vetoes,
+                _ms(p.total()) / built, entry.first.describe().c_str());
+    }
+
+    fprintf(outf, "\nLayout types by total attempt time:\n");
+    _write_build_profiles(outf, layout_profiles);
+
+    fprintf(outf, "\nVaults by total placement time (vetoes are vetoed "
+                  "attempts the vault was part of):\n");
+    _write_build_profiles(outf, vault_profiles);
+
+    fprintf(outf, "\nVeto reasons:\n");
+    for (const auto &entry : _sorted_by<int, string>(veto_counts,
+             [](const int &count) { return count; }))
+    {
+        fprintf(outf, "%6d  %s\n", entry.second, entry.first.c_str());
+    }
+
+    fclose(outf);
+}
+
+/**
+ * Describe the level being built, or the last one built, for a crash dump.
+ */
+void builder_profile_dump(FILE *file)
+{
+    if (!have_level)
+        return;
+
+    fprintf(file, "Level builder:\n");
+    if (crawl_state.generating_level)
+    {
+        fprintf(file, "Building %s, attempt %d, phase: %s\n",
+                building.describe().c_str(), attempt,
+                phase_names[current_phase]);
+    }
+    else
+    {
+        fprintf(file, "Last built %s in %d attempt%s\n",
+                building.describe().c_str(), attempt,
+                attempt == 1 ? "" : "s");
+    }
+
+    for (const string &veto : vetoes)
+        fprintf(file, "    veto on %s\n", veto.c_str());
+
+    if (current_profile)
+    {
+        fprintf(file, "Phase times so far for %s:\n",
+                building.describe().c_str());
+        for (int i = 0; i < NUM_BUILDER_PHASES; ++i)
+        {
+            fprintf(file, "%10.1f ms  %s\n", _ms(current_profile->phases[i]),
+                    phase_names[i]);
+        }
+    }
+    fprintf(file, "\n");
+}
@@ -0,0 +1,55 @@
+/**
+ * @file
+ * @brief Phase timing and veto telemetry for the level builder.
+**/
+
+#pragma once
+
+enum builder_phase
+{
+    BPHASE_OTHER,           // Builder code outside any of the phases below.
+    BPHASE_LAYOUT,
+    BPHASE_PRIMARY_VAULT,
+    BPHASE_MINIVAULTS,
+    BPHASE_ITEMS,
+    BPHASE_MONSTERS,
+    BPHASE_CONNECTIVITY,
+    BPHASE_LUA_VALIDATION,
+    BPHASE_EPILOGUE,
+    NUM_BUILDER_PHASES
+};
+
+// Charges the time until it goes out of scope to the given builder phase,
+// less the time spent in any phases nested inside it.
+class builder_phase_scope
+{
+public:
+    builder_phase_scope(builder_phase phase);
+    ~builder_phase_scope();
+
+private:
+    builder_phase outer;
+};
+
+// Charges the time until it goes out of scope to the named vault, including
+// the time spent placing any vaults it places in turn.
+class builder_vault_scope
+{
+public:
+    builder_vault_scope(const string &vault_name);
+    ~builder_vault_scope();
+
+private:
+    bool active;
+};
+
+void builder_profile_enable(const string &report_file);
+
+void builder_profile_level_start();
+void builder_profile_attempt_start();
+void builder_profile_veto(const string &reason);
+void builder_profile_attempt_end(bool success);
+void builder_profile_level_end(bool built);
+
+void builder_profile_write_report();
+void builder_profile_dump(FILE *file);
@@ -1304,7 +1304,7 @@ bool direction_chooser::pickup_item()
 {
     item_info *ii = 0;
     if (in_bounds(target()))
-        ii = env.map_knowledge(target()).item();
+        ii = env.map_knowledge(target()).edit_item();
     if (!ii || !ii->is_valid(true))
     {
         mprf(MSGCH_EXAMINE_FILTER, "You can't see any item there.");
@@ -2147,7 +2147,7 @@ void full_describe_square(const coord_def &c, bool cleanup)
         // First priority: monsters.
         describe_monsters(*mi);
     }
-    else if (item_info *obj = env.map_knowledge(c).item())
+    else if (item_info *obj = env.map_knowledge(c).edit_item())
     {
         // Second priority: objects.
         describe_item(*obj);
@@ -20,6 +20,36 @@ static int dlua_compiled_chunk_writer(lua_State *ls, const void *p,
     return 0;
 }
 
+// Functions loaded by dlua_chunk::load_cached(), keyed by compiled chunk.
+#define CHUNK_CACHE_KEY "dlua_chunk_cache"
+
+// Chunks actually loaded by the interpreter, and loads that the cache saved.
+static int chunk_loads = 0;
+static int chunk_cache_hits = 0;
+
+// Push the chunk cache table, creating it if necessary.
+static void _push_chunk_cache(lua_State *ls)
+{
+    lua_getfield(ls, LUA_REGISTRYINDEX, CHUNK_CACHE_KEY);
+    if (lua_istable(ls, -1))
+        return;
+
+    lua_pop(ls, 1);
+    lua_newtable(ls);
+    lua_pushvalue(ls, -1);
+    lua_setfield(ls, LUA_REGISTRYINDEX, CHUNK_CACHE_KEY);
+}
+
+// Cache the function on top of the stack, leaving it there.
+static void _cache_chunk_function(lua_State *ls, const string &compiled)
+{
+    _push_chunk_cache(ls);
+    lua_pushlstring(ls, compiled.data(), compiled.size());
+    lua_pushvalue(ls, -3);
+    lua_rawset(ls, -3);
+    lua_pop(ls, 1);
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // dlua_chunk
 
@@ -148,6 +178,7 @@ int dlua_chunk::check_op(CLua &interp, int err)
 
 int dlua_chunk::load(CLua &interp)
 {
+    ++chunk_loads;
     if (!compiled.empty())
     {
         return check_op(interp,
@@ -177,6 +208,50 @@ int dlua_chunk::load(CLua &interp)
     return err;
 }
 
+/**
+ * Like load(), but reuse the function from an earlier load of the same
+ * compiled chunk if there was one, which saves undumping it again.
+ *
+ * The function is shared, so this is only for chunks that don't rely on
+ * the function's state between calls: map chunks are fine, since
+ * dgn_run_map sets their environment every time they are run.
+ */
+int dlua_chunk::load_cached(CLua &interp)
+{
+    if (!compiled.empty())
+    {
+        _push_chunk_cache(interp);
+        lua_pushlstring(interp, compiled.data(), compiled.size());
+        lua_rawget(interp, -2);
+        lua_remove(interp, -2);
+        if (!lua_isnil(interp, -1))
+        {
+            ++chunk_cache_hits;
+            return 0;
+        }
+        lua_pop(interp, 1);
+    }
+
+    const int err = load(interp);
+    if (!err)
+        _cache_chunk_function(interp, compiled);
+    return err;
+}
+
+// Forget every function load_cached() has loaded, e.g. because the maps
+// have been stripped or reread.
+void dlua_chunk::flush_cache(CLua &interp)
+{
+    lua_pushnil(interp);
+    lua_setfield(interp, LUA_REGISTRYINDEX, CHUNK_CACHE_KEY);
+}
+
+void dlua_chunk::cache_counts(int &loads, int &hits)
+{
+    loads = chunk_loads;
+    hits = chunk_cache_hits;
+}
+
 int dlua_chunk::run(CLua &interp)
 {
     int err = load(interp);
@@ -56,6 +56,7 @@ public:
     void set_chunk(const string &s);
 
     int load(CLua &interp);
+    int load_cached(CLua &interp);
     int run(CLua &interp);
     int load_call(CLua &interp, const char *function);
     void set_file(const string &s);
@@ -70,6 +71,9 @@ public:
 
     void write(writer&) const;
     void read(reader&);
+
+    static void flush_cache(CLua &interp);
+    static void cache_counts(int &loads, int &hits);
 };
 
 void init_dungeon_lua();
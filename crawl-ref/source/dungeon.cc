@@ -34,6 +34,7 @@
 #include "dgn-height.h"
 #include "dgn-labyrinth.h"
 #include "dgn-overview.h"
+#include "dgn-profile.h"
 #include "dgn-shoals.h"
 #include "end.h"
 #include "english.h"
@@ -71,6 +72,7 @@
 #include "tileview.h"
 #include "timed-effects.h"
 #include "traps.h"
+#include "unwind.h"
 
 #ifdef DEBUG_DIAGNOSTICS
 #define DEBUG_TEMPLES
@@ -296,6 +298,7 @@ bool builder(bool enable_random_maps, dungeon_feature_type dest_stairs_type)
     temp_unique_items = you.unique_items;
 
     unwind_bool levelgen(crawl_state.generating_level, true);
+    builder_profile_level_start();
 
     // N tries to build the level, after which we bail with a capital B.
     int tries = 50;
@@ -306,13 +309,16 @@ bool builder(bool enable_random_maps, dungeon_feature_type dest_stairs_type)
         if (tries < 5)
             enable_random_maps = false;
 
+        builder_profile_attempt_start();
         try
         {
             if (_build_level_vetoable(enable_random_maps, dest_stairs_type))
             {
+                builder_profile_attempt_end(true);
                 for (monster_iterator mi; mi; ++mi)
                     gozag_set_bribe(*mi);
 
+                builder_profile_level_end(true);
                 return true;
             }
         }
@@ -320,14 +326,20 @@ bool builder(bool enable_random_maps, dungeon_feature_type dest_stairs_type)
         {
             mprf(MSGCH_ERROR, "Failed to load map, reloading all maps (%s).",
                  mload.what());
+            builder_profile_veto(string("failed to load map: ")
+                                 + mload.what());
             reread_maps();
         }
+        builder_profile_attempt_end(false);
 
         you.uniq_map_tags  = uniq_tags;
         you.uniq_map_names = uniq_names;
     }
 
-    if (!crawl_state.map_stat_gen && !crawl_state.obj_stat_gen)
+    builder_profile_level_end(false);
+
+    if (!crawl_state.map_stat_gen && !crawl_state.obj_stat_gen
+        && !crawl_state.level_hash_gen && !crawl_state.pregenerating_levels)
     {
         // Failed to build level, bail out.
         if (crawl_state.need_save)
@@ -370,8 +382,10 @@ static bool _build_level_vetoable(bool enable_random_maps,
 #ifdef DEBUG_STATISTICS
         mapstat_report_map_veto(e.what());
 #endif
+        builder_profile_veto(e.what());
         // try not to lose any ghosts that have been placed
-        save_ghosts(ghost_demon::find_ghosts(false), false, false);
+        if (!crawl_state.pregenerating_levels)
+            save_ghosts(ghost_demon::find_ghosts(false), false, false);
         return false;
     }
 
@@ -380,6 +394,7 @@ static bool _build_level_vetoable(bool enable_random_maps,
     if (crawl_state.game_standard_levelgen()
         && !_valid_dungeon_level())
     {
+        builder_profile_veto("level not stair-connected");
         return false;
     }
 
@@ -414,13 +429,17 @@ static bool _build_level_vetoable(bool enable_random_maps,
 
     // Call the branch epilogue, if any.
     if (!branch_epilogues[you.where_are_you].empty())
+    {
+        builder_phase_scope phase(BPHASE_EPILOGUE);
         if (!dlua.callfn(branch_epilogues[you.where_are_you].c_str(), 0, 0))
         {
             mprf(MSGCH_ERROR, "branch epilogue for %s failed: %s",
                               level_id::current().describe().c_str(),
                               dlua.error.c_str());
+            builder_profile_veto("branch epilogue failed: " + dlua.error);
             return false;
         }
+    }
 
     // Discard any Lua chunks we loaded.
     strip_all_maps();
@@ -752,50 +771,14 @@ static bool _dgn_square_is_passable(const coord_def &c)
     return !(env.level_map_mask(c) & MMT_OPAQUE) && dgn_square_travel_ok(c);
 }
 
-static inline void _dgn_point_record_stub(const coord_def &) { }
-
-template <class point_record>
-static bool _dgn_fill_zone(
-    const coord_def &start, int zone,
-    point_record &record_point,
-    bool (*passable)(const coord_def &) = _dgn_square_is_passable,
-    bool (*iswanted)(const coord_def &) = nullptr)
+// The cells of the level that pass test.
+static map_bitmask _dgn_cell_mask(bool (*test)(const coord_def &))
 {
-    bool ret = false;
-    list<coord_def> points[2];
-    int cur = 0;
-
-    // No bounds checks, assuming the level has at least one layer of
-    // rock border.
-
-    for (points[cur].push_back(start); !points[cur].empty();)
-    {
-        for (const auto &c : points[cur])
-        {
-            travel_point_distance[c.x][c.y] = zone;
-
-            if (iswanted && iswanted(c))
-                ret = true;
-
-            for (adjacent_iterator ai(c); ai; ++ai)
-            {
-                const coord_def& cp = *ai;
-                if (!map_bounds(cp)
-                    || travel_point_distance[cp.x][cp.y] || !passable(cp))
-                {
-                    continue;
-                }
-
-                travel_point_distance[cp.x][cp.y] = zone;
-                record_point(cp);
-                points[!cur].push_back(cp);
-            }
-        }
-
-        points[cur].clear();
-        cur = !cur;
-    }
-    return ret;
+    map_bitmask mask;
+    for (rectangle_iterator ri(0); ri; ++ri)
+        if (test(*ri))
+            mask.set(*ri);
+    return mask;
 }
 
 static bool _is_perm_down_stair(const coord_def &c)
@@ -905,81 +888,48 @@ static bool _is_exit_stair(const coord_def &c)
 //
 // If fill is non-zero, it fills any disconnected regions with fill.
 //
-static int _process_disconnected_zones(int x1, int y1, int x2, int y2,
-                                       bool choose_stairless,
-                                       dungeon_feature_type fill)
+int dgn_count_disconnected_zones(bool choose_stairless,
+                                 dungeon_feature_type fill)
 {
-    memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
+    const map_bitmask passable = _dgn_cell_mask(_dgn_square_is_passable);
+    map_bitmask stairs;
+    if (choose_stairless)
+    {
+        stairs = _dgn_cell_mask(at_branch_bottom() ? _is_upwards_exit_stair
+                                                   : _is_exit_stair);
+    }
+    map_bitmask vaults;
+    if (fill)
+    {
+        for (rectangle_iterator ri(0); ri; ++ri)
+            if (map_masked(*ri, MMT_VAULT))
+                vaults.set(*ri);
+    }
+
     int nzones = 0;
     int ngood = 0;
-    for (int y = y1; y <= y2 ; ++y)
+    for (map_zone_iterator zi(passable); zi; ++zi)
     {
-        for (int x = x1; x <= x2; ++x)
-        {
-            if (!map_bounds(x, y)
-                || travel_point_distance[x][y]
-                || !_dgn_square_is_passable(coord_def(x, y)))
-            {
-                continue;
-            }
+        ++nzones;
 
-            const bool found_exit_stair =
-                _dgn_fill_zone(coord_def(x, y), ++nzones,
-                               _dgn_point_record_stub,
-                               _dgn_square_is_passable,
-                               choose_stairless ? (at_branch_bottom() ?
-                                                   _is_upwards_exit_stair :
-                                                   _is_exit_stair) : nullptr);
-
-            // If we want only stairless zones, screen out zones that did
-            // have stairs.
-            if (choose_stairless && found_exit_stair)
-                ++ngood;
-            else if (fill)
-            {
-                // Don't fill in areas connected to vaults.
-                // We want vaults to be accessible; if the area is disconneted
-                // from the rest of the level, this will cause the level to be
-                // vetoed later on.
-                bool veto = false;
-                vector<coord_def> coords;
-                for (int fy = y1; fy <= y2 ; ++fy)
-                {
-                    for (int fx = x1; fx <= x2; ++fx)
-                    {
-                        if (travel_point_distance[fx][fy] == nzones)
-                        {
-                            if (map_masked(coord_def(fx, fy), MMT_VAULT))
-                            {
-                                veto = true;
-                                break;
-                            }
-                            else
-                                coords.emplace_back(fx, fy);
-                        }
-                    }
-                    if (veto)
-                        break;
-                }
-                if (!veto)
-                {
-                    for (auto c : coords)
-                        _set_grd(c, fill);
-                }
-            }
+        // If we want only stairless zones, screen out zones that did
+        // have stairs.
+        if (choose_stairless && zi->intersects(stairs))
+            ++ngood;
+        // Don't fill in areas connected to vaults.
+        // We want vaults to be accessible; if the area is disconneted
+        // from the rest of the level, this will cause the level to be
+        // vetoed later on.
+        else if (fill && !zi->intersects(vaults))
+        {
+            for (int x = 0, y = 0; zi->find_next(x, y); ++x)
+                _set_grd(coord_def(x, y), fill);
         }
     }
 
     return nzones - ngood;
 }
 
-int dgn_count_disconnected_zones(bool choose_stairless,
-                                 dungeon_feature_type fill)
-{
-    return _process_disconnected_zones(0, 0, GXM-1, GYM-1, choose_stairless,
-                                       fill);
-}
-
 static void _fixup_hell_stairs()
 {
     for (rectangle_iterator ri(1); ri; ++ri)
@@ -1195,6 +1145,8 @@ static bool _is_level_stair_connected(dungeon_feature_type feat)
 
 static bool _valid_dungeon_level()
 {
+    builder_phase_scope phase(BPHASE_CONNECTIVITY);
+
     // D:1 only.
     // Also, what's the point of this check?  Regular connectivity should
     // do that already.
@@ -1815,86 +1767,74 @@ static bool _fixup_stone_stairs(bool preserve_vault_stairs)
 static bool _add_feat_if_missing(bool (*iswanted)(const coord_def &),
                                  dungeon_feature_type feat)
 {
-    memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
-    int nzones = 0;
-    for (int y = 0; y < GYM; ++y)
-        for (int x = 0; x < GXM; ++x)
-        {
-            // [ds] Use dgn_square_is_passable instead of
-            // dgn_square_travel_ok here, for we'll otherwise
-            // fail on floorless isolated pocket in vaults (like the
-            // altar surrounded by deep water), and trigger the assert
-            // downstairs.
-            const coord_def gc(x, y);
-            if (!map_bounds(x, y)
-                || travel_point_distance[x][y] // already covered previously
-                || !_dgn_square_is_passable(gc))
-            {
-                continue;
-            }
+    // [ds] Use dgn_square_is_passable instead of
+    // dgn_square_travel_ok here, for we'll otherwise
+    // fail on floorless isolated pocket in vaults (like the
+    // altar surrounded by deep water), and trigger the assert
+    // downstairs.
+    const map_bitmask wanted = _dgn_cell_mask(iswanted);
+    for (map_zone_iterator zi(_dgn_cell_mask(_dgn_square_is_passable)); zi;
+         ++zi)
+    {
+        const map_bitmask &zone = *zi;
+        if (zone.intersects(wanted))
+            continue;
 
-            if (_dgn_fill_zone(gc, ++nzones, _dgn_point_record_stub,
-                               _dgn_square_is_passable, iswanted))
+        bool found_feature = false;
+        for (rectangle_iterator ri(0); ri; ++ri)
+        {
+            if (grd(*ri) == feat && zone(*ri))
             {
-                continue;
+                found_feature = true;
+                break;
             }
+        }
 
-            bool found_feature = false;
-            for (rectangle_iterator ri(0); ri; ++ri)
-            {
-                if (grd(*ri) == feat
-                    && travel_point_distance[ri->x][ri->y] == nzones)
-                {
-                    found_feature = true;
-                    break;
-                }
-            }
+        if (found_feature)
+            continue;
 
-            if (found_feature)
+        int i = 0;
+        while (i++ < 2000)
+        {
+            coord_def rnd(random2(GXM), random2(GYM));
+            if (grd(rnd) != DNGN_FLOOR)
                 continue;
 
-            int i = 0;
-            while (i++ < 2000)
-            {
-                coord_def rnd(random2(GXM), random2(GYM));
-                if (grd(rnd) != DNGN_FLOOR)
-                    continue;
+            if (!zone(rnd))
+                continue;
 
-                if (travel_point_distance[rnd.x][rnd.y] != nzones)
-                    continue;
+            _set_grd(rnd, feat);
+            found_feature = true;
+            break;
+        }
 
-                _set_grd(rnd, feat);
-                found_feature = true;
-                break;
-            }
+        if (found_feature)
+            continue;
 
-            if (found_feature)
+        for (rectangle_iterator ri(0); ri; ++ri)
+        {
+            if (grd(*ri) != DNGN_FLOOR)
                 continue;
 
-            for (rectangle_iterator ri(0); ri; ++ri)
-            {
-                if (grd(*ri) != DNGN_FLOOR)
-                    continue;
-
-                if (travel_point_distance[ri->x][ri->y] != nzones)
-                    continue;
+            if (!zone(*ri))
+                continue;
 
-                _set_grd(*ri, feat);
-                found_feature = true;
-                break;
-            }
+            _set_grd(*ri, feat);
+            found_feature = true;
+            break;
+        }
 
-            if (found_feature)
-                continue;
+        if (found_feature)
+            continue;
 
 #ifdef DEBUG_DIAGNOSTICS
-            dump_map("debug.map", true, true);
+        dump_map("debug.map", true, true);
 #endif
-            // [ds] Too many normal cases trigger this ASSERT, including
-            // rivers that surround a stair with deep water.
-            // die("Couldn't find region.");
-            return false;
-        }
+        // [ds] Too many normal cases trigger this ASSERT, including
+        // rivers that surround a stair with deep water.
+        // die("Couldn't find region.");
+        return false;
+    }
 
     return true;
 }
@@ -1955,6 +1895,8 @@ static bool _branch_needs_stairs()
 
 static void _dgn_verify_connectivity(unsigned nvaults)
 {
+    builder_phase_scope phase(BPHASE_CONNECTIVITY);
+
     // After placing vaults, make sure parts of the level have not been
     // disconnected.
     if (dgn_zones && nvaults != env.level_vaults.size())
@@ -2028,6 +1970,8 @@ static void _dgn_verify_connectivity(unsigned nvaults)
 //   in the order their altars are placed.
 static void _build_overflow_temples()
 {
+    builder_phase_scope phase(BPHASE_MINIVAULTS);
+
     // Levels built while in testing mode.
     if (!you.props.exists(OVERFLOW_TEMPLES_KEY))
         return;
@@ -2667,6 +2611,8 @@ static bool _pan_level()
 // to place more vaults after this
 static bool _builder_by_type()
 {
+    builder_phase_scope phase(BPHASE_LAYOUT);
+
     if (player_in_branch(BRANCH_LABYRINTH))
     {
         dgn_build_labyrinth_level();
@@ -2971,6 +2917,8 @@ struct label_match
 // obstructed by slime wall adjacent squares
 static void _slime_connectivity_fixup()
 {
+    builder_phase_scope phase(BPHASE_CONNECTIVITY);
+
     // Generate a connectivity map considering any non wall, non vault square
     // passable
     FixedArray<int, GXM, GYM> connectivity_map;
@@ -3101,6 +3049,8 @@ static void _slime_connectivity_fixup()
 // Place vaults with CHANCE: that want to be placed on this level.
 static void _place_chance_vaults()
 {
+    builder_phase_scope phase(BPHASE_MINIVAULTS);
+
     const level_id &lid(level_id::current());
     mapref_vector maps = random_chance_maps_in_depth(lid);
     // [ds] If there are multiple CHANCE maps that share an luniq_ or
@@ -3138,6 +3088,8 @@ static void _place_chance_vaults()
 
 static void _place_minivaults()
 {
+    builder_phase_scope phase(BPHASE_MINIVAULTS);
+
     const map_def *vault = nullptr;
     // First place the vault requested with &P
     if (you.props.exists("force_minivault")
@@ -3529,6 +3481,8 @@ static void _place_branch_entrances(bool use_vaults)
 
 static void _place_extra_vaults()
 {
+    builder_phase_scope phase(BPHASE_MINIVAULTS);
+
     int tries = 0;
     while (true)
     {
@@ -3559,6 +3513,8 @@ static void _place_extra_vaults()
 // Return the number of uniques placed.
 static int _place_uniques()
 {
+    builder_phase_scope phase(BPHASE_MONSTERS);
+
 #ifdef DEBUG_UNIQUE_PLACEMENT
     FILE *ostat = fopen("unique_placement.log", "a");
     fprintf(ostat, "--- Looking to place uniques on %s\n",
@@ -3757,6 +3713,8 @@ bool door_vetoed(const coord_def pos)
 
 static void _builder_monsters()
 {
+    builder_phase_scope phase(BPHASE_MONSTERS);
+
     if (player_in_branch(BRANCH_TEMPLE))
         return;
 
@@ -3835,6 +3793,8 @@ static void _randomly_place_item(int item)
  */
 static void _builder_items()
 {
+    builder_phase_scope phase(BPHASE_ITEMS);
+
     int i = 0;
     object_class_type specif_type = OBJ_RANDOM;
     int items_levels = env.absdepth0;
@@ -4105,6 +4065,7 @@ static const vault_placement *_build_secondary_vault(const map_def *vault,
                        bool check_collision, bool no_exits,
                        const coord_def &where)
 {
+    builder_phase_scope phase(BPHASE_MINIVAULTS);
     return _build_vault_impl(vault, true, check_collision, no_exits, where);
 }
 
@@ -4120,6 +4081,9 @@ static const vault_placement *_build_secondary_vault(const map_def *vault,
 //
 static const vault_placement *_build_primary_vault(const map_def *vault)
 {
+    // Layouts are placed as primary vaults, but their time is the layout's.
+    builder_phase_scope phase(vault->has_tag("layout") ? BPHASE_LAYOUT
+                                                       : BPHASE_PRIMARY_VAULT);
     return _build_vault_impl(vault);
 }
 
@@ -4137,6 +4101,7 @@ static const vault_placement *_build_vault_impl(const map_def *vault,
     }
 
     unwind_var<string> placing(env.placing_vault, vault->name);
+    builder_vault_scope vault_timer(vault->name);
 
     vault_placement place;
 
@@ -4224,7 +4189,7 @@ static const vault_placement *_build_vault_impl(const map_def *vault,
     if (!build_only && (placed_vault_orientation != MAP_ENCOMPASS || is_layout)
         && player_in_branch(BRANCH_SWAMP))
     {
-        _process_disconnected_zones(0, 0, GXM-1, GYM-1, true, DNGN_TREE);
+        dgn_count_disconnected_zones(true, DNGN_TREE);
     }
 
     if (!make_no_exits)
@@ -5340,8 +5305,11 @@ static dungeon_feature_type _pick_temple_altar(vault_placement &place)
         {
             // Altar god doesn't matter, setting up the whole machinery would
             // be too much work.
-            if (crawl_state.map_stat_gen || crawl_state.obj_stat_gen)
+            if (crawl_state.map_stat_gen || crawl_state.obj_stat_gen
+                || crawl_state.level_hash_gen)
+            {
                 return DNGN_ALTAR_XOM;
+            }
 
             mprf(MSGCH_ERROR, "Ran out of altars for temple!");
             return DNGN_FLOOR;
@@ -6464,19 +6432,8 @@ static bool _fixup_interlevel_connectivity()
 
     // Find up stairs and down stairs on the current level.
     memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
-    int nzones = 0;
-    for (rectangle_iterator ri(0); ri; ++ri)
-    {
-        if (!map_bounds(ri->x, ri->y)
-            || travel_point_distance[ri->x][ri->y]
-            || !dgn_square_travel_ok(*ri))
-        {
-            continue;
-        }
-
-        _dgn_fill_zone(*ri, ++nzones, _dgn_point_record_stub,
-                       dgn_square_travel_ok, nullptr);
-    }
+    for (map_zone_iterator zi(_dgn_cell_mask(dgn_square_travel_ok)); zi; ++zi)
+        zi.label(travel_point_distance);
 
     int max_region = 0;
     for (rectangle_iterator ri(0); ri; ++ri)
@@ -6710,6 +6667,8 @@ static bool _fixup_interlevel_connectivity()
 
 void run_map_epilogues()
 {
+    builder_phase_scope phase(BPHASE_EPILOGUE);
+
     // Iterate over level vaults and run each map's epilogue.
     for (auto &vault : env.level_vaults)
         vault->map.run_lua_epilogue();
@@ -7059,3 +7018,140 @@ static void _mark_solid_squares()
         if (feat_is_solid(grd(*ri)))
             env.pgrid(*ri) |= FPROP_NO_TELE_INTO;
 }
+
+#ifdef DEBUG_TESTS
+// Number the zones of cells with a per-cell fill in row-major order, the
+// way the builder did before map_zone_iterator.
+template <unsigned int SIZEX, unsigned int SIZEY>
+static int _reference_zones(const FixedBitArray<SIZEX, SIZEY> &cells,
+                            int labels[SIZEX][SIZEY])
+{
+    memset(labels, 0, sizeof(int) * SIZEX * SIZEY);
+    int nzones = 0;
+    for (int y = 0; y < (int)SIZEY; ++y)
+        for (int x = 0; x < (int)SIZEX; ++x)
+        {
+            if (!cells(x, y) || labels[x][y])
+                continue;
+
+            labels[x][y] = ++nzones;
+            vector<coord_def> todo(1, coord_def(x, y));
+            while (!todo.empty())
+            {
+                const coord_def c = todo.back();
+                todo.pop_back();
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        const coord_def n(c.x + dx, c.y + dy);
+                        if (n.x < 0 || n.y < 0 || n.x >= (int)SIZEX
+                            || n.y >= (int)SIZEY || !cells(n)
+                            || labels[n.x][n.y])
+                        {
+                            continue;
+                        }
+                        labels[n.x][n.y] = nzones;
+                        todo.push_back(n);
+                    }
+            }
+        }
+    return nzones;
+}
+
+// Check that map_zone_iterator's zones, and their order, match the
+// per-cell fill on a random grid with about density percent of cells set.
+template <unsigned int SIZEX, unsigned int SIZEY>
+static void _test_zone_order(int density)
+{
+    FixedBitArray<SIZEX, SIZEY> cells;
+    for (int y = 0; y < (int)SIZEY; ++y)
+        for (int x = 0; x < (int)SIZEX; ++x)
+            cells.set(x, y, x_chance_in_y(density, 100));
+
+    static int expected[SIZEX][SIZEY], found[SIZEX][SIZEY];
+    const int nzones = _reference_zones(cells, expected);
+
+    memset(found, 0, sizeof(found));
+    int nfound = 0;
+    for (BitArrayZoneIterator<SIZEX, SIZEY> zi(cells); zi; ++zi)
+    {
+        zi.label(found);
+        nfound = zi.number();
+    }
+
+    if (nfound != nzones)
+    {
+        die("zones: %ux%u grid at %d%% has %d zones, not %d", SIZEX, SIZEY,
+            density, nfound, nzones);
+    }
+    if (memcmp(found, expected, sizeof(found)))
+    {
+        die("zones: %ux%u grid at %d%% has zones in a different order",
+            SIZEX, SIZEY, density);
+    }
+}
+
+/**
+ * Compare the word-parallel zone fills with a per-cell fill, on random
+ * grids of several widths, and check dgn_count_disconnected_zones() on
+ * random levels. The level is put back afterwards.
+ */
+void dgn_zone_tests()
+{
+    for (int i = 0; i < 40; ++i)
+    {
+        const int density = 5 + i * 90 / 40;
+        _test_zone_order<GXM, GYM>(density);
+        _test_zone_order<64, 9>(density);
+        _test_zone_order<65, 7>(density);
+        _test_zone_order<130, 5>(density);
+        _test_zone_order<7, 7>(density);
+    }
+
+    unwind_var<feature_grid> grid(env.grid);
+    unwind_var<map_mask> level_mask(env.level_map_mask);
+    unwind_var<decltype(env.tile_flv)> tile_flv(env.tile_flv);
+    unwind_var<decltype(env.grid_colours)> grid_colours(env.grid_colours);
+
+    static int labels[GXM][GYM];
+    for (int i = 0; i < 20; ++i)
+    {
+        const int density = 30 + i * 3;
+        env.level_map_mask.init(0);
+        map_bitmask floor;
+        for (rectangle_iterator ri(0); ri; ++ri)
+        {
+            const bool open = in_bounds(*ri) && x_chance_in_y(density, 100);
+            grd(*ri) = open ? DNGN_FLOOR : DNGN_ROCK_WALL;
+            floor.set(*ri, open);
+            if (open && one_chance_in(200))
+                env.level_map_mask(*ri) |= MMT_VAULT;
+        }
+
+        const int nzones = _reference_zones(floor, labels);
+        const int counted = dgn_count_disconnected_zones(false);
+        if (counted != nzones)
+        {
+            die("zones: level at %d%% counted %d zones, not %d", density,
+                counted, nzones);
+        }
+
+        // Filling should close every zone except those with vault cells.
+        set<int> kept;
+        for (rectangle_iterator ri(0); ri; ++ri)
+            if (map_masked(*ri, MMT_VAULT))
+                kept.insert(labels[ri->x][ri->y]);
+        dgn_count_disconnected_zones(false, DNGN_ROCK_WALL);
+        for (rectangle_iterator ri(0); ri; ++ri)
+        {
+            const int zone = labels[ri->x][ri->y];
+            const bool open = zone && kept.count(zone);
+            if ((grd(*ri) == DNGN_FLOOR) != open)
+            {
+                die("zones: level at %d%% filled (%d,%d) wrongly", density,
+                    ri->x, ri->y);
+            }
+        }
+    }
+}
+#endif
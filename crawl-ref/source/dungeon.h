@@ -264,6 +264,10 @@ int dgn_count_disconnected_zones(
     bool choose_stairless,
     dungeon_feature_type fill = DNGN_UNSEEN);
 
+#ifdef DEBUG_TESTS
+void dgn_zone_tests();
+#endif
+
 void dgn_replace_area(const coord_def& p1, const coord_def& p2,
                       dungeon_feature_type replace,
                       dungeon_feature_type feature,
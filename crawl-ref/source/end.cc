@@ -15,7 +15,9 @@
 #include "crash.h"
 #include "database.h"
 #include "describe.h"
+#include "dgn-profile.h"
 #include "dungeon.h"
+#include "files.h"
 #include "god-passive.h"
 #include "hints.h"
 #include "invent.h"
@@ -199,6 +201,7 @@ NORETURN void end(int exit_code, bool print_error, const char *format, ...)
         msg::deinitialise_mpr_streams();
         _clear_globals_on_exit();
         databaseSystemShutdown();
+        builder_profile_write_report();
 #ifdef DEBUG_PROPS
         dump_prop_accesses();
 #endif
@@ -231,6 +234,7 @@ NORETURN void end(int exit_code, bool print_error, const char *format, ...)
 // Delete save files on game end.
 static void _delete_files()
 {
+    stop_pregenerating_levels();
     crawl_state.need_save = false;
     you.save->unlink();
     delete you.save;
@@ -3,6 +3,7 @@
 #include <set>
 #include <memory> // unique_ptr
 
+#include "cloud-grid.h"
 #include "coord.h"
 #include "fprop.h"
 #include "map-cell.h"
@@ -71,7 +72,7 @@ struct crawl_environment
     tile_flavour tile_default;
     vector<string> tile_names;
 
-    map<coord_def, cloud_struct> cloud;
+    cloud_grid cloud;
 
     map<coord_def, shop_struct> shop; // shop list
     map<coord_def, trap_def> trap; // trap list
@@ -76,6 +76,7 @@ protected:
 typedef FixedArray<dungeon_feature_type, GXM, GYM> feature_grid;
 typedef FixedArray<unsigned int, GXM, GYM> map_mask;
 typedef FixedBitArray<GXM, GYM> map_bitmask;
+typedef BitArrayZoneIterator<GXM, GYM> map_zone_iterator;
 
 struct item_def;
 struct coord_def;
@@ -833,6 +834,7 @@ public:
     string property_at(const coord_def &c, map_marker_type type,
                        const char *key)
     { return property_at(c, type, string(key)); }
+    vector<map_marker*> get_property_markers() const;
     void clear();
 
     void write(writer &) const;
@@ -845,9 +847,15 @@ private:
     void init_from(const map_markers &);
     void unlink_marker(const map_marker *);
     void check_empty();
+    bool maybe_marked(const coord_def &c) const;
 
 private:
     dgn_marker_map markers;
+    // Indexes into markers, kept in step with it: the same markers split by
+    // type, those that can have properties, and the cells with any at all.
+    FixedVector<dgn_marker_map, NUM_MAP_MARKER_TYPES> markers_by_type;
+    dgn_marker_map property_markers;
+    map_bitmask marked_cells;
     bool have_inactive_markers;
 };
 
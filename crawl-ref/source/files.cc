@@ -22,6 +22,8 @@
 #endif
 #include <sys/types.h>
 #ifdef UNIX
+#include <csignal>
+#include <sys/wait.h>
 #include <unistd.h>
 #endif
 
@@ -36,6 +38,7 @@
 #include "dactions.h"
 #include "dgn-overview.h"
 #include "directn.h"
+#include "dlua.h"
 #include "dungeon.h"
 #include "end.h"
 #include "errors.h"
@@ -47,6 +50,7 @@
 #include "god-conduct.h" // for fedhas_rot_all_corpses
 #include "god-companions.h"
 #include "god-passive.h"
+#include "hash.h"
 #include "hints.h"
 #include "initfile.h"
 #include "item-name.h"
@@ -65,8 +69,10 @@
 #include "output.h"
 #include "place.h"
 #include "prompt.h"
+#include "random.h"
 #include "species.h"
 #include "spl-summoning.h"
+#include "stairs.h"
 #include "stash.h"  // for fedhas_rot_all_corpses
 #include "state.h"
 #include "stringutil.h"
@@ -124,6 +130,7 @@ static bool _ghost_version_compatible(reader &ghost_reader);
 static bool _restore_tagged_chunk(package *save, const string &name,
                                   tag_type tag, const char* complaint);
 static bool _read_char_chunk(package *save);
+static bool _tagged_chunk_version_compatible(reader &inf, string* reason);
 
 static bool _convert_obsolete_species();
 
@@ -1230,6 +1237,20 @@ static bool _leave_level(dungeon_feature_type stair_taken,
 }
 
 
+static void _leave_pocket_abyss()
+{
+    if (you.chapter == CHAPTER_POCKET_ABYSS
+        && player_in_branch(BRANCH_DUNGEON))
+    {
+        // If we're leaving the Abyss for the first time as a Chaos
+        // Knight of Lugonu (who start out there), enable normal monster
+        // generation.
+        you.chapter = CHAPTER_ORB_HUNTING;
+    }
+}
+
+static bool _uses_level_rng(const level_id &place);
+
 /**
  * Generate a new level.
  *
@@ -1238,21 +1259,15 @@ static bool _leave_level(dungeon_feature_type stair_taken,
  *
  * @param stair_taken   The means used to leave the last level.
  * @param old_level     The ID of the previous level.
+ * @return Whether the level could be built.
  */
-static void _make_level(dungeon_feature_type stair_taken,
+static bool _make_level(dungeon_feature_type stair_taken,
                         const level_id& old_level)
 {
 
     env.turns_on_level = -1;
 
-    if (you.chapter == CHAPTER_POCKET_ABYSS
-        && player_in_branch(BRANCH_DUNGEON))
-    {
-        // If we're leaving the Abyss for the first time as a Chaos
-        // Knight of Lugonu (who start out there), enable normal monster
-        // generation.
-        you.chapter = CHAPTER_ORB_HUNTING;
-    }
+    _leave_pocket_abyss();
 
     tile_init_default_flavour();
     tile_clear_flavour();
@@ -1266,12 +1281,21 @@ static void _make_level(dungeon_feature_type stair_taken,
                              dummy));
 
     _clear_env_map();
-    builder(true, stair_type);
+    bool built;
+    const level_id place = level_id::current();
+    if (_uses_level_rng(place))
+    {
+        seeded_rng_scope level_rng(you.game_seed, place.branch, place.depth);
+        built = builder(true, stair_type);
+    }
+    else
+        built = builder(true, stair_type);
 
     env.turns_on_level = 0;
     // sanctuary
     env.sanctuary_pos  = coord_def(-1, -1);
     env.sanctuary_time = 0;
+    return built;
 }
 
 /**
@@ -1346,6 +1370,542 @@ static string _get_hatch_name()
     return "";
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Level pregeneration
+//
+// With the pregenerate_levels option, a forked worker builds the levels
+// behind the stairs the player knows about while they explore the current
+// one. The worker hands the levels back in a package next to the save;
+// they're copied into the save as "pregen-" chunks, and taking the stairs
+// then only has to load the level.
+//
+// Levels that can be built this way always use a random stream of their
+// own (see _make_level()), so they come out the same whether the worker or
+// the game builds them and seeded games stay reproducible. A pregenerated
+// level also carries a fingerprint of the player state that level
+// generation depends on, and is thrown away if that has changed by the
+// time the player arrives.
+
+#define PREGEN_CHUNK_PREFIX "pregen-"
+
+// Monsters made by the worker for each level get mids this far past the
+// game's own, so that they can't clash with any made in the meantime.
+static const mid_t PREGEN_MID_GAP = 1 << 20;
+
+// Player props that level generation reads.
+static const char * const levelgen_props[] =
+{
+    TEMPLE_GODS_KEY, OVERFLOW_TEMPLES_KEY, TEMPLE_MAP_KEY, TEMPLE_SIZE_KEY,
+    TOMB_STONE_STAIRS_KEY, "force_map", "force_minivault",
+};
+
+// Set in the worker if a level wanted a ghost from the bones files, which
+// it mustn't use up.
+static bool pregen_wanted_bones = false;
+
+static bool _pregen_enabled()
+{
+#if defined(UNIX) && !defined(USE_TILE_WEB)
+    return Options.pregenerate_levels && !Options.no_save
+           && crawl_state.game_standard_levelgen();
+#else
+    return false;
+#endif
+}
+
+// Levels of seeded games are built from streams of their own, so that the
+// same seed gives the same dungeon however the game was played. So are the
+// levels that can be pregenerated, which must come out the same from the
+// worker as from the game.
+static bool _uses_level_rng(const level_id &place)
+{
+    return (you.props.exists(SEEDED_GAME_KEY) || _pregen_enabled())
+           && place.is_valid() && is_connected_branch(place);
+}
+
+static string _pregen_chunk(const level_id &place)
+{
+    return PREGEN_CHUNK_PREFIX + place.describe();
+}
+
+// What level generation reads from the player without changing it.
+static void _marshall_levelgen_inputs(writer &th)
+{
+    marshallInt(th, you.game_seed);
+    // Gozag's gold detection marks the gold placed on new levels
+    // (_count_gold() in dungeon.cc).
+    marshallByte(th, you.religion);
+    for (int j = 0; j < NUM_BRANCHES; ++j)
+        marshallInt(th, branch_bribe[j]);
+    CrawlHashTable props;
+    for (const char *key : levelgen_props)
+        if (you.props.exists(key))
+            props[key] = you.props[key];
+    props.write(th);
+}
+
+// What level generation may change in the player.
+static void _marshall_levelgen_results(writer &th)
+{
+    for (int j = 0; j < NUM_MONSTERS; ++j)
+        marshallBoolean(th, you.unique_creatures[j]);
+    for (int j = 0; j < MAX_UNRANDARTS; ++j)
+        marshallByte(th, you.unique_items[j]);
+    marshallInt(th, you.attribute[ATTR_GOLD_GENERATED]);
+    for (const set<string> *names : { &you.uniq_map_tags,
+                                      &you.uniq_map_names })
+    {
+        marshallInt(th, names->size());
+        for (const string &name : *names)
+            marshallString(th, name);
+    }
+    if (!dlua.callfn("dgn_save_data", "u", &th))
+        mprf(MSGCH_ERROR, "Failed to save Lua data: %s", dlua.error.c_str());
+}
+
+static void _unmarshall_levelgen_results(reader &th)
+{
+    for (int j = 0; j < NUM_MONSTERS; ++j)
+        you.unique_creatures.set(j, unmarshallBoolean(th));
+    for (int j = 0; j < MAX_UNRANDARTS; ++j)
+    {
+        you.unique_items[j] =
+            static_cast<unique_item_status_type>(unmarshallByte(th));
+    }
+    you.attribute[ATTR_GOLD_GENERATED] = unmarshallInt(th);
+    for (set<string> *names : { &you.uniq_map_tags, &you.uniq_map_names })
+    {
+        names->clear();
+        for (int count = unmarshallInt(th); count > 0; --count)
+            names->insert(unmarshallString(th));
+    }
+    if (!dlua.callfn("dgn_load_data", "u", &th))
+    {
+        mprf(MSGCH_ERROR, "Failed to load Lua persist table: %s",
+             dlua.error.c_str());
+    }
+}
+
+static uint32_t _levelgen_fingerprint()
+{
+    vector<unsigned char> buf;
+    writer th(&buf);
+    _marshall_levelgen_inputs(th);
+    _marshall_levelgen_results(th);
+    return hash32(buf.data(), buf.size());
+}
+
+/**
+ * Replace the (new) current level with its pregenerated copy, if there is
+ * one that was built from the player state as it is now.
+ *
+ * @return Whether the pregenerated level was used.
+ */
+static bool _load_pregenerated_level()
+{
+    const level_id place = level_id::current();
+    if (!_uses_level_rng(place))
+        return false;
+
+    const string chunk = _pregen_chunk(place);
+    if (!you.save->has_chunk(chunk))
+        return false;
+
+    bool used = false;
+    {
+        reader inf(you.save, chunk);
+        string reason;
+        if (!_tagged_chunk_version_compatible(inf, &reason))
+            dprf("chunk %s: %s", chunk.c_str(), reason.c_str());
+        else if (unmarshallUnsigned(inf) != _levelgen_fingerprint())
+            dprf("Pregenerated %s is out of date.", place.describe().c_str());
+        else
+        {
+            const mid_t first_mid = unmarshallUnsigned(inf);
+            const mid_t last_mid = unmarshallUnsigned(inf);
+            if (you.last_mid < first_mid)
+            {
+                crawl_state.minor_version = inf.getMinorVersion();
+                try
+                {
+                    _unmarshall_levelgen_results(inf);
+                    vector<string> &vaults = you.vault_list[place];
+                    vaults.clear();
+                    for (int count = unmarshallInt(inf); count > 0; --count)
+                        vaults.push_back(unmarshallString(inf));
+                    tag_read(inf, TAG_LEVEL);
+                }
+                catch (short_read_exception &E)
+                {
+                    fail("truncated save chunk (%s)", chunk.c_str());
+                };
+                inf.fail_if_not_eof(chunk);
+
+                you.last_mid = last_mid;
+                _leave_pocket_abyss();
+                used = true;
+            }
+        }
+    }
+
+    you.save->delete_chunk(chunk);
+    return used;
+}
+
+#if defined(UNIX) && !defined(USE_TILE_WEB)
+typedef vector<pair<level_id, dungeon_feature_type>> pregen_targets;
+
+static pid_t pregen_worker = 0;
+// Levels the worker is building, and every level asked for so far.
+static vector<level_id> pregen_worker_levels;
+static set<level_id> pregen_requested;
+
+static string _pregen_handoff_file()
+{
+    return get_savedir_filename(you.your_name) + ".pregen";
+}
+
+// In the worker: build place as if the player took stair from the current
+// level, and add it to pkg if it can be used.
+static void _pregenerate_level(package &pkg, const level_id &place,
+                               dungeon_feature_type stair, mid_t first_mid)
+{
+    const level_id old_level = level_id::current();
+    const uint32_t fingerprint = _levelgen_fingerprint();
+
+    vector<unsigned char> old_results, old_props, new_props;
+    {
+        writer results(&old_results);
+        _marshall_levelgen_results(results);
+        writer props(&old_props);
+        you.props.write(props);
+    }
+
+    {
+        unwind_var<branch_type> branch(you.where_are_you, place.branch);
+        unwind_var<int> depth(you.depth, place.depth);
+        unwind_var<mid_t> mid(you.last_mid, first_mid);
+
+        pregen_wanted_bones = false;
+        delete_all_clouds();
+        dungeon_events.clear();
+        you.position.reset();
+
+        const bool built = _make_level(stair, old_level);
+        writer props(&new_props);
+        you.props.write(props);
+
+        // Anything that changed the player's props would be lost.
+        if (built && !pregen_wanted_bones && new_props == old_props)
+        {
+            fix_item_coordinates();
+
+            writer outf(&pkg, place.describe());
+            marshallUByte(outf, TAG_MAJOR_VERSION);
+            marshallUByte(outf, TAG_MINOR_VERSION);
+            marshallUnsigned(outf, fingerprint);
+            marshallUnsigned(outf, first_mid);
+            marshallUnsigned(outf, you.last_mid);
+            _marshall_levelgen_results(outf);
+            const vector<string> &vaults = you.vault_list[place];
+            marshallInt(outf, vaults.size());
+            for (const string &vault : vaults)
+                marshallString(outf, vault);
+            tag_write(TAG_LEVEL, outf);
+        }
+    }
+
+    // Start the next level from the same state.
+    reader results(old_results);
+    _unmarshall_levelgen_results(results);
+    you.vault_list.erase(place);
+}
+
+NORETURN static void _run_pregen_worker(const pregen_targets &targets)
+{
+    // Stay away from the terminal and out of the game's way.
+    const int null_fd = open("/dev/null", O_RDWR);
+    if (null_fd >= 0)
+    {
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        if (null_fd > STDERR_FILENO)
+            close(null_fd);
+    }
+    signal(SIGINT, SIG_IGN);
+    signal(SIGHUP, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    if (nice(10) == -1) {};
+
+    // The game's save belongs to the game; failures just lose the level.
+    crawl_state.pregenerating_levels = true;
+    crawl_state.need_save = false;
+    crawl_state.show_more_prompt = false;
+    split_rngs(getpid());
+
+    const string file = _pregen_handoff_file();
+    const string tmp = file + ".tmp";
+    {
+        package pkg(tmp.c_str(), true, true);
+        mid_t first_mid = you.last_mid;
+        for (const auto &target : targets)
+        {
+            first_mid += PREGEN_MID_GAP;
+            _pregenerate_level(pkg, target.first, target.second, first_mid);
+        }
+        pkg.commit();
+    }
+    if (rename(tmp.c_str(), file.c_str()))
+        _exit(1);
+
+    // Don't run any destructors: they'd touch the game's save and screen.
+    _exit(0);
+}
+
+// Copy what the worker built into the save.
+static void _import_pregenerated_levels()
+{
+    const string file = _pregen_handoff_file();
+    if (access(file.c_str(), F_OK) != 0)
+        return;
+
+    package pkg(file.c_str(), false);
+    for (const string &name : pkg.list_chunks())
+    {
+        vector<char> data;
+        chunk_reader(&pkg, name).read_all(data);
+        writer outf(you.save, PREGEN_CHUNK_PREFIX + name);
+        outf.write(data.data(), data.size());
+    }
+}
+
+// Collect the worker if it's done; if it isn't and stop is set, kill it.
+static void _reap_pregen_worker(bool stop)
+{
+    if (!pregen_worker)
+        return;
+
+    int status = 0;
+    pid_t pid = waitpid(pregen_worker, &status, WNOHANG);
+    bool done = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (pid == 0)
+    {
+        if (!stop)
+            return;
+        kill(pregen_worker, SIGKILL);
+        waitpid(pregen_worker, &status, 0);
+    }
+    pregen_worker = 0;
+
+    if (done)
+        _import_pregenerated_levels();
+    else
+    {
+        // Let a later worker try these again.
+        for (const level_id &place : pregen_worker_levels)
+            pregen_requested.erase(place);
+    }
+    pregen_worker_levels.clear();
+
+    const string file = _pregen_handoff_file();
+    unlink(file.c_str());
+    unlink((file + ".tmp").c_str());
+}
+#endif
+
+/**
+ * Start building the levels behind the stairs the player knows about on the
+ * current level in the background, if the pregenerate_levels option is set.
+ * Called once per player input; collects a worker that has finished, and
+ * starts a new one when there are unbuilt levels it hasn't been asked for.
+ */
+void pregenerate_levels()
+{
+#if defined(UNIX) && !defined(USE_TILE_WEB)
+    if (!_pregen_enabled() || !you.save || you.entering_level)
+        return;
+
+    _reap_pregen_worker(false);
+    if (pregen_worker)
+        return;
+
+    pregen_targets targets;
+    for (rectangle_iterator ri(1); ri; ++ri)
+    {
+        const dungeon_feature_type feat = env.map_knowledge(*ri).feat();
+        if (!feat_is_stone_stair_down(feat) && !feat_is_branch_entrance(feat))
+            continue;
+
+        const level_id place = stair_destination(*ri);
+        if (!_uses_level_rng(place)
+            || pregen_requested.count(place)
+            || is_existing_level(place)
+            || you.save->has_chunk(_pregen_chunk(place)))
+        {
+            continue;
+        }
+        pregen_requested.insert(place);
+        targets.emplace_back(place, orig_terrain(*ri));
+    }
+    if (targets.empty())
+        return;
+
+    const pid_t pid = fork();
+    if (pid == 0)
+        _run_pregen_worker(targets);
+    else if (pid > 0)
+    {
+        pregen_worker = pid;
+        for (const auto &target : targets)
+            pregen_worker_levels.push_back(target.first);
+    }
+#endif
+}
+
+/// Stop any background level building, e.g. when the game is saved.
+void stop_pregenerating_levels()
+{
+#if defined(UNIX) && !defined(USE_TILE_WEB)
+    _reap_pregen_worker(true);
+    pregen_requested.clear();
+#endif
+}
+
+#ifdef DEBUG_TESTS
+// The level's terrain, items and monsters, for comparing two builds of it.
+static vector<unsigned char> _level_snapshot()
+{
+    vector<unsigned char> buf;
+    writer th(&buf);
+    for (rectangle_iterator ri(0); ri; ++ri)
+        marshallByte(th, grd(*ri));
+    for (const item_def &item : mitm)
+        if (item.defined())
+            marshallItem(th, item);
+    for (monster_iterator mi; mi; ++mi)
+        marshallMonster(th, **mi);
+    return buf;
+}
+
+/**
+ * Build a level the way the background worker does, then build it the
+ * normal way, and check that the pregenerated copy is used in its place and
+ * comes out the same.
+ */
+void pregen_tests()
+{
+#if defined(UNIX) && !defined(USE_TILE_WEB)
+    const level_id old_level(BRANCH_DUNGEON, 1);
+    const level_id place(BRANCH_DUNGEON, 2);
+    const dungeon_feature_type stair = DNGN_STONE_STAIRS_DOWN_I;
+    const mid_t first_mid = you.last_mid + PREGEN_MID_GAP;
+    const string file = "pregen-test.tmp";
+
+    unwind_var<uint32_t> seed(you.game_seed, 0x5eed);
+    unwind_var<CrawlHashTable> props(you.props);
+    you.props[SEEDED_GAME_KEY] = true;
+    unwind_var<branch_type> branch(you.where_are_you, old_level.branch);
+    unwind_var<int> depth(you.depth, old_level.depth);
+
+    package pkg(file.c_str(), true, true);
+    unwind_var<package*> save(you.save, &pkg);
+
+    _pregenerate_level(pkg, place, stair, first_mid);
+    if (!pkg.has_chunk(place.describe()))
+        die("%s wasn't pregenerated", place.describe().c_str());
+    {
+        // As _import_pregenerated_levels() does.
+        vector<char> data;
+        chunk_reader(&pkg, place.describe()).read_all(data);
+        writer outf(&pkg, _pregen_chunk(place));
+        outf.write(data.data(), data.size());
+    }
+
+    vector<unsigned char> old_results;
+    {
+        writer results(&old_results);
+        _marshall_levelgen_results(results);
+    }
+
+    you.where_are_you = place.branch;
+    you.depth = place.depth;
+    you.last_mid = first_mid;
+    if (!_make_level(stair, old_level))
+        die("%s couldn't be built", place.describe().c_str());
+    fix_item_coordinates();
+    const vector<unsigned char> built = _level_snapshot();
+
+    // Back to the state the worker built the level from.
+    reader results(old_results);
+    _unmarshall_levelgen_results(results);
+    you.vault_list.erase(place);
+    you.last_mid = first_mid - 1;
+
+    if (!_load_pregenerated_level())
+        die("pregenerated %s wasn't used", place.describe().c_str());
+    if (_level_snapshot() != built)
+    {
+        die("pregenerated %s differs from a normal build",
+            place.describe().c_str());
+    }
+
+    pkg.unlink();
+#endif
+}
+
+/**
+ * Check that the first level of a seeded game comes out the same however
+ * much the game's random stream was used before it was built.
+ */
+void seeded_level_tests()
+{
+    const level_id place(BRANCH_DUNGEON, 1);
+    const uint32_t test_seed = 0x5eed;
+
+    unwind_var<uint32_t> seed(you.game_seed, test_seed);
+    unwind_var<CrawlHashTable> props(you.props);
+    you.props[SEEDED_GAME_KEY] = true;
+    unwind_var<branch_type> branch(you.where_are_you, place.branch);
+    unwind_var<int> depth(you.depth, place.depth);
+    unwind_var<mid_t> last_mid(you.last_mid);
+
+    vector<unsigned char> old_results;
+    {
+        writer results(&old_results);
+        _marshall_levelgen_results(results);
+    }
+
+    vector<unsigned char> first;
+    for (int draws : { 0, 1, 1000 })
+    {
+        seed_rng(test_seed);
+        for (int i = 0; i < draws; ++i)
+            random2(100);
+
+        reader results(old_results);
+        _unmarshall_levelgen_results(results);
+        you.vault_list.erase(place);
+        you.last_mid = last_mid.original_value();
+
+        if (!_make_level(DNGN_STONE_STAIRS_DOWN_I, place))
+            die("%s couldn't be built", place.describe().c_str());
+        fix_item_coordinates();
+        const vector<unsigned char> built = _level_snapshot();
+        if (first.empty())
+            first = built;
+        else if (built != first)
+        {
+            die("%s changed after %d earlier random draws",
+                place.describe().c_str(), draws);
+        }
+    }
+
+    reader results(old_results);
+    _unmarshall_levelgen_results(results);
+}
+#endif
+
 /**
  * Load the current level.
  *
@@ -1435,8 +1995,17 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
     if (!you.save->has_chunk(level_name))
     {
         ASSERT(load_mode != LOAD_VISITOR);
-        dprf("Generating new level for '%s'.", level_name.c_str());
-        _make_level(stair_taken, old_level);
+#if defined(UNIX) && !defined(USE_TILE_WEB)
+        // Whatever the worker hasn't finished by now is too late.
+        _reap_pregen_worker(_uses_level_rng(level_id::current()));
+#endif
+        if (_load_pregenerated_level())
+            dprf("Loaded pregenerated level for '%s'.", level_name.c_str());
+        else
+        {
+            dprf("Generating new level for '%s'.", level_name.c_str());
+            _make_level(stair_taken, old_level);
+        }
         just_created_level = true;
     }
     else
@@ -1461,8 +2030,11 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
     if (make_changes || load_mode == LOAD_RESTART_GAME)
         env.markers.activate_all();
 
+    // Monsters are caught up when they're first seen or first act (see
+    // update_monsters_in_view() and handle_monsters()), so that arriving
+    // doesn't wait on them all.
     if (make_changes && env.elapsed_time && !just_created_level)
-        update_level(you.elapsed_time - env.elapsed_time);
+        update_level(you.elapsed_time - env.elapsed_time, true);
 
     // Apply all delayed actions, if any.
     if (just_created_level)
@@ -1489,6 +2061,9 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
     if (load_mode == LOAD_ENTER_LEVEL)
         place_transiting_monsters();
 
+    if (make_changes)
+        catch_up_visible_monsters();
+
     if (make_changes)
     {
         // Tell stash-tracker and travel that we've changed levels.
@@ -1679,6 +2254,7 @@ static void _save_game_base()
 {
     /* Stashes */
     SAVEFILE("st", "stashes", StashTrack.save);
+    SAVEFILE("sti", "stash_index", StashTrack.save_search_index);
 
 #ifdef CLUA_BINDINGS
     /* lua */
@@ -1725,6 +2301,8 @@ static void _save_game_exit()
         macro_save();
     }
 
+    stop_pregenerating_levels();
+
     // Must be exiting -- save level & goodbye!
     if (!you.entering_level)
         _save_level(level_id::current());
@@ -1967,6 +2545,12 @@ static vector<ghost_demon> _load_permastore_ghosts()
  */
 bool define_ghost_from_bones(monster& mons)
 {
+    if (crawl_state.pregenerating_levels)
+    {
+        pregen_wanted_bones = true;
+        return false;
+    }
+
     bool used_permastore = false;
 
     vector<ghost_demon> loaded_ghosts = _load_ephemeral_ghosts();
@@ -2014,6 +2598,12 @@ bool define_ghost_from_bones(monster& mons)
  */
 bool load_ghosts(int max_ghosts, bool creating_level)
 {
+    if (crawl_state.pregenerating_levels)
+    {
+        pregen_wanted_bones = true;
+        return false;
+    }
+
     ASSERT(you.transit_stair == DNGN_UNSEEN || creating_level);
     ASSERT(!you.entering_level || creating_level);
     ASSERT(!creating_level
@@ -2154,6 +2744,12 @@ static bool _restore_game(const string& filename)
         StashTrack.load(inf);
     }
 
+    if (you.save->has_chunk(CHUNK("sti", "stash_index")))
+    {
+        reader inf(you.save, CHUNK("sti", "stash_index"), minorVersion);
+        StashTrack.load_search_index(inf);
+    }
+
 #ifdef CLUA_BINDINGS
     if (you.save->has_chunk("lua"))
     {
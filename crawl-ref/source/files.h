@@ -84,6 +84,13 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
                 const level_id& old_level);
 void delete_level(const level_id &level);
 
+void pregenerate_levels();
+void stop_pregenerating_levels();
+#ifdef DEBUG_TESTS
+void pregen_tests();
+void seeded_level_tests();
+#endif
+
 void save_game(bool leave_game, const char *bye = nullptr);
 
 // Save game without exiting (used when changing levels).
@@ -26,6 +26,7 @@
 #include "confirm-butcher-type.h"
 #include "defines.h"
 #include "delay.h"
+#include "dgn-profile.h"
 #include "directn.h"
 #include "dlua.h"
 #include "end.h"
@@ -193,6 +194,7 @@ const vector<GameOption*> game_options::build_options_list()
         new BoolGameOption(SIMPLE_NAME(pickup_thrown), true),
         new BoolGameOption(SIMPLE_NAME(show_travel_trail), USING_DGL),
         new BoolGameOption(SIMPLE_NAME(use_fake_cursor), USING_UNIX ),
+        new BoolGameOption(SIMPLE_NAME(pregenerate_levels), false),
         new BoolGameOption(SIMPLE_NAME(use_fake_player_cursor), true),
         new BoolGameOption(SIMPLE_NAME(show_player_species), false),
         new BoolGameOption(SIMPLE_NAME(use_modifier_prefix_keys), true),
@@ -1172,6 +1174,7 @@ void game_options::reset_options()
     flash_screen_message.clear();
     sound_mappings.clear();
     menu_colour_mappings.clear();
+    menu_colour_tags.clear();
     message_colour_mappings.clear();
     named_options.clear();
 
@@ -3242,6 +3245,7 @@ void game_options::read_option_line(const string &str, bool runscript)
                 new_entries.push_back(mapping);
         }
         merge_lists(menu_colour_mappings, new_entries, caret_equal);
+        menu_colour_tags.clear();
     }
     else if (key == "message_colour" || key == "message_color")
     {
@@ -3771,8 +3775,12 @@ enum commandline_option_type
     CLO_OBJSTAT,
     CLO_ITERATIONS,
     CLO_FORCE_MAP,
+    CLO_LEVELHASH,
+    CLO_LEVELHASH_DIFF,
+    CLO_WORKERS,
     CLO_ARENA,
     CLO_DUMP_MAPS,
+    CLO_BUILDER_PROFILE,
     CLO_TEST,
     CLO_SCRIPT,
     CLO_BUILDDB,
@@ -3799,6 +3807,8 @@ enum commandline_option_type
     CLO_WEBTILES_SOCKET,
     CLO_AWAIT_CONNECTION,
     CLO_PRINT_WEBTILES_OPTIONS,
+    CLO_WEBTILES_RECORD,
+    CLO_ZYGOTE,
 #endif
 
     CLO_NOPS
@@ -3808,13 +3818,15 @@ static const char *cmd_ops[] =
 {
     "scores", "name", "species", "background", "dir", "rc", "rcdir", "tscores",
     "vscores", "scorefile", "morgue", "macro", "mapstat", "dump-disconnect",
-    "objstat", "iters", "force-map", "arena", "dump-maps", "test", "script",
-    "builddb", "help", "version", "seed", "save-version", "sprint",
-    "extra-opt-first", "extra-opt-last", "sprint-map", "edit-save",
+    "objstat", "iters", "force-map", "levelhash", "levelhash-diff", "workers",
+    "arena", "dump-maps", "builder-profile",
+    "test", "script", "builddb", "help", "version", "seed", "save-version",
+    "sprint", "extra-opt-first", "extra-opt-last", "sprint-map", "edit-save",
     "print-charset", "tutorial", "wizard", "explore", "no-save", "gdb",
     "no-gdb", "nogdb", "throttle", "no-throttle", "playable-json",
 #ifdef USE_TILE_WEB
     "webtiles-socket", "await-connection", "print-webtiles-options",
+    "webtiles-record", "zygote",
 #endif
 };
 
@@ -4231,8 +4243,8 @@ bool parse_args(int argc, char **argv, bool rc_only)
     COMPILE_CHECK(ARRAYSZ(cmd_ops) == CLO_NOPS);
 
 #ifndef DEBUG_STATISTICS
-    const char *dbg_stat_err = "mapstat and objstat are available only in "
-                               "DEBUG_STATISTICS builds.\n";
+    const char *dbg_stat_err = "mapstat, objstat and levelhash are available "
+                               "only in DEBUG_STATISTICS builds.\n";
 #endif
 
     if (crawl_state.command_line_arguments.empty())
@@ -4253,6 +4265,7 @@ bool parse_args(int argc, char **argv, bool rc_only)
 
     SysEnv.rcdirs.clear();
     SysEnv.map_gen_iters = 0;
+    SysEnv.map_gen_workers = 1;
 
     if (argc < 2)           // no args!
         return true;
@@ -4377,11 +4390,14 @@ bool parse_args(int argc, char **argv, bool rc_only)
 
         case CLO_MAPSTAT:
         case CLO_OBJSTAT:
+        case CLO_LEVELHASH:
 #ifdef DEBUG_STATISTICS
             if (o == CLO_MAPSTAT)
                 crawl_state.map_stat_gen = true;
-            else
+            else if (o == CLO_OBJSTAT)
                 crawl_state.obj_stat_gen = true;
+            else
+                crawl_state.level_hash_gen = true;
 #ifdef USE_TILE_LOCAL
             crawl_state.tiles_disabled = true;
 #endif
@@ -4444,6 +4460,34 @@ bool parse_args(int argc, char **argv, bool rc_only)
 #endif
             break;
 
+        case CLO_LEVELHASH_DIFF:
+#ifdef DEBUG_STATISTICS
+            if (!next_is_param)
+                end(1, false, "String argument required for -%s\n", arg);
+            else
+            {
+                SysEnv.level_hash_baseline = next_arg;
+                nextUsed = true;
+            }
+#else
+            end(1, false, "%s", dbg_stat_err);
+#endif
+            break;
+
+        case CLO_WORKERS:
+#ifdef DEBUG_STATISTICS
+            if (!next_is_param || !isadigit(*next_arg))
+                end(1, false, "Integer argument required for -%s\n", arg);
+            else
+            {
+                SysEnv.map_gen_workers = max(1, min(atoi(next_arg), 64));
+                nextUsed = true;
+            }
+#else
+            end(1, false, "%s", dbg_stat_err);
+#endif
+            break;
+
         case CLO_ARENA:
             if (!rc_only)
             {
@@ -4462,6 +4506,13 @@ bool parse_args(int argc, char **argv, bool rc_only)
             crawl_state.dump_maps = true;
             break;
 
+        case CLO_BUILDER_PROFILE:
+            builder_profile_enable(next_is_param ? next_arg
+                                                 : "builder-profile.log");
+            if (next_is_param)
+                nextUsed = true;
+            break;
+
         case CLO_PLAYABLE_JSON:
             fprintf(stdout, "%s", playable_metadata_json().c_str());
             end(0);
@@ -4668,6 +4719,22 @@ bool parse_args(int argc, char **argv, bool rc_only)
                 end(0);
             }
             break;
+
+        case CLO_WEBTILES_RECORD:
+            if (!next_is_param)
+                return false;
+
+            nextUsed            = true;
+            tiles.m_record_name = next_arg;
+            break;
+
+        case CLO_ZYGOTE:
+            if (!next_is_param)
+                return false;
+
+            nextUsed                  = true;
+            crawl_state.zygote_socket = next_arg;
+            break;
 #endif
 
         case CLO_PRINT_CHARSET:
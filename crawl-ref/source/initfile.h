@@ -59,6 +59,8 @@ public:
 
     int map_gen_iters;
     unique_ptr<depth_ranges> map_gen_range;
+    int map_gen_workers;           // Processes to build levels in.
+    string level_hash_baseline;    // Level hashes to compare against.
 
     vector<string> extra_opts_first;
     vector<string> extra_opts_last;
@@ -133,6 +133,72 @@ static string _item_inscription(const item_def &item)
                                              ", ").c_str());
 }
 
+/**
+ * Everything that item_def::name() output depends on, apart from the global
+ * state that invalidate_item_name_cache() is called for.
+ *
+ * Artefact properties and which of them are known are hashed, since
+ * artefact_learn_prop() updates them in place. Other props are only
+ * compared by count: the ones names read (artefact names, corpse monster
+ * names and so on) are set when the item is created, and adding one is
+ * caught by the count changing.
+ */
+struct item_name_key
+{
+    object_class_type base_type;
+    uint8_t sub_type;
+    short plus;
+    short plus2;
+    int special;
+    uint8_t rnd;
+    short quantity;
+    iflags_t flags;
+    coord_def pos;
+    int link;
+    short orig_monnum;
+    level_id orig_place;
+    string inscription;
+    size_t num_props;
+    uint64_t artp_hash;
+    description_level_type descrip;
+    bool terse;
+    bool ident;
+    bool with_inscription;
+    bool quantity_in_words;
+    iflags_t ignore_flags;
+
+    bool operator<(const item_name_key &other) const
+    {
+        return tie(base_type, sub_type, plus, plus2, special, rnd, quantity,
+                   flags, pos, link, orig_monnum, orig_place, inscription,
+                   num_props, artp_hash, descrip, terse, ident,
+                   with_inscription, quantity_in_words, ignore_flags)
+               < tie(other.base_type, other.sub_type, other.plus, other.plus2,
+                     other.special, other.rnd, other.quantity, other.flags,
+                     other.pos, other.link, other.orig_monnum,
+                     other.orig_place, other.inscription, other.num_props,
+                     other.artp_hash, other.descrip, other.terse, other.ident,
+                     other.with_inscription, other.quantity_in_words,
+                     other.ignore_flags);
+    }
+};
+
+// Menus and the message log name the same few items over and over; keep
+// the results until something they could depend on changes.
+#define MAX_CACHED_ITEM_NAMES 1024
+static map<item_name_key, string> item_name_cache;
+item_name_cache_stats item_name_stats;
+
+/**
+ * Forget all cached item names. Called whenever item knowledge changes, and
+ * once per command for everything else that names can depend on (options,
+ * the player's ziggurat count...).
+ */
+void invalidate_item_name_cache()
+{
+    item_name_cache.clear();
+}
+
 string item_def::name(description_level_type descrip, bool terse, bool ident,
                       bool with_inscription, bool quantity_in_words,
                       iflags_t ignore_flags) const
@@ -146,6 +212,27 @@ string item_def::name(description_level_type descrip, bool terse, bool ident,
     if (descrip == DESC_NONE)
         return "";
 
+    // Equipment annotations depend on what the player is wearing, wielding
+    // and quivering, so those names aren't cached.
+    const bool cacheable = descrip != DESC_INVENTORY_EQUIP;
+    const item_name_key key = { base_type, sub_type, plus, plus2, special,
+                                rnd, quantity, flags, pos, link, orig_monnum,
+                                orig_place, inscription,
+                                props.size(), artefact_props_hash(*this),
+                                descrip, terse, ident,
+                                with_inscription, quantity_in_words,
+                                ignore_flags };
+    if (cacheable)
+    {
+        auto cached = item_name_cache.find(key);
+        if (cached != item_name_cache.end())
+        {
+            item_name_stats.hits++;
+            return cached->second;
+        }
+        item_name_stats.misses++;
+    }
+
     ostringstream buff;
 
     const string auxname = name_aux(descrip, terse, ident, with_inscription,
@@ -326,6 +413,13 @@ string item_def::name(description_level_type descrip, bool terse, bool ident,
         buff << " (curse)";
     }
 
+    if (cacheable)
+    {
+        if (item_name_cache.size() >= MAX_CACHED_ITEM_NAMES)
+            item_name_cache.clear();
+        item_name_cache[key] = buff.str();
+    }
+
     return buff.str();
 }
 
@@ -2206,6 +2300,7 @@ bool set_ident_type(object_class_type basetype, int subtype, bool identify)
         return false;
 
     you.type_ids[basetype][subtype] = identify;
+    invalidate_item_name_cache();
     request_autoinscribe();
 
     // Our item knowledge changed in a way that could possibly affect shop
@@ -108,6 +108,14 @@ void display_runes();
 string quant_name(const item_def &item, int quant,
                   description_level_type des, bool terse = false);
 
+struct item_name_cache_stats
+{
+    unsigned int hits;   // Names answered from the cache.
+    unsigned int misses; // Names built from scratch.
+};
+extern item_name_cache_stats item_name_stats;
+void invalidate_item_name_cache();
+
 bool item_brand_known(const item_def &item);
 bool item_type_known(const item_def &item);
 bool item_type_unknown(const item_def &item);
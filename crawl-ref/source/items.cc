@@ -163,6 +163,7 @@ void link_items()
 {
     // First, initialise igrd array.
     igrd.init(NON_ITEM);
+    StashTrack.note_level_changed();
 
     // Link all items on the grid, plus shop inventory,
     // but DON'T link the huge pile of monster items at (-2,-2).
@@ -473,6 +474,7 @@ bool dec_mitm_item_quantity(int obj, int amount)
     }
 
     item.quantity -= amount;
+    StashTrack.note_changed(item.pos);
     return false;
 }
 
@@ -488,6 +490,7 @@ void inc_inv_item_quantity(int obj, int amount)
 void inc_mitm_item_quantity(int obj, int amount)
 {
     mitm[obj].quantity += amount;
+    StashTrack.note_changed(mitm[obj].pos);
 }
 
 void init_item(int item)
@@ -586,6 +589,7 @@ void unlink_item(int dest)
         if (mitm[dest].pos.x != 0 || mitm[dest].pos.y < 5)
 #endif
         ASSERT_IN_BOUNDS(mitm[dest].pos);
+        StashTrack.note_changed(mitm[dest].pos);
 
         // First check the top:
         if (igrd(mitm[dest].pos) == dest)
@@ -730,6 +734,7 @@ void lose_item_stack(const coord_def& where)
         }
     }
     igrd(where) = NON_ITEM;
+    StashTrack.note_changed(where);
 }
 
 /**
@@ -2330,6 +2335,7 @@ bool move_item_to_grid(int *const obj, const coord_def& p, bool silent)
 
     // Move item to coord.
     item.pos = p;
+    StashTrack.note_changed(p);
 
     // Need to move this stationary item to the position in the pile
     // below the lowest non-stationary, non-net item.
@@ -2383,6 +2389,8 @@ void move_item_stack_to_grid(const coord_def& from, const coord_def& to)
 
     igrd(to) = igrd(from);
     igrd(from) = NON_ITEM;
+    StashTrack.note_changed(from);
+    StashTrack.note_changed(to);
 }
 
 // Returns false if no items could be dropped.
@@ -2905,8 +2913,6 @@ static int _autopickup_subtype(const item_def &item)
 
 static bool _is_option_autopickup(const item_def &item, bool ignore_force)
 {
-    string iname = _autopickup_item_name(item);
-
     if (item.base_type < NUM_OBJECT_CLASSES)
     {
         const int force = you.force_autopickup[item.base_type][_autopickup_subtype(item)];
@@ -2916,6 +2922,10 @@ static bool _is_option_autopickup(const item_def &item, bool ignore_force)
     else
         return false;
 
+    // Only built once the \ menu settings have been checked, since they
+    // decide most items.
+    const string iname = _autopickup_item_name(item);
+
 #ifdef CLUA_BINDINGS
     maybe_bool res = clua.callmaybefn("ch_force_autopickup", "is",
                                       &item, iname.c_str());
@@ -4671,6 +4681,8 @@ void move_items(const coord_def r, const coord_def p)
     // Move entire stack over to p.
     igrd(p) = igrd(r);
     igrd(r) = NON_ITEM;
+    StashTrack.note_changed(r);
+    StashTrack.note_changed(p);
 }
 
 // erase everything the player doesn't know
@@ -7,21 +7,26 @@
 
 #include "l-libs.h"
 
+#include "abyss.h"
 #include "act-iter.h"
 #include "branch.h"
 #include "chardump.h"
 #include "cluautil.h"
 #include "coordit.h"
+#include "dgn-proclayouts.h"
 #include "dungeon.h"
 #include "files.h"
 #include "god-wrath.h"
+#include "item-name.h"
 #include "los.h"
+#include "map-cell.h"
 #include "message.h"
 #include "mon-act.h"
 #include "mon-death.h"
 #include "mon-poly.h"
 #include "religion.h"
 #include "stairs.h"
+#include "stash.h"
 #include "state.h"
 #include "stringutil.h"
 #include "tileview.h"
@@ -381,6 +386,64 @@ LUAFN(debug_cpp_assert)
     return 0;
 }
 
+// Usage: created, shared, unshared, allocated = map_cell_allocs()
+// Counters for the monster, item and cloud info stored in map knowledge;
+// see map_cell_payload.
+LUAFN(debug_map_cell_allocs)
+{
+    lua_pushnumber(ls, map_cell_allocs.created);
+    lua_pushnumber(ls, map_cell_allocs.shared);
+    lua_pushnumber(ls, map_cell_allocs.unshared);
+    lua_pushnumber(ls, map_cell_allocs.allocated);
+    return 4;
+}
+
+// Usage: hits, misses = item_name_cache()
+// How many item names were answered from the name cache, and how many had
+// to be built.
+LUAFN(debug_item_name_cache)
+{
+    lua_pushnumber(ls, item_name_stats.hits);
+    lua_pushnumber(ls, item_name_stats.misses);
+    return 2;
+}
+
+// Usage: refreshed, skipped = stash_updates()
+// How many visible cells the stash tracker looked at again, and how many it
+// skipped because nothing there had changed.
+LUAFN(debug_stash_updates)
+{
+    lua_pushnumber(ls, stash_updates.refreshed);
+    lua_pushnumber(ls, stash_updates.skipped);
+    return 2;
+}
+
+// Usage: digest = proclayout_digest(layout, x, y, width, height, depth,
+//                                    batched)
+// A hash of the terrain a procedural layout gives over a block, sampled
+// cell by cell or in one batch. layout is "abyss", "wastes", "forest" or
+// "underworld"; "abyss" leaves out the level the Abyss borrows from.
+LUAFN(debug_proclayout_digest)
+{
+    static const ForestLayout forest;
+    static const UnderworldLayout underworld;
+
+    const string name = luaL_checkstring(ls, 1);
+    const ProceduralLayout *layout = name == "forest" ? &forest
+                                   : name == "underworld" ? &underworld
+                                   : abyss_fixed_layout(name);
+    if (!layout)
+        return luaL_error(ls, "Unknown layout: %s", name.c_str());
+
+    const coord_def corner(luaL_checkint(ls, 2), luaL_checkint(ls, 3));
+    const int width = luaL_checkint(ls, 4);
+    const int height = luaL_checkint(ls, 5);
+    const uint32_t depth = luaL_checknumber(ls, 6);
+    lua_pushnumber(ls, layout_digest(*layout, corner, width, height, depth,
+                                     lua_toboolean(ls, 7)));
+    return 1;
+}
+
 const struct luaL_reg debug_dlib[] =
 {
 { "goto_place", debug_goto_place },
@@ -407,5 +470,9 @@ const struct luaL_reg debug_dlib[] =
 { "seen_monsters_react", debug_seen_monsters_react },
 { "disable", debug_disable },
 { "cpp_assert", debug_cpp_assert },
+{ "map_cell_allocs", debug_map_cell_allocs },
+{ "item_name_cache", debug_item_name_cache },
+{ "stash_updates", debug_stash_updates },
+{ "proclayout_digest", debug_proclayout_digest },
 { nullptr, nullptr }
 };
@@ -350,7 +350,7 @@ static int dgn_map(lua_State *ls)
         return 0;
     }
 
-    vector<string> &lines = map->map.get_lines();
+    vector<string> lines = map->map.get_lines();
     int which_line = luaL_checkint(ls, 2);
     if (which_line < 0)
         which_line += (int) lines.size();
@@ -372,6 +372,7 @@ static int dgn_map(lua_State *ls)
         if (which_line >= 0 && which_line < (int) lines.size())
         {
             lines.erase(lines.begin() + which_line);
+            map->map.set_lines(lines);
             PLUARET(boolean, true);
         }
         return 0;
@@ -384,15 +385,10 @@ static int dgn_map(lua_State *ls)
                    make_stringf("Index %d out of range", which_line).c_str());
     }
 
-    if (which_line < (int) lines.size())
-    {
-        lines[which_line] = newline;
-        return 0;
-    }
-
-    lines.reserve(which_line + 1);
-    lines.resize(which_line + 1, "");
+    if (which_line >= (int) lines.size())
+        lines.resize(which_line + 1, "");
     lines[which_line] = newline;
+    map->map.set_lines(lines);
     return 0;
 }
 
@@ -1449,6 +1445,24 @@ LUAFN(dgn_map_by_tag)
     return 0;
 }
 
+// All maps with the given tag, whatever their depths, in load order.
+LUAFN(dgn_maps_by_tag)
+{
+    const string tag = luaL_checkstring(ls, 1);
+    lua_newtable(ls);
+    int n = 0;
+    for (int i = 0, nmaps = map_count(); i < nmaps; ++i)
+    {
+        const map_def *map = map_by_index(i);
+        if (map->has_tag(tag))
+        {
+            _lua_push_map(ls, map);
+            lua_rawseti(ls, -2, ++n);
+        }
+    }
+    return 1;
+}
+
 LUAFN(dgn_map_by_name)
 {
     if (const char *name = luaL_checkstring(ls, 1))
@@ -1826,6 +1840,7 @@ const struct luaL_reg dgn_dlib[] =
 { "with_map_anchors", dgn_with_map_anchors },
 
 { "map_by_tag", dgn_map_by_tag },
+{ "maps_by_tag", dgn_maps_by_tag },
 { "map_by_name", dgn_map_by_name },
 { "map_in_depth", dgn_map_in_depth },
 { "map_by_place", dgn_map_by_place },
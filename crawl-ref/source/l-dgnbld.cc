@@ -666,6 +666,151 @@ LUAFN(dgn_fill_disconnected)
     return 0;
 }
 
+// The directions zonify.walk() tries, in its order.
+static const coord_def zonify_dirs[] =
+{
+    coord_def(0, -1), coord_def(-1, 0), coord_def(0, 1), coord_def(1, 0),
+    coord_def(-1, -1), coord_def(-1, 1), coord_def(1, 1), coord_def(1, -1),
+};
+
+struct glyph_zone
+{
+    bool wall;
+    int size;
+    vector<coord_def> borders;
+};
+
+// Split the in-bounds cells of lines into connected zones of wall and
+// non-wall glyphs, in the order zonify.map() would find them: it walks each
+// zone depth-first from (1, 1), then walks the zones past each of its
+// borders in turn. That order decides which of two equally large zones
+// fill_small_zones keeps.
+static vector<glyph_zone> _zonify_glyphs(const map_lines &lines,
+                                         const char *wall,
+                                         Matrix<int> &zone_at)
+{
+    auto unzoned = [&](const coord_def &c)
+    {
+        return in_bounds(c) && lines.in_bounds(c) && zone_at(c) < 0;
+    };
+    auto is_wall = [&](const coord_def &c)
+    {
+        return lines(c) && strchr(wall, lines(c));
+    };
+
+    vector<glyph_zone> zones;
+    // Zones whose borders are being walked, with the next border of each.
+    vector<pair<int, size_t>> zone_stack;
+    // Cells of the zone being walked, with the next direction of each.
+    vector<pair<coord_def, int>> cell_stack;
+
+    auto walk_zone = [&](const coord_def &start)
+    {
+        if (!unzoned(start))
+            return;
+
+        const int zone = zones.size();
+        zones.push_back({ is_wall(start), 1, { } });
+        glyph_zone &z = zones.back();
+        zone_at(start) = zone;
+        cell_stack.emplace_back(start, 0);
+        while (!cell_stack.empty())
+        {
+            if (cell_stack.back().second == ARRAYSZ(zonify_dirs))
+            {
+                cell_stack.pop_back();
+                continue;
+            }
+
+            const coord_def c = cell_stack.back().first
+                                + zonify_dirs[cell_stack.back().second++];
+            if (!unzoned(c))
+                continue;
+            if (is_wall(c) != z.wall)
+            {
+                z.borders.push_back(c);
+                continue;
+            }
+
+            zone_at(c) = zone;
+            ++z.size;
+            cell_stack.emplace_back(c, 0);
+        }
+        zone_stack.emplace_back(zone, 0);
+    };
+
+    walk_zone(coord_def(1, 1));
+    while (!zone_stack.empty())
+    {
+        const int zone = zone_stack.back().first;
+        const size_t border = zone_stack.back().second++;
+        if (border == zones[zone].borders.size())
+            zone_stack.pop_back();
+        else
+            walk_zone(zones[zone].borders[border]);
+    }
+
+    return zones;
+}
+
+// Fill all but the largest few zones of non-wall glyphs, like
+// zonify.map_fill_zones() used to in Lua. There's no default for the wall
+// glyphs: zonify.lua keeps the set its callers use.
+LUAFN(dgn_fill_small_zones)
+{
+    LINES(ls, 1, lines);
+
+    TABLE_INT(ls, keep, 1);
+    TABLE_CHAR(ls, fill, 'x');
+    TABLE_INT(ls, min_size, 1);
+    TABLE_STR(ls, wall, nullptr);
+
+    if (!wall)
+        luaL_error(ls, "fill_small_zones needs the wall glyphs.");
+    if (keep <= 0)
+        return 0;
+
+    Matrix<int> zone_at(lines.width(), lines.height(), -1);
+    const vector<glyph_zone> zones = _zonify_glyphs(lines, wall, zone_at);
+
+    // The zones to keep, largest first. Of two zones the same size, the
+    // one found first wins.
+    vector<int> largest(keep, -1);
+    vector<int> largest_size(keep, 0);
+    for (int i = 0; i < (int) zones.size(); ++i)
+    {
+        const int size = zones[i].size;
+        if (zones[i].wall || size <= min_size)
+            continue;
+
+        for (int n = keep - 1; n >= 0 && size > largest_size[n]; --n)
+        {
+            if (n < keep - 1)
+            {
+                largest[n + 1] = largest[n];
+                largest_size[n + 1] = largest_size[n];
+            }
+            largest[n] = i;
+            largest_size[n] = size;
+        }
+    }
+
+    vector<bool> filled(zones.size());
+    for (int i = 0; i < (int) zones.size(); ++i)
+    {
+        filled[i] = !zones[i].wall
+                    && find(largest.begin(), largest.end(), i)
+                       == largest.end();
+    }
+
+    for (int y = 0; y < lines.height(); ++y)
+        for (int x = 0; x < lines.width(); ++x)
+            if (zone_at(x, y) >= 0 && filled[zone_at(x, y)])
+                lines(x, y) = fill;
+
+    return 0;
+}
+
 LUAFN(dgn_is_passable_coord)
 {
     LINES(ls, 1, lines);
@@ -1276,6 +1421,10 @@ LUAFN(dgn_mapgrd_table)
     map_def **mapref = clua_new_userdata<map_def *>(ls, MAPGRD_METATABLE);
     *mapref = map;
 
+    // Somewhere to keep the column tables.
+    lua_newtable(ls);
+    lua_setfenv(ls, -2);
+
     return 1;
 }
 
@@ -2296,6 +2445,7 @@ const struct luaL_reg dgn_build_dlib[] =
     { "extend_map", &dgn_extend_map },
     { "fill_area", &dgn_fill_area },
     { "fill_disconnected", &dgn_fill_disconnected },
+    { "fill_small_zones", &dgn_fill_small_zones },
     { "find_in_area", &dgn_find_in_area },
     { "height", dgn_height },
     { "primary_vault_dimensions", &dgn_primary_vault_dimensions },
@@ -516,6 +516,8 @@ IDEF(is_ranged)
     return 1;
 }
 
+// The stash search index caches annotations that use this; keep the player
+// state it reads in _annotation_context() (stash.cc).
 IDEF(is_throwable)
 {
     if (!item || !item->defined())
@@ -589,6 +591,8 @@ IDEF(can_zombify)
     return 1;
 }
 
+// The stash search index caches annotations that use this; keep the player
+// state it reads in _annotation_context() (stash.cc).
 IDEF(is_preferred_food)
 {
     if (!item || !item->defined())
@@ -929,6 +933,36 @@ static int l_item_do_inc_quantity(lua_State *ls)
 
 IDEFN(inc_quantity, do_inc_quantity)
 
+// Usage: item.learn_artprop(name), where name is as in item.artprops.
+static int l_item_do_learn_artprop(lua_State *ls)
+{
+    ASSERT_DLUA;
+
+    UDATA_ITEM(item);
+
+    if (!item || !item->defined() || !is_artefact(*item))
+    {
+        lua_pushboolean(ls, false);
+        return 1;
+    }
+
+    const string name = luaL_checkstring(ls, 1);
+    for (int i = 0; i < ARTP_NUM_PROPERTIES; ++i)
+    {
+        const artefact_prop_type prop = static_cast<artefact_prop_type>(i);
+        if (name == artp_name(prop))
+        {
+            artefact_learn_prop(*item, prop);
+            lua_pushboolean(ls, true);
+            return 1;
+        }
+    }
+
+    return luaL_argerror(ls, 1, ("unknown property " + name).c_str());
+}
+
+IDEFN(learn_artprop, do_learn_artprop)
+
 static iflags_t _str_to_item_status_flags(string flag)
 {
     iflags_t flags = 0;
@@ -1360,6 +1394,7 @@ static ItemAccessor item_attrs[] =
     { "destroy",           l_item_destroy },
     { "dec_quantity",      l_item_dec_quantity },
     { "inc_quantity",      l_item_inc_quantity },
+    { "learn_artprop",     l_item_learn_artprop },
     { "identified",        l_item_identified },
     { "base_type",         l_item_base_type },
     { "sub_type",          l_item_sub_type },
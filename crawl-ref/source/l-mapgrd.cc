@@ -14,17 +14,47 @@ struct mapcolumn
     int col;
 };
 
+static char* mapgrd_cell(map_def *map, int col, int row)
+{
+    map_lines &lines = map->map;
+    if (row < 0 || col < 0 || col >= lines.width() || row >= lines.height())
+        return nullptr;
+
+    coord_def mc(col, row);
+    return &lines(mc);
+}
+
 static int mapgrd_get(lua_State *ls)
 {
-    // Return a metatable for this column in the map grid.
     map_def *map = *(map_def **) luaL_checkudata(ls, 1, MAPGRD_METATABLE);
 
+    // Methods, e.g. mapgrd:get(x, y).
+    if (lua_type(ls, 2) == LUA_TSTRING)
+    {
+        luaL_getmetatable(ls, MAPGRD_METATABLE);
+        lua_pushvalue(ls, 2);
+        lua_rawget(ls, -2);
+        return 1;
+    }
+
     int column = luaL_checkint(ls, 2);
 
+    // Return a metatable for this column in the map grid. Columns are kept
+    // in the grid's environment, so that mapgrd[x][y] doesn't make a new
+    // userdata for every cell it touches.
+    lua_getfenv(ls, 1);
+    lua_rawgeti(ls, -1, column);
+    if (!lua_isnil(ls, -1))
+        return 1;
+    lua_pop(ls, 1);
+
     mapcolumn *mapref = clua_new_userdata<mapcolumn>(ls, MAPGRD_COL_METATABLE);
     mapref->map = map;
     mapref->col = column;
 
+    lua_pushvalue(ls, -1);
+    lua_rawseti(ls, -3, column);
+
     return 1;
 }
 
@@ -39,12 +69,7 @@ static char* mapgrd_glyph(lua_State *ls, int &col, int &row)
     row = luaL_checkint(ls, 2);
     col = mapc->col;
 
-    map_lines &lines = mapc->map->map;
-    if (row < 0 || col < 0 || col >= lines.width() || row >= lines.height())
-        return nullptr;
-
-    coord_def mc(col, row);
-    return &lines(mc);
+    return mapgrd_cell(mapc->map, col, row);
 }
 
 static int mapgrd_col_get(lua_State *ls)
@@ -79,6 +104,84 @@ static int mapgrd_col_set(lua_State *ls)
     return 0;
 }
 
+/////////////////////////////////////////////////////////////////////
+// mapgrd methods, which reach the map's glyphs in a single call.
+
+static map_def *mapgrd_map(lua_State *ls)
+{
+    return *(map_def **) luaL_checkudata(ls, 1, MAPGRD_METATABLE);
+}
+
+// mapgrd:get(x, y) is the same as mapgrd[x][y].
+static int mapgrd_get_glyph(lua_State *ls)
+{
+    const int col = luaL_checkint(ls, 2);
+    const int row = luaL_checkint(ls, 3);
+    char *gly = mapgrd_cell(mapgrd_map(ls), col, row);
+    if (!gly)
+        return luaL_error(ls, "Invalid coords: %d, %d", col, row);
+
+    lua_pushlstring(ls, gly, 1);
+    return 1;
+}
+
+// mapgrd:set(x, y, glyph) is the same as mapgrd[x][y] = glyph.
+static int mapgrd_set_glyph(lua_State *ls)
+{
+    const int col = luaL_checkint(ls, 2);
+    const int row = luaL_checkint(ls, 3);
+    char *gly = mapgrd_cell(mapgrd_map(ls), col, row);
+    if (!gly)
+        return luaL_error(ls, "Invalid coords: %d, %d", col, row);
+
+    const char *str = luaL_checkstring(ls, 4);
+    if (!str[0] || str[1])
+        return luaL_error(ls, "%s", "mapgrd must be set to a single char.");
+
+    (*gly) = str[0];
+    return 0;
+}
+
+// mapgrd:row(y) returns row y of the map as a string.
+static int mapgrd_row(lua_State *ls)
+{
+    map_def *map = mapgrd_map(ls);
+    const int row = luaL_checkint(ls, 2);
+    char *gly = mapgrd_cell(map, 0, row);
+    if (!gly)
+        return luaL_error(ls, "Invalid row: %d", row);
+
+    lua_pushlstring(ls, gly, map->map.width());
+    return 1;
+}
+
+// mapgrd:set_row(y, glyphs, x) writes glyphs into row y from column x
+// (default 0) on.
+static int mapgrd_set_row(lua_State *ls)
+{
+    map_def *map = mapgrd_map(ls);
+    const int row = luaL_checkint(ls, 2);
+    size_t len;
+    const char *str = luaL_checklstring(ls, 3, &len);
+    const int col = luaL_optint(ls, 4, 0);
+
+    char *gly = mapgrd_cell(map, col, row);
+    if (!gly || col + (int) len > map->map.width())
+        return luaL_error(ls, "Invalid coords: %d, %d", col, row);
+
+    memcpy(gly, str, len);
+    return 0;
+}
+
+static const luaL_reg mapgrd_methods[] =
+{
+    { "get", mapgrd_get_glyph },
+    { "set", mapgrd_set_glyph },
+    { "row", mapgrd_row },
+    { "set_row", mapgrd_set_row },
+    { nullptr, nullptr }
+};
+
 void dluaopen_mapgrd(lua_State *ls)
 {
     // mapgrd table
@@ -91,6 +194,8 @@ void dluaopen_mapgrd(lua_State *ls)
     lua_pushcfunction(ls, mapgrd_set);
     lua_settable(ls, -3);
 
+    luaL_openlib(ls, nullptr, mapgrd_methods, 0);
+
     lua_pop(ls, 1);
 
     // mapgrd col table
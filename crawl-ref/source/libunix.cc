@@ -1571,8 +1571,9 @@ void delay(unsigned int time)
         return;
 
 #ifdef USE_TILE_WEB
-    tiles.redraw();
-    if (time)
+    // Frames of runs and rests may be coalesced; only ask the client to
+    // pause on frames it actually got.
+    if (tiles.redraw(true) && time)
     {
         tiles.send_message("{\"msg\":\"delay\",\"t\":%d}", time);
         tiles.flush_messages();
@@ -44,6 +44,7 @@
 #include "state.h"
 #include "stringutil.h"
 #include "syscalls.h"
+#include "tiles-build-specific.h"
 #include "unicode.h"
 #include "version.h"
 
@@ -650,6 +651,10 @@ int macro_buf_get()
     for (key_recorder *recorder : recorders)
         recorder->add_key(key);
 
+#ifdef USE_TILE_WEB
+    tiles.record_input(key);
+#endif
+
     return key;
 }
 
@@ -166,6 +166,9 @@
 #include "wiz-you.h" // FREEZE_TIME_KEY
 #include "wizard.h" // handle_wizard_command() and enter_explore_mode()
 #include "xom.h" // XOM_CLOUD_TRAIL_TYPE_KEY
+#ifdef USE_TILE_WEB
+#include "zygote.h"
+#endif
 
 // ----------------------------------------------------------------------
 // Globals whose construction/destruction order needs to be managed
@@ -309,6 +312,21 @@ int main(int argc, char *argv[])
     // make sure all the expected data directories exist
     validate_basedirs();
 
+#ifdef USE_TILE_WEB
+    // A zygote only gets past this point in a forked game process, which
+    // starts over with the command line of the game that was requested.
+    if (!crawl_state.zygote_socket.empty())
+    {
+        zygote_serve(argc, argv);
+        if (!parse_args(argc, argv, true))
+        {
+            _show_commandline_options_help();
+            return 1;
+        }
+        validate_basedirs();
+    }
+#endif
+
     // Read the init file.
     read_init_file();
 
@@ -352,6 +370,7 @@ static void _reset_game()
     macro_clear_buffers();
     the_lost_ones.clear();
     you = player();
+    invalidate_item_name_cache();
     reset_hud();
     StashTrack = StashTracker();
     travel_cache = TravelCache();
@@ -555,14 +574,29 @@ static void _show_commandline_options_help()
          "iterations");
     puts("  -force-map <map>    For -mapstat and -objstat, alway choose the "
          "      given map on every level.");
+    puts("  -levelhash [<levels>] with -seed <seed>, build the given range of "
+         "levels");
+    puts("      (default entire dungeon) and write a hash of each to "
+         "levelhash.log");
+    puts("  -levelhash-diff <file>  For -levelhash, report the levels whose "
+         "hashes differ");
+    puts("      from those in <file>, and exit with status 1 if any do");
+    puts("  -workers <num>      For -levelhash, build levels in <num> "
+         "processes");
 #endif
     puts("");
     puts("Miscellaneous options:");
     puts("  -dump-maps       write map Lua to stderr when parsing .des files");
+    puts("  -builder-profile [<file>]  time level generation and write a report");
+    puts("                   to <file> (default builder-profile.log) on exit");
 #ifndef TARGET_OS_WINDOWS
     puts("  -gdb/-no-gdb     produce gdb backtrace when a crash happens (default:on)");
 #endif
     puts("  -playable-json   list playable species, jobs, and character combos.");
+#ifdef USE_TILE_WEB
+    puts("  -zygote <socket> load game data once, then fork a game for each");
+    puts("                   request on <socket> (for webtiles servers)");
+#endif
 
 #if defined(TARGET_OS_WINDOWS) && defined(USE_TILE_LOCAL)
     text_popup(help, L"Dungeon Crawl command line help");
@@ -978,6 +1012,9 @@ static void _input()
     you.reset_escaped_death();
 
     reset_damage_counters();
+    invalidate_tracer_cache();
+    invalidate_item_name_cache();
+    pregenerate_levels();
 
     if (you.pending_revival)
     {
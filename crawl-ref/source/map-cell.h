@@ -57,56 +57,149 @@ struct cloud_info
     killer_type killer;
 };
 
+/// Allocation counters for map_cell payloads; see map_cell_payload.
+struct map_cell_alloc_stats
+{
+    uint64_t created;   // payloads stored in a cell
+    uint64_t shared;    // cell copies that just added a reference
+    uint64_t unshared;  // copies made to modify a shared payload
+    uint64_t allocated; // blocks requested from the general allocator
+};
+
+extern map_cell_alloc_stats map_cell_allocs;
+
 /*
- * A map_cell stores what the player knows about a cell.
- * These go in env.map_knowledge.
+ * Reference-counted, copy-on-write storage for the monster, item and cloud
+ * info in a map_cell. Copying a cell (the tiles framework's copy of the map
+ * knowledge, or a level's knowledge being saved) just adds a reference; the
+ * payload itself is copied only if it is edited while shared. Freed payloads
+ * go on a per-type free list and are allocated in blocks, so per-turn
+ * updates mostly don't reach the general allocator. The pool never shrinks.
  */
-struct map_cell
+template <class T>
+class map_cell_payload
 {
-    map_cell() : flags(0), _feat(DNGN_UNSEEN), _feat_colour(0),
-                 _trap(TRAP_UNASSIGNED), _cloud(0), _item(0), _mons(0)
+public:
+    map_cell_payload() : _node(nullptr) { }
+
+    map_cell_payload(const map_cell_payload &other) : _node(other._node)
     {
+        if (_node)
+        {
+            ++_node->refs;
+            ++map_cell_allocs.shared;
+        }
     }
 
-    map_cell(const map_cell& c)
+    ~map_cell_payload()
     {
-        memcpy(this, &c, sizeof(map_cell));
-        if (_cloud)
-            _cloud = new cloud_info(*_cloud);
-        if (_mons)
-            _mons = new monster_info(*_mons);
-        if (_item)
-            _item = new item_info(*_item);
+        reset();
     }
 
-    ~map_cell()
+    map_cell_payload &operator=(const map_cell_payload &other)
     {
-        if (_cloud)
-            delete _cloud;
-        if (!(flags & MAP_DETECTED_MONSTER) && _mons)
-            delete _mons;
-        if (_item)
-            delete _item;
+        node *n = other._node;
+        if (n)
+        {
+            ++n->refs;
+            ++map_cell_allocs.shared;
+        }
+        reset();
+        _node = n;
+        return *this;
     }
 
-    map_cell& operator=(const map_cell& c)
+    const T *get() const
+    {
+        return _node ? &_node->value() : nullptr;
+    }
+
+    /// Get the payload for modification, copying it first if it's shared.
+    T *edit()
+    {
+        if (_node && _node->refs > 1)
+        {
+            node *copy = _alloc(_node->value());
+            --_node->refs;
+            _node = copy;
+            ++map_cell_allocs.unshared;
+        }
+        return _node ? &_node->value() : nullptr;
+    }
+
+    void set(const T &val)
+    {
+        ++map_cell_allocs.created;
+        if (_node && _node->refs == 1)
+            _node->value() = val;
+        else
+        {
+            reset();
+            _node = _alloc(val);
+        }
+    }
+
+    void reset()
+    {
+        if (_node && !--_node->refs)
+            _free(_node);
+        _node = nullptr;
+    }
+
+private:
+    struct node
+    {
+        typename aligned_storage<sizeof(T), alignof(T)>::type storage;
+        unsigned int refs;
+        node *next;   // Only used on the free list.
+
+        T &value() { return *reinterpret_cast<T*>(&storage); }
+    };
+
+    static const int BLOCK_SIZE = 64;
+    static node *free_list;
+
+    static node *_alloc(const T &val)
+    {
+        if (!free_list)
+        {
+            node *block = new node[BLOCK_SIZE];
+            ++map_cell_allocs.allocated;
+            for (int i = 0; i < BLOCK_SIZE; ++i)
+            {
+                block[i].next = free_list;
+                free_list = &block[i];
+            }
+        }
+        node *n = free_list;
+        free_list = n->next;
+        new (&n->storage) T(val);
+        n->refs = 1;
+        return n;
+    }
+
+    static void _free(node *n)
+    {
+        n->value().~T();
+        n->next = free_list;
+        free_list = n;
+    }
+
+    node *_node;
+};
+
+template <class T>
+typename map_cell_payload<T>::node *map_cell_payload<T>::free_list = nullptr;
+
+/*
+ * A map_cell stores what the player knows about a cell.
+ * These go in env.map_knowledge.
+ */
+struct map_cell
+{
+    map_cell() : flags(0), _feat(DNGN_UNSEEN), _feat_colour(0),
+                 _trap(TRAP_UNASSIGNED)
     {
-        if (&c == this)
-            return *this;
-        if (_cloud)
-            delete _cloud;
-        if (_mons)
-            delete _mons;
-        if (_item)
-            delete _item;
-        memcpy(this, &c, sizeof(map_cell));
-        if (_cloud)
-            _cloud = new cloud_info(*_cloud);
-        if (_mons)
-            _mons = new monster_info(*_mons);
-        if (_item)
-            _item = new item_info(*_item);
-        return *this;
     }
 
     void clear()
@@ -144,16 +237,21 @@ struct map_cell
         _trap = tr;
     }
 
-    item_info* item() const
+    const item_info* item() const
     {
-        return _item;
+        return _item.get();
+    }
+
+    item_info* edit_item()
+    {
+        return _item.edit();
     }
 
     bool detected_item() const
     {
         const bool ret = !!(flags & MAP_DETECTED_ITEM);
         // TODO: change to an ASSERT when the underlying crash goes away
-        if (ret && !_item)
+        if (ret && !_item.get())
         {
             //clear_item();
             return false;
@@ -164,7 +262,7 @@ struct map_cell
     void set_item(const item_info& ii, bool more_items)
     {
         clear_item();
-        _item = new item_info(ii);
+        _item.set(ii);
         if (more_items)
             flags |= MAP_MORE_ITEMS;
     }
@@ -173,31 +271,32 @@ struct map_cell
 
     void clear_item()
     {
-        if (_item)
-        {
-            delete _item;
-            _item = 0;
-        }
+        _item.reset();
         flags &= ~(MAP_DETECTED_ITEM | MAP_MORE_ITEMS);
     }
 
     monster_type monster() const
     {
-        if (_mons)
-            return _mons->type;
+        if (_mons.get())
+            return _mons.get()->type;
         else
             return MONS_NO_MONSTER;
     }
 
-    monster_info* monsterinfo() const
+    const monster_info* monsterinfo() const
     {
-        return _mons;
+        return _mons.get();
+    }
+
+    monster_info* edit_monsterinfo()
+    {
+        return _mons.edit();
     }
 
     void set_monster(const monster_info& mi)
     {
         clear_monster();
-        _mons = new monster_info(mi);
+        _mons.set(mi);
     }
 
     bool detected_monster() const
@@ -213,8 +312,9 @@ struct map_cell
     void set_detected_monster(monster_type mons)
     {
         clear_monster();
-        _mons = new monster_info(MONS_SENSED);
-        _mons->base_type = mons;
+        monster_info mi(MONS_SENSED);
+        mi.base_type = mons;
+        _mons.set(mi);
         flags |= MAP_DETECTED_MONSTER;
     }
 
@@ -226,47 +326,44 @@ struct map_cell
 
     void clear_monster()
     {
-        if (_mons)
-            delete _mons;
+        _mons.reset();
         flags &= ~(MAP_DETECTED_MONSTER | MAP_INVISIBLE_MONSTER);
-        _mons = 0;
     }
 
     cloud_type cloud() const
     {
-        if (_cloud)
-            return _cloud->type;
+        if (_cloud.get())
+            return _cloud.get()->type;
         else
             return CLOUD_NONE;
     }
 
     unsigned cloud_colour() const
     {
-        if (_cloud)
-            return _cloud->colour;
+        if (_cloud.get())
+            return _cloud.get()->colour;
         else
             return 0;
     }
 
-    cloud_info* cloudinfo() const
+    const cloud_info* cloudinfo() const
+    {
+        return _cloud.get();
+    }
+
+    cloud_info* edit_cloudinfo()
     {
-        return _cloud;
+        return _cloud.edit();
     }
 
     void set_cloud(const cloud_info& ci)
     {
-        if (_cloud)
-            delete _cloud;
-        _cloud = new cloud_info(ci);
+        _cloud.set(ci);
     }
 
     void clear_cloud()
     {
-        if (_cloud)
-        {
-            delete _cloud;
-            _cloud = 0;
-        }
+        _cloud.reset();
     }
 
     bool update_cloud_state();
@@ -307,7 +404,7 @@ private:
     dungeon_feature_type _feat:8;
     colour_t _feat_colour;
     trap_type _trap:8;
-    cloud_info* _cloud;
-    item_info* _item;
-    monster_info* _mons;
+    map_cell_payload<cloud_info> _cloud;
+    map_cell_payload<item_info> _item;
+    map_cell_payload<monster_info> _mons;
 };
@@ -19,6 +19,8 @@
 #include "travel.h"
 #include "view.h"
 
+map_cell_alloc_stats map_cell_allocs;
+
 void set_terrain_mapped(const coord_def gc)
 {
     map_cell* cell = &env.map_knowledge(gc);
@@ -172,9 +174,10 @@ void map_cell::set_detected_item()
 {
     clear_item();
     flags |= MAP_DETECTED_ITEM;
-    _item = new item_info();
-    _item->base_type = OBJ_DETECTED;
-    _item->rnd       = 1;
+    item_info item;
+    item.base_type = OBJ_DETECTED;
+    item.rnd       = 1;
+    _item.set(item);
 }
 
 static bool _floor_mf(map_feature mf)
@@ -309,15 +312,16 @@ bool map_cell::update_cloud_state()
         return false; // we're already up-to-date
 
     // player non-opaque clouds vanish instantly out of los
-    if (_cloud && _cloud->killer == KILL_YOU_MISSILE
-        && !is_opaque_cloud(_cloud->type))
+    const cloud_info *cloud = cloudinfo();
+    if (cloud && cloud->killer == KILL_YOU_MISSILE
+        && !is_opaque_cloud(cloud->type))
     {
         clear_cloud();
         return true;
     }
 
     // still winds KOs all clouds, even those out of LOS
-    if (_cloud && env.level_state & LSTATE_STILL_WINDS)
+    if (cloud && env.level_state & LSTATE_STILL_WINDS)
     {
         clear_cloud();
         return true;
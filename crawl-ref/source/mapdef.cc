@@ -23,6 +23,7 @@
 #include "decks.h"
 #include "describe.h"
 #include "dgn-height.h"
+#include "dgn-profile.h"
 #include "dungeon.h"
 #include "end.h"
 #include "english.h"
@@ -429,9 +430,18 @@ bool level_range::valid() const
 ////////////////////////////////////////////////////////////////////////
 // map_lines
 
+// Mark the glyphs in a string in a lookup table indexed by glyph, so that
+// transformations only need to look at each cell of the map once.
+static void _glyph_table(FixedVector<bool, 256> &table, const string &glyphs)
+{
+    table.init(false);
+    for (const char c : glyphs)
+        table[static_cast<unsigned char>(c)] = true;
+}
+
 map_lines::map_lines()
-    : markers(), lines(), overlay(),
-      map_width(0), solid_north(false), solid_east(false),
+    : markers(), grid(), overlay(),
+      map_width(0), map_height(0), solid_north(false), solid_east(false),
       solid_south(false), solid_west(false), solid_checked(false)
 {
 }
@@ -446,7 +456,7 @@ void map_lines::write_maplines(writer &outf) const
     const int h = height();
     marshallShort(outf, h);
     for (int i = 0; i < h; ++i)
-        marshallString(outf, lines[i]);
+        marshallString(outf, row_string(i));
 }
 
 void map_lines::read_maplines(reader &inf)
@@ -471,22 +481,22 @@ rectangle_iterator map_lines::get_iter() const
 
 char map_lines::operator () (const coord_def &c) const
 {
-    return lines[c.y][c.x];
+    return grid[c.y * map_width + c.x];
 }
 
 char& map_lines::operator () (const coord_def &c)
 {
-    return lines[c.y][c.x];
+    return grid[c.y * map_width + c.x];
 }
 
 char map_lines::operator () (int x, int y) const
 {
-    return lines[y][x];
+    return grid[y * map_width + x];
 }
 
 char& map_lines::operator () (int x, int y)
 {
-    return lines[y][x];
+    return grid[y * map_width + x];
 }
 
 bool map_lines::in_bounds(const coord_def &c) const
@@ -496,7 +506,7 @@ bool map_lines::in_bounds(const coord_def &c) const
 
 bool map_lines::in_map(const coord_def &c) const
 {
-    return in_bounds(c) && lines[c.y][c.x] != ' ';
+    return in_bounds(c) && (*this)(c) != ' ';
 }
 
 map_lines &map_lines::operator = (const map_lines &map)
@@ -516,8 +526,9 @@ void map_lines::init_from(const map_lines &map)
     // Markers have to be regenerated, they will not be copied.
     clear_markers();
     overlay.reset(nullptr);
-    lines            = map.lines;
+    grid             = map.grid;
     map_width        = map.map_width;
+    map_height       = map.map_height;
     solid_north      = map.solid_north;
     solid_east       = map.solid_east;
     solid_south      = map.solid_south;
@@ -668,21 +679,61 @@ void map_lines::apply_overlays(const coord_def &c, bool is_layout)
     apply_grid_overlay(c, is_layout);
 }
 
-const vector<string> &map_lines::get_lines() const
+// A line of the map, without the padding of a line that hasn't been
+// normalised.
+string map_lines::row_string(int y) const
 {
-    return lines;
+    if (!map_width)
+        return "";
+
+    const char *row = &grid[y * map_width];
+    int len = map_width;
+    while (len > 0 && !row[len - 1])
+        --len;
+    return string(row, len);
 }
 
-vector<string> &map_lines::get_lines()
+vector<string> map_lines::get_lines() const
 {
+    vector<string> lines;
+    lines.reserve(map_height);
+    for (int y = 0; y < map_height; ++y)
+        lines.push_back(row_string(y));
     return lines;
 }
 
+void map_lines::set_lines(const vector<string> &new_lines)
+{
+    grid.clear();
+    map_width = map_height = 0;
+    for (const string &s : new_lines)
+        add_line(s);
+    solid_checked = false;
+}
+
+// Widen the grid to new_width, padding the lines with NULs.
+void map_lines::widen(int new_width)
+{
+    ASSERT(new_width > map_width);
+
+    vector<char> wider(new_width * map_height, '\0');
+    for (int y = 0; y < map_height; ++y)
+    {
+        copy(grid.begin() + y * map_width, grid.begin() + (y + 1) * map_width,
+             wider.begin() + y * new_width);
+    }
+    grid.swap(wider);
+    map_width = new_width;
+}
+
 void map_lines::add_line(const string &s)
 {
-    lines.push_back(s);
     if (static_cast<int>(s.length()) > map_width)
-        map_width = s.length();
+        widen(s.length());
+
+    grid.resize(grid.size() + map_width, '\0');
+    copy(s.begin(), s.end(), grid.end() - map_width);
+    ++map_height;
 }
 
 string map_lines::clean_shuffle(string s)
@@ -1018,7 +1069,7 @@ int map_lines::width() const
 
 int map_lines::height() const
 {
-    return lines.size();
+    return map_height;
 }
 
 void map_lines::extend(int min_width, int min_height, char fill)
@@ -1030,18 +1081,17 @@ void map_lines::extend(int min_width, int min_height, char fill)
     int old_width = width();
     int old_height = height();
 
-    if (static_cast<int>(lines.size()) < min_height)
+    if (height() < min_height)
     {
         dirty = true;
-        while (static_cast<int>(lines.size()) < min_height)
+        while (height() < min_height)
             add_line(string(min_width, fill));
     }
 
     if (width() < min_width)
     {
         dirty = true;
-        lines[0] += string(min_width - width(), fill);
-        map_width = max(map_width, min_width);
+        widen(min_width);
     }
 
     if (!dirty)
@@ -1069,7 +1119,7 @@ coord_def map_lines::size() const
 
 int map_lines::glyph(int x, int y) const
 {
-    return lines[y][x];
+    return (*this)(x, y);
 }
 
 int map_lines::glyph(const coord_def &c) const
@@ -1131,10 +1181,10 @@ bool map_lines::solid_borders(map_section_type border)
 void map_lines::clear()
 {
     clear_markers();
-    lines.clear();
+    grid.clear();
     keyspecs.clear();
     overlay.reset(nullptr);
-    map_width = 0;
+    map_width = map_height = 0;
     solid_checked = false;
 
     // First non-legal character.
@@ -1151,8 +1201,11 @@ void map_lines::subst(string &s, subst_spec &spec)
 void map_lines::subst(subst_spec &spec)
 {
     ASSERT(!spec.key.empty());
-    for (string &line : lines)
-        subst(line, spec);
+    FixedVector<bool, 256> wanted;
+    _glyph_table(wanted, spec.key);
+    for (char &c : grid)
+        if (wanted[static_cast<unsigned char>(c)])
+            c = spec.value();
 }
 
 void map_lines::bind_overlay()
@@ -1412,34 +1465,26 @@ void map_lines::overlay_tiles(tile_spec &spec)
     if (!overlay)
         overlay.reset(new overlay_matrix(width(), height()));
 
-    for (int y = 0, ysize = lines.size(); y < ysize; ++y)
+    for (iterator mi(*this, spec.key); mi; ++mi)
     {
-        string::size_type pos = 0;
-        while ((pos = lines[y].find_first_of(spec.key, pos)) != string::npos)
-        {
-            if (spec.floor)
-                (*overlay)(pos, y).floortile = spec.get_tile();
-            else if (spec.feat)
-                (*overlay)(pos, y).tile      = spec.get_tile();
-            else
-                (*overlay)(pos, y).rocktile  = spec.get_tile();
+        overlay_def &cell = (*overlay)(*mi);
+        if (spec.floor)
+            cell.floortile = spec.get_tile();
+        else if (spec.feat)
+            cell.tile      = spec.get_tile();
+        else
+            cell.rocktile  = spec.get_tile();
 
-            (*overlay)(pos, y).no_random = spec.no_random;
-            (*overlay)(pos, y).last_tile = spec.last_tile;
-            ++pos;
-        }
+        cell.no_random = spec.no_random;
+        cell.last_tile = spec.last_tile;
     }
 }
 
 void map_lines::nsubst(nsubst_spec &spec)
 {
     vector<coord_def> positions;
-    for (int y = 0, ysize = lines.size(); y < ysize; ++y)
-    {
-        string::size_type pos = 0;
-        while ((pos = lines[y].find_first_of(spec.key, pos)) != string::npos)
-            positions.emplace_back(pos++, y);
-    }
+    for (iterator mi(*this, spec.key); mi; ++mi)
+        positions.push_back(*mi);
     shuffle_array(positions);
 
     int pcount = 0;
@@ -1462,8 +1507,7 @@ int map_lines::apply_nsubst(vector<coord_def> &pos, int start, int nsub,
     for (int i = start; i < end; ++i)
     {
         const int val = spec.value();
-        const coord_def &c = pos[i];
-        lines[c.y][c.x] = val;
+        (*this)(pos[i]) = val;
         ++substituted;
     }
     return substituted;
@@ -1502,43 +1546,36 @@ void map_lines::resolve_shuffle(const string &shufflage)
     if (toshuffle.empty() || shuffled.empty())
         return;
 
-    for (string &s : lines)
-    {
-        for (char &c : s)
-        {
-            string::size_type pos = toshuffle.find(c);
-            if (pos != string::npos)
-                c = shuffled[pos];
-        }
-    }
+    // A glyph that appears more than once is replaced as its first
+    // appearance says.
+    char replacement[256];
+    for (int i = 0; i < 256; ++i)
+        replacement[i] = static_cast<char>(i);
+    for (int i = toshuffle.length() - 1; i >= 0; --i)
+        replacement[static_cast<unsigned char>(toshuffle[i])] = shuffled[i];
+
+    for (char &c : grid)
+        c = replacement[static_cast<unsigned char>(c)];
 }
 
 void map_lines::clear(const string &clearchars)
 {
-    for (string &s : lines)
-    {
-        for (char &c : s)
-        {
-            string::size_type pos = clearchars.find(c);
-            if (pos != string::npos)
-                c = ' ';
-        }
-    }
+    FixedVector<bool, 256> wanted;
+    _glyph_table(wanted, clearchars);
+    for (char &c : grid)
+        if (wanted[static_cast<unsigned char>(c)])
+            c = ' ';
 }
 
 void map_lines::normalise(char fillch)
 {
-    for (string &s : lines)
-        if (static_cast<int>(s.length()) < map_width)
-            s += string(map_width - s.length(), fillch);
+    replace(grid.begin(), grid.end(), '\0', fillch);
 }
 
 // Should never be attempted if the map has a defined orientation, or if one
 // of the dimensions is greater than the lesser of GXM,GYM.
 void map_lines::rotate(bool clockwise)
 {
-    vector<string> newlines;
-
     // normalise() first for convenience.
     normalise();
 
@@ -1546,31 +1583,28 @@ void map_lines::rotate(bool clockwise)
               xe = clockwise? map_width : -1,
               xi = clockwise? 1 : -1;
 
-    const int ys = clockwise? (int) lines.size() - 1 : 0,
-              ye = clockwise? -1 : (int) lines.size(),
+    const int ys = clockwise? map_height - 1 : 0,
+              ye = clockwise? -1 : map_height,
               yi = clockwise? -1 : 1;
 
+    // Old column i becomes new row y.
+    vector<char> rotated(grid.size());
+    auto out = rotated.begin();
     for (int i = xs; i != xe; i += xi)
-    {
-        string line;
-
         for (int j = ys; j != ye; j += yi)
-            line += lines[j][i];
-
-        newlines.push_back(line);
-    }
+            *out++ = grid[j * map_width + i];
 
     if (overlay)
     {
-        auto new_overlay = make_unique<overlay_matrix>(lines.size(), map_width);
+        auto new_overlay = make_unique<overlay_matrix>(map_height, map_width);
         for (int i = xs, y = 0; i != xe; i += xi, ++y)
             for (int j = ys, x = 0; j != ye; j += yi, ++x)
                 (*new_overlay)(x, y) = (*overlay)(i, j);
         overlay = move(new_overlay);
     }
 
-    map_width = lines.size();
-    lines     = newlines;
+    swap(map_width, map_height);
+    grid.swap(rotated);
     rotate_markers(clockwise);
     solid_checked = false;
 }
@@ -1619,14 +1653,14 @@ void map_lines::rotate_markers(bool clock)
 
 void map_lines::vmirror()
 {
-    const int vsize = lines.size();
+    const int vsize = map_height;
     const int midpoint = vsize / 2;
 
     for (int i = 0; i < midpoint; ++i)
     {
-        string temp = lines[i];
-        lines[i] = lines[vsize - 1 - i];
-        lines[vsize - 1 - i] = temp;
+        swap_ranges(grid.begin() + i * map_width,
+                    grid.begin() + (i + 1) * map_width,
+                    grid.begin() + (vsize - 1 - i) * map_width);
     }
 
     if (overlay)
@@ -1643,13 +1677,15 @@ void map_lines::vmirror()
 void map_lines::hmirror()
 {
     const int midpoint = map_width / 2;
-    for (string &s : lines)
-        for (int j = 0; j < midpoint; ++j)
-            swap(s[j], s[map_width - 1 - j]);
+    for (int i = 0; i < map_height; ++i)
+    {
+        reverse(grid.begin() + i * map_width,
+                grid.begin() + (i + 1) * map_width);
+    }
 
     if (overlay)
     {
-        for (int i = 0, vsize = lines.size(); i < vsize; ++i)
+        for (int i = 0, vsize = map_height; i < vsize; ++i)
             for (int j = 0; j < midpoint; ++j)
                 swap((*overlay)(j, i), (*overlay)(map_width - 1 - j, i));
     }
@@ -1793,24 +1829,21 @@ vector<coord_def> map_lines::find_glyph(const string &glyphs) const
 
 coord_def map_lines::find_first_glyph(int gly) const
 {
-    for (int y = 0, h = height(); y < h; ++y)
-    {
-        string::size_type pos = lines[y].find(gly);
-        if (pos != string::npos)
-            return coord_def(pos, y);
-    }
+    const auto found = find(grid.begin(), grid.end(), static_cast<char>(gly));
+    if (found == grid.end())
+        return coord_def(-1, -1);
 
-    return coord_def(-1, -1);
+    const int pos = found - grid.begin();
+    return coord_def(pos % map_width, pos / map_width);
 }
 
 coord_def map_lines::find_first_glyph(const string &glyphs) const
 {
-    for (int y = 0, h = height(); y < h; ++y)
-    {
-        string::size_type pos = lines[y].find_first_of(glyphs);
-        if (pos != string::npos)
-            return coord_def(pos, y);
-    }
+    FixedVector<bool, 256> wanted;
+    _glyph_table(wanted, glyphs);
+    for (int pos = 0, size = grid.size(); pos < size; ++pos)
+        if (wanted[static_cast<unsigned char>(grid[pos])])
+            return coord_def(pos % map_width, pos / map_width);
     return coord_def(-1, -1);
 }
 
@@ -2004,29 +2037,20 @@ string tile_spec::get_tile()
 // map_lines::iterator
 
 map_lines::iterator::iterator(map_lines &_maplines, const string &_key)
-    : maplines(_maplines), key(_key), p(0, 0)
+    : maplines(_maplines), p(0, 0)
 {
+    _glyph_table(wanted, _key);
     advance();
 }
 
 void map_lines::iterator::advance()
 {
+    const int width = maplines.width();
     const int height = maplines.height();
-    while (p.y < height)
-    {
-        string::size_type place = p.x;
-        if (place < maplines.lines[p.y].length())
-        {
-            place = maplines.lines[p.y].find_first_of(key, place);
-            if (place != string::npos)
-            {
-                p.x = place;
-                break;
-            }
-        }
-        ++p.y;
-        p.x = 0;
-    }
+    for (; p.y < height; ++p.y, p.x = 0)
+        for (; p.x < width; ++p.x)
+            if (wanted[static_cast<unsigned char>(maplines(p))])
+                return;
 }
 
 map_lines::iterator::operator bool() const
@@ -2517,7 +2541,7 @@ string map_def::run_lua(bool run_main)
 {
     dlua_set_map mset(this);
 
-    int err = prelude.load(dlua);
+    int err = prelude.load_cached(dlua);
     if (err == E_CHUNK_LOAD_FAILURE)
         lua_pushnil(dlua);
     else if (err)
@@ -2528,7 +2552,7 @@ string map_def::run_lua(bool run_main)
     if (run_main)
     {
         // Run the map chunk to set up the vault's map grid.
-        err = mapchunk.load(dlua);
+        err = mapchunk.load_cached(dlua);
         if (err == E_CHUNK_LOAD_FAILURE)
             lua_pushnil(dlua);
         else if (err)
@@ -2543,7 +2567,7 @@ string map_def::run_lua(bool run_main)
 
         // Run the main Lua chunk to set up the rest of the vault
         run_hook("pre_main");
-        err = main.load(dlua);
+        err = main.load_cached(dlua);
         if (err == E_CHUNK_LOAD_FAILURE)
             lua_pushnil(dlua);
         else if (err)
@@ -2601,7 +2625,7 @@ bool map_def::test_lua_boolchunk(dlua_chunk &chunk, bool defval,
     bool result = defval;
     dlua_set_map mset(this);
 
-    int err = chunk.load(dlua);
+    int err = chunk.load_cached(dlua);
     if (err == E_CHUNK_LOAD_FAILURE)
         return result;
     else if (err)
@@ -2632,11 +2656,13 @@ bool map_def::test_lua_boolchunk(dlua_chunk &chunk, bool defval,
 
 bool map_def::test_lua_validate(bool croak)
 {
+    builder_phase_scope phase(BPHASE_LUA_VALIDATION);
     return validate.empty() || test_lua_boolchunk(validate, false, croak);
 }
 
 bool map_def::test_lua_veto()
 {
+    builder_phase_scope phase(BPHASE_LUA_VALIDATION);
     return !veto.empty() && test_lua_boolchunk(veto, true);
 }
 
@@ -3247,15 +3273,35 @@ void map_def::fixup()
     }
 }
 
+// Is tag one of the space-separated words in tags?
+static bool _has_single_tag(const string &tags, const string &tag)
+{
+    for (size_t pos = tags.find(tag); pos != string::npos;
+         pos = tags.find(tag, pos + 1))
+    {
+        const size_t end = pos + tag.size();
+        if (pos > 0 && tags[pos - 1] == ' '
+            && end < tags.size() && tags[end] == ' ')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool map_def::has_tag(const string &tagwanted) const
 {
     if (tags.empty() || tagwanted.empty())
         return false;
 
+    // Nearly every caller asks for a single tag; don't split those.
+    if (tagwanted.find_first_of(" \t\n\r") == string::npos)
+        return _has_single_tag(tags, tagwanted);
+
     vector<string> wanted_tags = split_string(" ", tagwanted);
 
     for (const string &tag : wanted_tags)
-        if (tags.find(" " + tag + " ") == string::npos)
+        if (!_has_single_tag(tags, tag))
             return false;
 
     return true;
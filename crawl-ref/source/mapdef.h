@@ -335,7 +335,7 @@ public:
         void advance();
     private:
         map_lines &maplines;
-        string key;
+        FixedVector<bool, 256> wanted;
         coord_def p;
     };
 
@@ -406,8 +406,9 @@ public:
     void apply_grid_overlay(const coord_def &pos, bool is_layout);
     void apply_overlays(const coord_def &pos, bool is_layout);
 
-    const vector<string> &get_lines() const;
-    vector<string> &get_lines();
+    // The map as one string per line; slower than the accessors below.
+    vector<string> get_lines() const;
+    void set_lines(const vector<string> &new_lines);
 
     rectangle_iterator get_iter() const;
     char operator () (const coord_def &c) const;
@@ -443,6 +444,8 @@ public:
                                 const Matrix<bool> &mask, const map_def &vault);
 private:
     void init_from(const map_lines &map);
+    string row_string(int y) const;
+    void widen(int new_width);
     void vmirror_markers();
     void hmirror_markers();
     void rotate_markers(bool clock);
@@ -499,7 +502,10 @@ private:
 
 private:
     vector<map_marker *> markers;
-    vector<string> lines;
+
+    // The glyphs, row by row, in a width() x height() block. Lines that were
+    // added shorter than the widest are padded with NULs until normalise().
+    vector<char> grid;
 
     struct overlay_def
     {
@@ -530,7 +536,7 @@ private:
         SUBVAULT_GLYPH = 1,
     };
 
-    int map_width;
+    int map_width, map_height;
     bool solid_north, solid_east, solid_south, solid_west;
     bool solid_checked;
 };
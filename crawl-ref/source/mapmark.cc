@@ -951,12 +951,15 @@ string map_position_marker::debug_describe() const
 //////////////////////////////////////////////////////////////////////////
 // Map markers in env.
 
-map_markers::map_markers() : markers(), have_inactive_markers(false)
+map_markers::map_markers()
+  : markers(), markers_by_type(), property_markers(), marked_cells(),
+    have_inactive_markers(false)
 {
 }
 
 map_markers::map_markers(const map_markers &c)
-  : markers(), have_inactive_markers(false)
+  : markers(), markers_by_type(), property_markers(), marked_cells(),
+    have_inactive_markers(false)
 {
     init_from(c);
 }
@@ -997,7 +1000,7 @@ void map_markers::activate_all(bool verbose)
         marker->activate(verbose);
     }
 
-    for (auto i = markers.begin(); i != markers.end();)
+    for (auto i = property_markers.begin(); i != property_markers.end();)
     {
         map_marker *marker = i->second;
         ++i;
@@ -1021,25 +1024,57 @@ void map_markers::activate_markers_at(coord_def p)
     }
 }
 
-void map_markers::add(map_marker *marker)
+// Only Lua and wizard-set markers override map_marker::property(); all
+// the others have no properties, so property searches can skip them.
+static bool _marker_has_properties(const map_marker *marker)
 {
-    markers.insert(dgn_pos_marker(marker->pos, marker));
-    have_inactive_markers = true;
+    const map_marker_type type = marker->get_type();
+    return type == MAT_LUA_MARKER || type == MAT_WIZ_PROPS;
 }
 
-void map_markers::unlink_marker(const map_marker *marker)
+static void _erase_marker(multimap<coord_def, map_marker *> &mmap,
+                          const map_marker *marker)
 {
-    auto els = markers.equal_range(marker->pos);
+    auto els = mmap.equal_range(marker->pos);
     for (auto i = els.first; i != els.second; ++i)
     {
         if (i->second == marker)
         {
-            markers.erase(i);
+            mmap.erase(i);
             break;
         }
     }
 }
 
+// Could there be markers at c? Markers off the map aren't tracked by
+// marked_cells, so for those we have to look.
+bool map_markers::maybe_marked(const coord_def &c) const
+{
+    return !map_bounds(c) || marked_cells(c);
+}
+
+void map_markers::add(map_marker *marker)
+{
+    markers.insert(dgn_pos_marker(marker->pos, marker));
+    markers_by_type[marker->get_type()].insert(
+        dgn_pos_marker(marker->pos, marker));
+    if (_marker_has_properties(marker))
+        property_markers.insert(dgn_pos_marker(marker->pos, marker));
+    if (map_bounds(marker->pos))
+        marked_cells.set(marker->pos);
+    have_inactive_markers = true;
+}
+
+void map_markers::unlink_marker(const map_marker *marker)
+{
+    _erase_marker(markers, marker);
+    _erase_marker(markers_by_type[marker->get_type()], marker);
+    if (_marker_has_properties(marker))
+        _erase_marker(property_markers, marker);
+    if (map_bounds(marker->pos) && !markers.count(marker->pos))
+        marked_cells.set(marker->pos, false);
+}
+
 void map_markers::check_empty()
 {
     if (markers.empty())
@@ -1056,14 +1091,12 @@ void map_markers::remove(map_marker *marker)
 void map_markers::remove_markers_at(const coord_def &c,
                                     map_marker_type type)
 {
-    auto els = markers.equal_range(c);
-    for (auto i = els.first; i != els.second;)
+    for (map_marker *marker : get_markers_at(c))
     {
-        auto todel = i++;
-        if (type == MAT_ANY || todel->second->get_type() == type)
+        if (type == MAT_ANY || marker->get_type() == type)
         {
-            delete todel->second;
-            markers.erase(todel);
+            unlink_marker(marker);
+            delete marker;
         }
     }
     check_empty();
@@ -1071,34 +1104,29 @@ void map_markers::remove_markers_at(const coord_def &c,
 
 map_marker *map_markers::find(const coord_def &c, map_marker_type type)
 {
-    auto els = markers.equal_range(c);
-    for (auto i = els.first; i != els.second; ++i)
-        if (type == MAT_ANY || i->second->get_type() == type)
-            return i->second;
-    return nullptr;
+    if (!maybe_marked(c))
+        return nullptr;
+
+    const dgn_marker_map &mmap = type == MAT_ANY ? markers
+                                                 : markers_by_type[type];
+    auto i = mmap.lower_bound(c);
+    return i == mmap.end() || i->first != c ? nullptr : i->second;
 }
 
 map_marker *map_markers::find(map_marker_type type)
 {
-    for (const auto &entry : markers)
-        if (type == MAT_ANY || entry.second->get_type() == type)
-            return entry.second;
-
-    return nullptr;
+    const dgn_marker_map &mmap = type == MAT_ANY ? markers
+                                                 : markers_by_type[type];
+    return mmap.empty() ? nullptr : mmap.begin()->second;
 }
 
 void map_markers::move(const coord_def &from, const coord_def &to)
 {
     unwind_bool inactive(have_inactive_markers);
-    auto els = markers.equal_range(from);
+    const vector<map_marker*> tmarkers = get_markers_at(from);
 
-    list<map_marker*> tmarkers;
-    for (auto i = els.first; i != els.second;)
-    {
-        auto curr = i++;
-        tmarkers.push_back(curr->second);
-        markers.erase(curr);
-    }
+    for (auto mark : tmarkers)
+        unlink_marker(mark);
 
     for (auto mark : tmarkers)
     {
@@ -1117,12 +1145,12 @@ void map_markers::move_marker(map_marker *marker, const coord_def &to)
 
 vector<map_marker*> map_markers::get_all(map_marker_type mat)
 {
+    const dgn_marker_map &mmap = mat == MAT_ANY ? markers
+                                                : markers_by_type[mat];
     vector<map_marker*> rmarkers;
-    for (const auto &entry : markers)
-    {
-        if (mat == MAT_ANY || entry.second->get_type() == mat)
-            rmarkers.push_back(entry.second);
-    }
+    rmarkers.reserve(mmap.size());
+    for (const auto &entry : mmap)
+        rmarkers.push_back(entry.second);
     return rmarkers;
 }
 
@@ -1130,7 +1158,7 @@ vector<map_marker*> map_markers::get_all(const string &key, const string &val)
 {
     vector<map_marker*> rmarkers;
 
-    for (const auto &entry : markers)
+    for (const auto &entry : property_markers)
     {
         map_marker*  marker = entry.second;
         const string prop   = marker->property(key);
@@ -1144,8 +1172,11 @@ vector<map_marker*> map_markers::get_all(const string &key, const string &val)
 
 vector<map_marker*> map_markers::get_markers_at(const coord_def &c)
 {
-    auto els = markers.equal_range(c);
     vector<map_marker*> rmarkers;
+    if (!maybe_marked(c))
+        return rmarkers;
+
+    auto els = markers.equal_range(c);
     for (auto i = els.first; i != els.second; ++i)
         rmarkers.push_back(i->second);
     return rmarkers;
@@ -1154,7 +1185,10 @@ vector<map_marker*> map_markers::get_markers_at(const coord_def &c)
 string map_markers::property_at(const coord_def &c, map_marker_type type,
                                 const string &key)
 {
-    auto els = markers.equal_range(c);
+    if (!maybe_marked(c))
+        return "";
+
+    auto els = property_markers.equal_range(c);
     for (auto i = els.first; i != els.second; ++i)
     {
         const string &prop = i->second->property(key);
@@ -1164,11 +1198,35 @@ string map_markers::property_at(const coord_def &c, map_marker_type type,
     return "";
 }
 
+static bool _less_by_row(const map_marker *a, const map_marker *b)
+{
+    return a->pos.y < b->pos.y || a->pos.y == b->pos.y && a->pos.x < b->pos.x;
+}
+
+/**
+ * Get the markers that can have properties, in the order a
+ * rectangle_iterator would visit their cells, and in the order they were
+ * added within a cell. Markers of other types never have any properties.
+ */
+vector<map_marker*> map_markers::get_property_markers() const
+{
+    vector<map_marker*> rmarkers;
+    rmarkers.reserve(property_markers.size());
+    for (const auto &entry : property_markers)
+        rmarkers.push_back(entry.second);
+    stable_sort(rmarkers.begin(), rmarkers.end(), _less_by_row);
+    return rmarkers;
+}
+
 void map_markers::clear()
 {
     for (auto &entry : markers)
         delete entry.second;
     markers.clear();
+    for (auto &mmap : markers_by_type)
+        mmap.clear();
+    property_markers.clear();
+    marked_cells.reset();
     check_empty();
 }
 
@@ -1236,12 +1294,17 @@ vector<coord_def> find_marker_positions_by_prop(const string &prop,
                                                 unsigned maxresults)
 {
     vector<coord_def> marker_positions;
-    for (rectangle_iterator i(0, 0); i; ++i)
+    coord_def last_pos(-1, -1);
+    for (map_marker *mark : env.markers.get_property_markers())
     {
-        const string value = env.markers.property_at(*i, MAT_ANY, prop);
+        // property_at() looks at all the markers in a cell at once.
+        if (!map_bounds(mark->pos) || mark->pos == last_pos)
+            continue;
+        last_pos = mark->pos;
+        const string value = env.markers.property_at(mark->pos, MAT_ANY, prop);
         if (!value.empty() && (expected.empty() || value == expected))
         {
-            marker_positions.push_back(*i);
+            marker_positions.push_back(mark->pos);
             if (maxresults && marker_positions.size() >= maxresults)
                 return marker_positions;
         }
@@ -1254,17 +1317,16 @@ vector<map_marker*> find_markers_by_prop(const string &prop,
                                          unsigned maxresults)
 {
     vector<map_marker*> markers;
-    for (rectangle_iterator pos(0, 0); pos; ++pos)
+    for (map_marker *mark : env.markers.get_property_markers())
     {
-        for (map_marker *mark : env.markers.get_markers_at(*pos))
+        if (!map_bounds(mark->pos))
+            continue;
+        const string value(mark->property(prop));
+        if (!value.empty() && (expected.empty() || value == expected))
         {
-            const string value(mark->property(prop));
-            if (!value.empty() && (expected.empty() || value == expected))
-            {
-                markers.push_back(mark);
-                if (maxresults && markers.size() >= maxresults)
-                    return markers;
-            }
+            markers.push_back(mark);
+            if (maxresults && markers.size() >= maxresults)
+                return markers;
         }
     }
     return markers;
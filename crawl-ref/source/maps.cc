@@ -149,9 +149,19 @@ static void _dgn_flush_map_environments()
     dlua.callfn("dgn_flush_map_environments", 0, 0);
 }
 
+// The same as dgn_flush_map_environment_for in dungeon.lua, but without the
+// overhead of a Lua call, since this happens for every map we try.
 static void _dgn_flush_map_environment_for(const string &mapname)
 {
-    dlua.callfn("dgn_flush_map_environment_for", "s", mapname.c_str());
+    lua_stack_cleaner clean(dlua);
+    lua_getglobal(dlua, "dgn");
+    if (!lua_istable(dlua, -1))
+        return;
+    lua_getfield(dlua, -1, "_map_envs");
+    if (!lua_istable(dlua, -1))
+        return;
+    lua_pushnil(dlua);
+    lua_setfield(dlua, -2, mapname.c_str());
 }
 
 // Execute the map's Lua, perform substitutions and other transformations,
@@ -418,13 +428,12 @@ static bool _map_safe_vault_place(const map_def &map,
     const bool vault_can_replace_portals =
         map.has_tag("replace_portal");
 
-    const vector<string> &lines = map.map.get_lines();
     for (rectangle_iterator ri(c, c + size - 1); ri; ++ri)
     {
         const coord_def cp(*ri);
         const coord_def dp(cp - c);
 
-        if (lines[dp.y][dp.x] == ' ')
+        if (map.map(dp) == ' ')
             continue;
 
         // Unconditionally allow portal placements to work.
@@ -481,13 +490,11 @@ static bool _connected_minivault_place(const coord_def &c,
         return true;
 
     // Must not be completely isolated.
-    const vector<string> &lines = place.map.map.get_lines();
-
     for (rectangle_iterator ri(c, c + place.size - 1); ri; ++ri)
     {
         const coord_def &ci(*ri);
 
-        if (lines[ci.y - c.y][ci.x - c.x] == ' ')
+        if (place.map.map(ci - c) == ' ')
             continue;
 
         if (_may_overwrite_feature(ci, false, false)
@@ -698,11 +705,13 @@ const map_def *find_map_by_name(const string &name)
 }
 
 // Discards Lua code loaded by all maps to reduce memory use. If any stripped
-// map is reused, its data will be reloaded from the .dsc
+// map is reused, its data will be reloaded from the .dsc. The functions
+// cached for their chunks go too, so the cache only lasts one level build.
 void strip_all_maps()
 {
     for (map_def &mapdef : vdefs)
         mapdef.strip();
+    dlua_chunk::flush_cache(dlua);
 }
 
 vector<string> find_map_matches(const string &name)
@@ -715,6 +724,74 @@ vector<string> find_map_matches(const string &name)
     return matches;
 }
 
+typedef vector<unsigned> vault_indices;
+
+//////////////////////////////////////////////////////////////////////////
+// Vault selection index
+//
+// Rather than testing every map in vdefs, selection looks up the maps that
+// carry a tag, or that could be used at a place, and only tests those. The
+// lists are in vdefs order and are always a superset of the eligible maps,
+// so selection gives the same results as a full scan. They depend only on
+// the index data (tags and depths) that the des cache already stores, which
+// doesn't change once a map is loaded; they're built as needed and thrown
+// away whenever vdefs changes.
+
+// Maps carrying each tag.
+static map<string, vault_indices> maps_by_tag;
+static bool map_tags_indexed = false;
+
+// Maps that map_selector::could_accept() for a (selector type, place,
+// minivault, extra) combination.
+typedef tuple<int, level_id, bool, maybe_bool> map_place_key;
+static map<map_place_key, vault_indices> maps_by_place;
+
+static void _invalidate_map_index()
+{
+    maps_by_tag.clear();
+    maps_by_place.clear();
+    map_tags_indexed = false;
+}
+
+static void _index_map_tags()
+{
+    for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+    {
+        for (const string &tag : vdefs[i].get_tags())
+        {
+            vault_indices &maps = maps_by_tag[tag];
+            // Tags can be given more than once.
+            if (maps.empty() || maps.back() != i)
+                maps.push_back(i);
+        }
+    }
+    map_tags_indexed = true;
+}
+
+// The maps that might have all the space-separated tags in tag, or nullptr
+// if every map has to be checked.
+static const vault_indices *_maps_with_tags(const string &tag)
+{
+    const vector<string> wanted = split_string(" ", tag);
+    if (wanted.empty())
+        return nullptr;
+
+    if (!map_tags_indexed)
+        _index_map_tags();
+
+    static const vault_indices no_maps;
+    const vault_indices *fewest = nullptr;
+    for (const string &t : wanted)
+    {
+        auto found = maps_by_tag.find(t);
+        if (found == maps_by_tag.end())
+            return &no_maps;
+        if (!fewest || found->second.size() < fewest->size())
+            fewest = &found->second;
+    }
+    return fewest;
+}
+
 mapref_vector find_maps_for_tag(const string &tag,
                                 bool check_depth,
                                 bool check_used)
@@ -722,7 +799,7 @@ mapref_vector find_maps_for_tag(const string &tag,
     mapref_vector maps;
     level_id place = level_id::current();
 
-    for (const map_def &mapdef : vdefs)
+    auto consider = [&](const map_def &mapdef)
     {
         if (mapdef.has_tag(tag)
             && !mapdef.has_tag("dummy")
@@ -732,6 +809,17 @@ mapref_vector find_maps_for_tag(const string &tag,
         {
             maps.push_back(&mapdef);
         }
+    };
+
+    if (const vault_indices *candidates = _maps_with_tags(tag))
+    {
+        for (unsigned i : *candidates)
+            consider(vdefs[i]);
+    }
+    else
+    {
+        for (const map_def &mapdef : vdefs)
+            consider(mapdef);
     }
     return maps;
 }
@@ -749,6 +837,7 @@ private:
 
 public:
     bool accept(const map_def &md) const;
+    const vault_indices *candidates() const;
     void announce(const map_def *map) const;
 
     bool valid() const
@@ -804,6 +893,7 @@ private:
     }
 
     bool depth_selectable(const map_def &) const;
+    bool could_accept(const map_def &) const;
 
 public:
     bool ignore_chance;
@@ -839,6 +929,53 @@ static bool _is_extra_compatible(maybe_bool want_extra, bool have_extra)
            || (want_extra == MB_FALSE && !have_extra);
 }
 
+// The part of accept() that depends only on the map's index data and the
+// selector's place, minivault and extra settings, so that it can be cached.
+bool map_selector::could_accept(const map_def &mapdef) const
+{
+    switch (sel)
+    {
+    case PLACE:
+        return mapdef.is_minivault() == mini
+               && _is_extra_compatible(extra, mapdef.has_tag("extra"))
+               && mapdef.place.is_usable_in(place);
+
+    case DEPTH:
+        return mapdef.is_minivault() == mini
+               && _is_extra_compatible(extra, mapdef.has_tag("extra"))
+               && mapdef.is_usable_in(place);
+
+    case DEPTH_AND_CHANCE:
+        return _is_extra_compatible(extra, mapdef.has_tag("extra"))
+               && mapdef.is_usable_in(place);
+
+    default:
+        return true;
+    }
+}
+
+/**
+ * The maps this selector might accept, in vdefs order.
+ *
+ * @return the candidate indices, or nullptr if every map must be checked.
+ */
+const vault_indices *map_selector::candidates() const
+{
+    if (sel == TAG)
+        return _maps_with_tags(tag);
+
+    const map_place_key key(sel, place, mini, extra);
+    auto found = maps_by_place.find(key);
+    if (found != maps_by_place.end())
+        return &found->second;
+
+    vault_indices &maps = maps_by_place[key];
+    for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+        if (could_accept(vdefs[i]))
+            maps.push_back(i);
+    return &maps;
+}
+
 bool map_selector::accept(const map_def &mapdef) const
 {
     switch (sel)
@@ -929,17 +1066,24 @@ string vault_chance_tag(const map_def &map)
     return "";
 }
 
-typedef vector<unsigned> vault_indices;
-
 static vault_indices _eligible_maps_for_selector(const map_selector &sel)
 {
     vault_indices eligible;
 
     if (sel.valid())
     {
-        for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
-            if (sel.accept(vdefs[i]))
-                eligible.push_back(i);
+        if (const vault_indices *candidates = sel.candidates())
+        {
+            for (unsigned i : *candidates)
+                if (sel.accept(vdefs[i]))
+                    eligible.push_back(i);
+        }
+        else
+        {
+            for (unsigned i = 0, size = vdefs.size(); i < size; ++i)
+                if (sel.accept(vdefs[i]))
+                    eligible.push_back(i);
+        }
     }
 
     return eligible;
@@ -1298,6 +1442,7 @@ static bool _load_map_index(const string& cache, const string &base,
     const int nmaps = unmarshallShort(inf);
     const int nexist = vdefs.size();
     vdefs.resize(nexist + nmaps, map_def());
+    _invalidate_map_index();
     for (int i = 0; i < nmaps; ++i)
     {
         map_def &vdef(vdefs[nexist + i]);
@@ -1484,6 +1629,8 @@ void reread_maps()
 
     // BOOM!
     vdefs.clear();
+    _invalidate_map_index();
+    dlua_chunk::flush_cache(dlua);
     map_files_read.clear();
     read_maps();
 }
@@ -1503,6 +1650,7 @@ void add_parsed_map(const map_def &md)
 
     map.fixup();
     vdefs.push_back(map);
+    _invalidate_map_index();
 }
 
 void run_map_global_preludes()
@@ -1531,6 +1679,8 @@ void run_map_local_preludes()
             }
         }
     }
+    // Preludes may have changed tags or depths.
+    _invalidate_map_index();
 }
 
 const map_def *map_by_index(int index)
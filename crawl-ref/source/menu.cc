@@ -2270,18 +2270,40 @@ void Menu::webtiles_write_item(int index, const MenuEntry* me) const
 // Menu colouring
 //
 
+static bool _menu_colour_applies(const colour_mapping &cm, const string &tag)
+{
+    return cm.tag.empty() || cm.tag == "any" || cm.tag == tag
+           || cm.tag == "inventory" && tag == "pickup";
+}
+
+// The indices of the menu colour mappings that can apply to menus with this
+// tag, so that long lists of mappings for other tags needn't be walked.
+static const vector<int> &_menu_colour_candidates(const string &tag)
+{
+    auto bucket = Options.menu_colour_tags.find(tag);
+    if (bucket != Options.menu_colour_tags.end())
+        return bucket->second;
+
+    vector<int> &candidates = Options.menu_colour_tags[tag];
+    for (int i = 0, size = Options.menu_colour_mappings.size(); i < size; ++i)
+        if (_menu_colour_applies(Options.menu_colour_mappings[i], tag))
+            candidates.push_back(i);
+    return candidates;
+}
+
 int menu_colour(const string &text, const string &prefix, const string &tag)
 {
+    const vector<int> &candidates = _menu_colour_candidates(tag);
+    if (candidates.empty())
+        return -1;
+
     const string tmp_text = prefix + text;
 
-    for (const colour_mapping &cm : Options.menu_colour_mappings)
+    for (int i : candidates)
     {
-        if ((cm.tag.empty() || cm.tag == "any" || cm.tag == tag
-               || cm.tag == "inventory" && tag == "pickup")
-            && cm.pattern.matches(tmp_text))
-        {
+        const colour_mapping &cm = Options.menu_colour_mappings[i];
+        if (cm.pattern.matches(tmp_text))
             return cm.colour;
-        }
     }
     return -1;
 }
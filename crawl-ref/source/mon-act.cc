@@ -11,6 +11,7 @@
 #include "areas.h"
 #include "arena.h"
 #include "attitude-change.h"
+#include "beam.h"
 #include "bloodspatter.h"
 #include "butcher.h"
 #include "cloud.h"
@@ -1550,6 +1551,9 @@ void handle_monster_move(monster* mons)
     if (!mons->has_action_energy())
         return;
 
+    // Tracers fired on earlier turns may be out of date.
+    invalidate_tracer_cache();
+
     if (!disabled)
         move_solo_tentacle(mons);
 
@@ -2390,6 +2394,10 @@ void handle_monsters(bool with_noise)
         if (invalid_monster(mon) || !mon->alive() || !mon->has_action_energy())
             continue;
 
+        // Time spent off-level, if it wasn't dealt with when first seen.
+        if (!catch_up_monster(*mon) || !mon->alive())
+            continue;
+
         _update_monster_attitude(mon);
 
         // Only move the monster if nothing else has played with its energy
@@ -36,6 +36,7 @@
 static void _init_player()
 {
     you = player();
+    invalidate_item_name_cache();
     dlua.callfn("dgn_clear_data", "");
 }
 
@@ -459,6 +460,14 @@ static void _setup_generic(const newgame_def& ng)
     you.props[REMOVED_DEAD_SHOPS_KEY] = true;
 #endif
 
+    // The levels of a seeded game are built from the seed itself, not from
+    // a draw that the title screen and menus could have moved.
+    if (Options.seed)
+    {
+        you.props[SEEDED_GAME_KEY] = true;
+        you.game_seed = Options.seed;
+    }
+
     // Needs to happen before we give the player items, so that it's safe to
     // check whether those items need to be removed from their shopping list.
     shopping_list.refresh();
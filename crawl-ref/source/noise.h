@@ -134,8 +134,19 @@ private:
                                        const coord_def &affected_position,
                                        const noise_t &noise) const;
 
+    void touch(const coord_def &pos);
+
 private:
     FixedArray<noise_cell, GXM, GYM> cells;
     vector<noise_t> noises;
     int affected_actor_count;
+
+    // Bounding box of the cells noise has reached, so that reset() only
+    // has to clear those. Empty (top left past bottom right) when clean.
+    coord_def touched_top_left;
+    coord_def touched_bottom_right;
+
+    // The cells to propagate from at the current and next distance; kept
+    // here so that their storage is reused from turn to turn.
+    vector<coord_def> noise_perimeter[2];
 };
@@ -387,6 +387,9 @@ public:
     vector<sound_mapping> sound_mappings;
     string sound_file_path;
     vector<colour_mapping> menu_colour_mappings;
+    // The menu_colour_mappings that can apply to each menu tag, in order;
+    // filled in by menu_colour() and cleared whenever the mappings change.
+    mutable map<string, vector<int>> menu_colour_tags;
     vector<message_colour_mapping> message_colour_mappings;
 
     vector<menu_sort_condition> sort_menus;
@@ -435,6 +438,8 @@ public:
 
     bool        dos_use_background_intensity;
 
+    bool        pregenerate_levels; // Build adjacent levels in the
+                                    // background.
     bool        use_fake_cursor;    // Draw a fake cursor instead of relying
                                     // on the term's own cursor.
     bool        use_fake_player_cursor;
@@ -171,16 +171,199 @@ bool text_pattern::operator== (const text_pattern &tp) const
     return pattern == tp.pattern && ignore_case == tp.ignore_case;
 }
 
+/**
+ * Find the end of a bracket expression, stepping over POSIX classes like
+ * [:alpha:], equivalence classes, collating symbols and escapes.
+ *
+ * @param pattern The regex.
+ * @param start   The index of the opening '['.
+ * @return The index of the closing ']', or string::npos if the expression
+ *         isn't closed, or PCRE and POSIX would read it differently.
+ */
+static size_t _bracket_end(const string &pattern, size_t start)
+{
+    size_t i = start + 1;
+    // A ] straight after [ or [^ is part of the class.
+    if (i < pattern.size() && pattern[i] == '^')
+        ++i;
+    if (i < pattern.size() && pattern[i] == ']')
+        ++i;
+
+    for (; i < pattern.size(); ++i)
+    {
+        switch (pattern[i])
+        {
+        case ']':
+            return i;
+        case '\\':
+            // PCRE escapes the next character; POSIX takes the backslash
+            // literally. They only agree if the next character doesn't
+            // end the class or start a [: :] or \Q..\E.
+            if (i + 1 == pattern.size() || strchr("[]QE", pattern[i + 1]))
+                return string::npos;
+            ++i;
+            break;
+        case '[':
+            if (i + 1 < pattern.size() && strchr(":=.", pattern[i + 1]))
+            {
+                const char close[] = { pattern[i + 1], ']', 0 };
+                i = pattern.find(close, i + 2);
+                if (i == string::npos)
+                    return i;
+                ++i;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return string::npos;
+}
+
+/**
+ * Find the longest run of plain characters that any match of a regex must
+ * contain. Anything that isn't understood ends the run, so the result may
+ * be shorter than it could be, but never wrong.
+ *
+ * @param pattern The regex, in the common subset of PCRE and POSIX ERE.
+ * @return The literal, or an empty string if there isn't a safe one.
+ */
+static string _required_literal(const string &pattern)
+{
+    // (? introduces PCRE inline options like (?i), and lookarounds; \Q
+    // quotes everything up to \E, even inside groups.
+    if (pattern.find("(?") != string::npos
+        || pattern.find("\\Q") != string::npos)
+    {
+        return "";
+    }
+
+    string best, run;
+    const auto end_run = [&]()
+    {
+        if (run.size() > best.size())
+            best = run;
+        run.clear();
+    };
+
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        const char c = pattern[i];
+        switch (c)
+        {
+        case '\\':
+            // Escapes that take arguments, like \x41, \cA, \k<name> or
+            // \Q...\E, would leave their arguments looking like literals.
+            if (i + 1 < pattern.size() && isaalnum(pattern[i + 1])
+                && !strchr("bBdDsSwWAzZG", pattern[i + 1]))
+            {
+                return "";
+            }
+            // \d, \b and so on aren't literals, and nor are GNU's
+            // \< \> \` \' anchors.
+            if (i + 1 == pattern.size() || isaalnum(pattern[i + 1])
+                || strchr("<>`'", pattern[i + 1]))
+            {
+                end_run();
+                ++i;
+            }
+            else
+                run += pattern[++i];
+            break;
+        case '[':
+            end_run();
+            i = _bracket_end(pattern, i);
+            if (i == string::npos)
+                return "";
+            break;
+        case '(':
+        {
+            // Groups may be optional or repeated; skip them whole.
+            end_run();
+            int depth = 1;
+            while (depth && ++i < pattern.size())
+            {
+                if (pattern[i] == '\\')
+                    ++i;
+                else if (pattern[i] == '[')
+                {
+                    i = _bracket_end(pattern, i);
+                    if (i == string::npos)
+                        return "";
+                }
+                else if (pattern[i] == '(')
+                    ++depth;
+                else if (pattern[i] == ')')
+                    --depth;
+            }
+            break;
+        }
+        case '?':
+        case '*':
+        case '{':
+            // The previous character may not be there at all.
+            if (!run.empty())
+                run.erase(run.size() - 1);
+            end_run();
+            if (c == '{')
+            {
+                i = pattern.find('}', i);
+                if (i == string::npos)
+                    return best;
+            }
+            break;
+        case '|':
+            // Top-level alternation; any alternative might match.
+            return "";
+        case '+':
+            // The previous character is there, but may be repeated; unless
+            // another quantifier follows, which POSIX takes to apply to
+            // the whole repetition.
+            if (!run.empty() && i + 1 < pattern.size()
+                && strchr("?*+{", pattern[i + 1]))
+            {
+                run.erase(run.size() - 1);
+            }
+            end_run();
+            break;
+        case '.':
+        case '^':
+        case '$':
+        case ')':
+            end_run();
+            break;
+        default:
+            run += c;
+            break;
+        }
+    }
+    end_run();
+    return best;
+}
+
 bool text_pattern::compile() const
 {
-    return !empty()?
-        !!(compiled_pattern = _compile_pattern(pattern.c_str(), ignore_case))
-      : false;
+    if (empty())
+        return false;
+
+    compiled_pattern = _compile_pattern(pattern.c_str(), ignore_case);
+    required = _required_literal(pattern);
+    return !!compiled_pattern;
 }
 
 bool text_pattern::matches(const char *s, int length) const
 {
-    return valid() && _pattern_match(compiled_pattern, s, length);
+    if (!valid())
+        return false;
+
+    if (!ignore_case && !required.empty()
+        && search(s, s + length, required.begin(), required.end())
+           == s + length)
+    {
+        return false;
+    }
+
+    return _pattern_match(compiled_pattern, s, length);
 }
 
 pattern_match text_pattern::match_location(const char *s, int length) const
@@ -227,3 +410,64 @@ pattern_match plaintext_pattern::match_location(const string &s) const
     else
         return pattern_match::failed(s);
 }
+
+#ifdef DEBUG_TESTS
+/**
+ * Check the literals that regexes are prefiltered on, particularly for
+ * bracket expressions.
+ */
+void pattern_tests()
+{
+    const pair<const char *, const char *> literals[] =
+    {
+        { "goblin", "goblin" },
+        { "[[:alpha:]]x", "x" },
+        { "ab[[:alpha:]]xyz", "xyz" },
+        { "[[:digit:][:space:]]gold", "gold" },
+        { "abc[[=e=]]de", "abc" },
+        { "ab[[.-.]]cde", "cde" },
+        { "[]ab]cd", "cd" },
+        { "[^]ab]cd", "cd" },
+        { "[\\d]foo", "foo" },
+        { "(a[)]b)cde", "cde" },
+        // PCRE and POSIX disagree about where these end.
+        { "[\\]]x", "" },
+        { "[\\]a]bc", "" },
+        // Unterminated.
+        { "ab[cd", "" },
+        { "abc[[:alpha:]", "" },
+        { "abc(d[e)", "" },
+        // Escapes with arguments.
+        { "abc\\x41", "" },
+        { "abc\\cA", "" },
+        { "(\\Q)abc\\E)", "" },
+        { "abc\\bdef", "abc" },
+    };
+
+    for (const auto &test : literals)
+    {
+        const string lit = _required_literal(test.first);
+        if (lit != test.second)
+        {
+            die("pattern: required literal of '%s' was '%s', not '%s'",
+                test.first, lit.c_str(), test.second);
+        }
+    }
+
+    // The prefilter mustn't reject anything the regex would match. Each
+    // text matches under both PCRE and POSIX readings of the pattern.
+    const pair<const char *, const char *> matches[] =
+    {
+        { "[[:alpha:]]x", "ax" },
+        { "[[:digit:]]+ gold", "12 gold" },
+        { "[\\]a]bc", "abc \\a]bc" },
+        { "[]ab]cd", "]cd" },
+    };
+
+    for (const auto &test : matches)
+    {
+        if (!text_pattern(test.first).matches(test.second))
+            die("pattern: '%s' didn't match '%s'", test.first, test.second);
+    }
+}
+#endif
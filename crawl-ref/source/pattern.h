@@ -47,6 +47,10 @@ public:
     virtual bool matches(const string &s) const = 0;
     virtual pattern_match match_location(const string &s) const = 0;
     virtual const string &tostring() const = 0;
+
+    // Text that every matching string contains, ignoring case; empty if
+    // there's no such text, or it isn't known.
+    virtual string required_text() const { return ""; }
 };
 
 class text_pattern : public base_pattern
@@ -116,13 +120,26 @@ public:
         return pattern;
     }
 
+    string required_text() const override
+    {
+        return valid() ? required : "";
+    }
+
 private:
     string pattern;
     mutable void *compiled_pattern;
     mutable bool isvalid;
     bool ignore_case;
+    // A substring every match must contain (ignoring case, if the pattern
+    // does), found when compiling; case-sensitive patterns reject strings
+    // without it before running the regex.
+    mutable string required;
 };
 
+#ifdef DEBUG_TESTS
+void pattern_tests();
+#endif
+
 class plaintext_pattern : public base_pattern
 {
 public:
@@ -150,6 +167,11 @@ public:
         return pattern;
     }
 
+    string required_text() const override
+    {
+        return pattern;
+    }
+
 private:
     string pattern;
     bool ignore_case;
@@ -420,6 +420,21 @@ namespace perlin
         return 27.0 * (n0 + n1 + n2 + n3 + n4);
     }
 
+    // One octave's contribution to fBM(), moving the coordinates on to the
+    // next octave. The rotation between octaves discards x, so from the
+    // second octave on the terms depend only on the starting y and z.
+    static double _fbm_term(double &x, double &y, double &z,
+                            uint32_t divisor)
+    {
+        const double term = noise(x / divisor, y / divisor, z / divisor)
+                            / divisor;
+        double xt = y * sin(1.41421356) + cos(1.41421356);
+        y = y * cos(1.41421356) + sin(1.41421356);
+        x = xt;
+        z += 1.7;
+        return term;
+    }
+
     // This is *not* in Stefan Gustavson's Java original
     // FIXME: what does it do?
     double fBM(double x, double y, double z, uint32_t octaves)
@@ -437,14 +452,54 @@ namespace perlin
         double zi = z;
         for (uint32_t octave = 0; octave < octaves; ++octave)
         {
-            value += noise(xi / divisor, yi / divisor, zi / divisor) / divisor;
+            value += _fbm_term(xi, yi, zi, divisor);
             norm += 1 / divisor;
             divisor *= 2;
-            double xt = yi * sin(1.41421356) + cos(1.41421356);
-            yi = yi * cos(1.41421356) + sin(1.41421356);
-            xi = xt;
-            zi += 1.7;
         }
         return value / norm;
     }
+
+    // fBM() for count points. Points that share y and z with the point
+    // before them, such as the cells along a row, also share every octave
+    // but the first; those are computed once and summed in the same order
+    // as fBM() would, so the results are identical.
+    void fBM(const double *x, const double *y, const double *z, size_t count,
+             uint32_t octaves, double *out)
+    {
+        if (octaves <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = fBM(x[i], y[i], z[i], octaves);
+            return;
+        }
+
+        double norm = 0.0;
+        for (uint32_t octave = 0, divisor = 1; octave < octaves;
+             ++octave, divisor *= 2)
+        {
+            norm += 1 / divisor;
+        }
+
+        vector<double> later(octaves - 1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            double xi = x[i];
+            double yi = y[i];
+            double zi = z[i];
+            double value = 0;
+            value += _fbm_term(xi, yi, zi, 1);
+
+            if (!i || y[i] != y[i - 1] || z[i] != z[i - 1])
+            {
+                for (uint32_t octave = 1, divisor = 2; octave < octaves;
+                     ++octave, divisor *= 2)
+                {
+                    later[octave - 1] = _fbm_term(xi, yi, zi, divisor);
+                }
+            }
+            for (double term : later)
+                value += term;
+            out[i] = value / norm;
+        }
+    }
 }
@@ -6,4 +6,6 @@ namespace perlin
     double noise(double xin, double yin, double zin) IMMUTABLE; // Praise Zin!
     double noise(double xin, double yin, double zin, double win) IMMUTABLE;
     double fBM(double xin, double yin, double zin, uint32_t octaves) IMMUTABLE;
+    void fBM(const double *xin, const double *yin, const double *zin,
+             size_t count, uint32_t octaves, double *out);
 }
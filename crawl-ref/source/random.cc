@@ -2,6 +2,7 @@
 
 #include "random.h"
 
+#include <chrono>
 #include <cmath>
 #ifndef TARGET_COMPILER_VC
 # include <unistd.h>
@@ -9,19 +10,101 @@
 # include <process.h>
 #endif
 
+#include "errors.h"
 #include "pcg.h"
 #include "syscalls.h"
 
 static FixedVector<PcgRNG, NUM_RNGS> rngs;
+// The generator selected by the innermost rng_generator, if any.
+static rng_type current_rng = RNG_GAMEPLAY;
+
+static PcgRNG &_rng(int generator)
+{
+    return rngs[generator == RNG_CURRENT ? current_rng : generator];
+}
 
 uint32_t get_uint32(int generator)
 {
-    return rngs[generator].get_uint32();
+    return _rng(generator).get_uint32();
 }
 
 uint64_t get_uint64(int generator)
 {
-    return rngs[generator].get_uint64();
+    return _rng(generator).get_uint64();
+}
+
+rng_generator::rng_generator(rng_type generator)
+    : previous(current_rng)
+{
+    ASSERT(generator >= 0 && generator < NUM_RNGS);
+    current_rng = generator;
+}
+
+rng_generator::~rng_generator()
+{
+    current_rng = previous;
+}
+
+static uint64_t _splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// A stream for the given key. PcgRNG itself only looks at the first two
+// words of its key, so longer keys are hashed down to a state and increment
+// first; keys that differ in any word give unrelated streams.
+static PcgRNG _keyed_rng(const uint64_t key[], int key_length)
+{
+    uint64_t hash = key_length;
+    for (int i = 0; i < key_length; ++i)
+        hash = _splitmix64(hash ^ key[i]);
+    uint64_t pcg_key[2] = { hash, _splitmix64(hash) };
+    return PcgRNG(pcg_key, ARRAYSZ(pcg_key));
+}
+
+/**
+ * Give a forked worker generators of its own, so that nothing it does
+ * outside a seeded_rng_scope repeats the numbers its parent or the other
+ * workers get.
+ *
+ * @param stream A number that differs between the workers of one parent.
+ */
+void split_rngs(uint64_t stream)
+{
+    for (int i = 0; i < NUM_RNGS; ++i)
+    {
+        const uint64_t key[] = { rngs[i].get_uint64(), stream,
+                                 static_cast<uint64_t>(i) };
+        rngs[i] = _keyed_rng(key, ARRAYSZ(key));
+    }
+}
+
+// Levelgen RNGs replaced by the seeded_rng_scopes currently in effect.
+static vector<PcgRNG> saved_levelgen_rngs;
+
+seeded_rng_scope::seeded_rng_scope(const uint64_t key[], int key_length)
+    : generator(RNG_LEVELGEN)
+{
+    saved_levelgen_rngs.push_back(rngs[RNG_LEVELGEN]);
+    rngs[RNG_LEVELGEN] = _keyed_rng(key, key_length);
+}
+
+seeded_rng_scope::seeded_rng_scope(uint32_t game_seed, int branch, int depth)
+    : generator(RNG_LEVELGEN)
+{
+    const uint64_t key[] = { game_seed, static_cast<uint64_t>(branch),
+                             static_cast<uint64_t>(depth) };
+    saved_levelgen_rngs.push_back(rngs[RNG_LEVELGEN]);
+    rngs[RNG_LEVELGEN] = _keyed_rng(key, ARRAYSZ(key));
+}
+
+seeded_rng_scope::~seeded_rng_scope()
+{
+    rngs[RNG_LEVELGEN] = saved_levelgen_rngs.back();
+    saved_levelgen_rngs.pop_back();
 }
 
 static void _seed_rng(uint64_t seed_array[], int seed_len)
@@ -65,27 +148,35 @@ int random_range(int low, int high, int nrolls)
     return low + roll;
 }
 
+// [0, max), without bias: the product of a 32-bit value and max is split
+// into a result (the high word) and a fraction (the low word), and the few
+// values whose fraction falls in the uneven part of the range are redrawn.
+// The remainder that finds that part is only needed when the fraction is
+// small enough to be in it, so most calls do no division at all.
 static int _random2(int max, int rng)
 {
     if (max <= 1)
         return 0;
 
-    uint32_t partn = PcgRNG::max() / max;
-
-    while (true)
+    const uint32_t range = max;
+    uint64_t product = uint64_t(get_uint32(rng)) * range;
+    uint32_t fraction = uint32_t(product);
+    if (fraction < range)
     {
-        uint32_t bits = get_uint32(rng);
-        uint32_t val  = bits / partn;
-
-        if (val < (uint32_t)max)
-            return (int)val;
+        const uint32_t uneven = -range % range;
+        while (fraction < uneven)
+        {
+            product = uint64_t(get_uint32(rng)) * range;
+            fraction = uint32_t(product);
+        }
     }
+    return int(product >> 32);
 }
 
 // [0, max)
 int random2(int max)
 {
-    return _random2(max, RNG_GAMEPLAY);
+    return _random2(max, RNG_CURRENT);
 }
 
 // [0, max), separate RNG state
@@ -257,6 +348,12 @@ int random2limit(int max, int limit)
  */
 int binomial(unsigned n_trials, unsigned trial_prob, unsigned scale)
 {
+    // x_chance_in_y() doesn't draw a number for these.
+    if (trial_prob == 0)
+        return 0;
+    if (trial_prob >= scale)
+        return n_trials;
+
     int count = 0;
     for (unsigned i = 0; i < n_trials; ++i)
         if (::x_chance_in_y(trial_prob, scale))
@@ -398,3 +495,116 @@ int defer_rand::random2avg(int max, int rolls)
 
     return sum / rolls;
 }
+
+#ifdef DEBUG_TESTS
+static vector<int> _draws(int count)
+{
+    vector<int> draws;
+    for (int i = 0; i < count; ++i)
+        draws.push_back(random2(1000000));
+    return draws;
+}
+
+// Other streams mustn't disturb the gameplay one, and seeded streams must
+// depend on the whole of their keys.
+static void _test_streams()
+{
+    seed_rng(27);
+    const vector<int> plain = _draws(100);
+
+    seed_rng(27);
+    vector<int> interleaved;
+    for (int i = 0; i < 100; ++i)
+    {
+        interleaved.push_back(random2(1000000));
+        ui_random(10);
+        rng_generator ui(RNG_UI);
+        random2(10);
+        seeded_rng_scope level(27, 0, i);
+        random2(10);
+    }
+    if (interleaved != plain)
+        die("random: other streams changed the gameplay stream");
+
+    vector<int> level_draws[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        seeded_rng_scope level(27, 0, i % 2 + 1);
+        level_draws[i] = _draws(10);
+    }
+    if (level_draws[0] != level_draws[2])
+        die("random: a level's stream isn't repeatable");
+    if (level_draws[0] == level_draws[1])
+        die("random: levels at different depths share a stream");
+}
+
+static void _test_range(int max, int samples)
+{
+    vector<int> counts(max);
+    for (int i = 0; i < samples; ++i)
+    {
+        const int roll = random2(max);
+        if (roll < 0 || roll >= max)
+            die("random: random2(%d) returned %d", max, roll);
+        ++counts[roll];
+    }
+
+    // Allow six standard deviations.
+    const double mean = double(samples) / max;
+    const double slack = 6 * sqrt(mean);
+    for (int i = 0; i < max; ++i)
+        if (fabs(counts[i] - mean) > slack)
+            die("random: random2(%d) gave %d %d times of %d", max, i,
+                counts[i], samples);
+}
+
+template <typename F>
+static void _bench(FILE *f, const char *name, F draw)
+{
+    const int calls = 1000000;
+    int sum = 0;
+    const auto start = chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i)
+        sum += draw();
+    const chrono::duration<double, nano> time =
+        chrono::steady_clock::now() - start;
+    fprintf(f, "%-20s %8.2f ns/call  (mean %.3f)\n", name,
+            time.count() / calls, double(sum) / calls);
+}
+
+/**
+ * Test the streams and range reduction, and write the time taken by the
+ * common dice functions to rng_bench.out.
+ */
+void random_tests()
+{
+    _test_streams();
+
+    seed_rng(27);
+    _test_range(2, 100000);
+    _test_range(3, 300000);
+    _test_range(100, 1000000);
+    // Reducing 32-bit values modulo this would put 9/16 of the results in
+    // the lower half of the range.
+    const int big = 3 << 29;
+    int low = 0;
+    for (int i = 0; i < 100000; ++i)
+        low += random2(big) < big / 2;
+    if (abs(low - 50000) > 1000)
+        die("random: random2(%d) was below %d %d times of 100000", big,
+            big / 2, low);
+    if (random2(0) || random2(1) || random2(-5))
+        die("random: random2() of an empty range wasn't 0");
+
+    FILE *f = fopen("rng_bench.out", "w");
+    if (!f)
+        sysfail("can't write test output");
+    _bench(f, "random2(17)", [] { return random2(17); });
+    _bench(f, "random2(1000)", [] { return random2(1000); });
+    _bench(f, "roll_dice(3, 6)", [] { return roll_dice(3, 6); });
+    _bench(f, "random2avg(100, 3)", [] { return random2avg(100, 3); });
+    _bench(f, "binomial(20, 35)", [] { return binomial(20, 35); });
+    _bench(f, "ui_random(17)", [] { return ui_random(17); });
+    fclose(f);
+}
+#endif
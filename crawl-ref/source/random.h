@@ -12,8 +12,40 @@ void seed_rng();
 void seed_rng(uint32_t seed);
 void seed_rng(uint64_t[], int);
 
-uint32_t get_uint32(int generator = RNG_GAMEPLAY);
-uint64_t get_uint64(int generator = RNG_GAMEPLAY);
+uint32_t get_uint32(int generator = RNG_CURRENT);
+uint64_t get_uint64(int generator = RNG_CURRENT);
+
+void split_rngs(uint64_t stream);
+
+// While one of these is in scope, random2() and the rest of the functions
+// below draw on the given generator instead of the one selected before.
+class rng_generator
+{
+public:
+    explicit rng_generator(rng_type generator);
+    ~rng_generator();
+
+private:
+    rng_type previous;
+};
+
+// While one of these is in scope random2() and the rest draw on a levelgen
+// stream seeded from the given key, and the stream that was there before is
+// put back afterwards. Whatever runs meanwhile gets the same numbers no
+// matter what happened before, and leaves the gameplay and UI streams
+// untouched.
+class seeded_rng_scope
+{
+public:
+    seeded_rng_scope(const uint64_t key[], int key_length);
+    // The stream for one level of the game with the given seed.
+    seeded_rng_scope(uint32_t game_seed, int branch, int depth);
+    ~seeded_rng_scope();
+
+private:
+    rng_generator generator;
+};
+
 bool coinflip();
 int div_rand_round(int num, int den);
 int rand_round(double x);
@@ -39,6 +71,10 @@ bool decimal_chance(double percent);
 
 int ui_random(int max);
 
+#ifdef DEBUG_TESTS
+void random_tests();
+#endif
+
 /** Chooses one of the objects passed in at random (by value).
  *  @return One of the arguments.
  *
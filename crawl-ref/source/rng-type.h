@@ -1,7 +1,9 @@
 #pragma once
 
 enum rng_type {
+    RNG_CURRENT = -1,   // Whichever generator an rng_generator has selected.
     RNG_GAMEPLAY,
     RNG_UI,
+    RNG_LEVELGEN,       // Reseeded for each level by seeded_rng_scope.
     NUM_RNGS,
 };
@@ -0,0 +1,86 @@
+-- Times the placement of every layout map, for finding slow layouts and
+-- for checking changes to the builder's Lua API.
+
+local niters = 20
+local output_file = "layout-bench.out"
+local default_place = "D:5"
+
+local args = script.simple_args()
+if args[1] and not tonumber(args[1]) then
+  script.usage([[
+Usage: layout-bench [<iterations>] [<name pattern>]
+
+Places each layout map whose name matches the Lua pattern <iterations>
+times (default ]] .. niters .. [[) and writes the timings to ]] .. output_file)
+end
+niters = tonumber(args[1]) or niters
+local name_pattern = args[2]
+
+-- The first place the map is allowed at, as something debug.goto_place()
+-- understands.
+local function layout_place(map)
+  for range in string.gmatch(dgn.depth(map), "[^,%s]+") do
+    if string.find(range, "!") ~= 1 then
+      local _, _, branch, depth = string.find(range, "^(%w+):?(%d*)")
+      if branch then
+        return branch .. ":" .. (depth ~= "" and depth or "1")
+      end
+    end
+  end
+  return default_place
+end
+
+local function bench_layout(map)
+  local place = layout_place(map)
+  local stat = { name = dgn.name(map), place = place, total = 0,
+                 slowest = 0, failures = 0 }
+  for i = 1, niters do
+    debug.goto_place(place)
+    dgn.reset_level()
+    local start = crawl.millis()
+    local placed = dgn.place_map(map, false, true)
+    local elapsed = crawl.millis() - start
+    stat.total = stat.total + elapsed
+    stat.slowest = math.max(stat.slowest, elapsed)
+    if not placed then
+      stat.failures = stat.failures + 1
+    end
+  end
+  return stat
+end
+
+local layouts = { }
+for _, map in ipairs(dgn.maps_by_tag("layout")) do
+  if not name_pattern or string.find(dgn.name(map), name_pattern) then
+    table.insert(layouts, map)
+  end
+end
+table.sort(layouts, function (a, b) return dgn.name(a) < dgn.name(b) end)
+
+local stats = { }
+local total = 0
+for _, map in ipairs(layouts) do
+  local stat = bench_layout(map)
+  crawl.mpr(string.format("%s: %.1f ms per placement",
+                          stat.name, stat.total / niters))
+  table.insert(stats, stat)
+  total = total + stat.total
+end
+table.sort(stats, function (a, b) return a.total > b.total end)
+
+local lines = {
+  string.format("Layout placement times: %d layouts, %d iterations each, "
+                .. "%d ms in all", #stats, niters, total),
+  "",
+  string.format("%10s %10s %10s %6s  %-8s %s", "total ms", "mean ms",
+                "slowest", "failed", "place", "layout")
+}
+for _, stat in ipairs(stats) do
+  table.insert(lines,
+               string.format("%10d %10.2f %10d %6d  %-8s %s", stat.total,
+                             stat.total / niters, stat.slowest,
+                             stat.failures, stat.place, stat.name))
+end
+
+file.writefile(output_file, table.concat(lines, "\n") .. "\n")
+crawl.mpr("Wrote layout timings to " .. output_file)
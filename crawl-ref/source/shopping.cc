@@ -2079,6 +2079,7 @@ void ShoppingList::move_things(const coord_def &_src, const coord_def &_dst)
 {
     if (crawl_state.map_stat_gen
         || crawl_state.obj_stat_gen
+        || crawl_state.level_hash_gen
         || crawl_state.test)
     {
         return; // Shopping list is unitialized and uneeded.
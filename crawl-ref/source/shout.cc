@@ -35,10 +35,15 @@
 #include "state.h"
 #include "stringutil.h"
 #include "terrain.h"
+#include "unwind.h"
 #include "view.h"
 #include "viewchar.h"
 
-static noise_grid _noise_grid;
+// Noises are registered in *_noise_grid. While one grid propagates, noises
+// made in response go into the other; see apply_noises().
+static noise_grid _noise_grids[2];
+static noise_grid *_noise_grid = &_noise_grids[0];
+static bool _noise_propagating = false;
 static void _actor_apply_noise(actor *act,
                                const coord_def &apparent_source,
                                int noise_intensity_millis,
@@ -764,17 +769,32 @@ void yell(const actor* mon)
 
 void apply_noises()
 {
-    // [ds] This copying isn't awesome, but we cannot otherwise handle
-    // the case where one set of noises wakes up monsters who then let
-    // out yips of their own, modifying _noise_grid while it is in the
-    // middle of propagate_noise().
-    if (_noise_grid.dirty())
+    if (!_noise_grid->dirty())
+        return;
+
+    // [ds] We cannot propagate noise in _noise_grid directly, since one set
+    // of noises may wake up monsters who then let out yips of their own,
+    // modifying _noise_grid while it is in the middle of propagate_noise().
+    // So new noises go into the other grid while this one propagates, or,
+    // if that one is itself still propagating, into a cleared _noise_grid
+    // while a copy propagates.
+    if (_noise_propagating)
     {
-        noise_grid copy = _noise_grid;
-        // Reset the main grid.
-        _noise_grid.reset();
+        noise_grid copy = *_noise_grid;
+        _noise_grid->reset();
         copy.propagate_noise();
+        return;
     }
+
+    noise_grid &current = *_noise_grid;
+    _noise_grid = _noise_grid == &_noise_grids[0] ? &_noise_grids[1]
+                                                  : &_noise_grids[0];
+    // Normally already clean, unless the last propagation was cut short.
+    _noise_grid->reset();
+
+    unwind_bool propagating(_noise_propagating, true);
+    current.propagate_noise();
+    current.reset();
 }
 
 // noisy() has a messaging service for giving messages to the player
@@ -815,7 +835,7 @@ bool noisy(int original_loudness, const coord_def& where,
     // Add +1 to scaled_loudness so that all squares adjacent to a
     // sound of loudness 1 will hear the sound.
     const string noise_msg(msg? msg : "");
-    _noise_grid.register_noise(
+    _noise_grid->register_noise(
         noise_t(where, noise_msg, (scaled_loudness + 1) * multiplier, who));
 
     // Some users of noisy() want an immediate answer to whether the
@@ -985,17 +1005,30 @@ int noise_cell::turn_angle(const coord_def &next_delta) const
 }
 
 noise_grid::noise_grid()
-    : cells(), noises(), affected_actor_count(0)
+    : cells(), noises(), affected_actor_count(0),
+      touched_top_left(GXM, GYM), touched_bottom_right(-1, -1)
 {
 }
 
 void noise_grid::reset()
 {
-    cells.init(noise_cell());
+    for (int y = touched_top_left.y; y <= touched_bottom_right.y; ++y)
+        for (int x = touched_top_left.x; x <= touched_bottom_right.x; ++x)
+            cells[x][y] = noise_cell();
+    touched_top_left = coord_def(GXM, GYM);
+    touched_bottom_right = coord_def(-1, -1);
     noises.clear();
     affected_actor_count = 0;
 }
 
+void noise_grid::touch(const coord_def &pos)
+{
+    touched_top_left.x = min(touched_top_left.x, pos.x);
+    touched_top_left.y = min(touched_top_left.y, pos.y);
+    touched_bottom_right.x = max(touched_bottom_right.x, pos.x);
+    touched_bottom_right.y = max(touched_bottom_right.y, pos.y);
+}
+
 void noise_grid::register_noise(const noise_t &noise)
 {
     noise_cell &target_cell(cells(noise.noise_source));
@@ -1008,6 +1041,7 @@ void noise_grid::register_noise(const noise_t &noise)
                                               noise_index,
                                               0,
                                               coord_def(0, 0));
+        touch(noise.noise_source);
     }
 }
 
@@ -1020,8 +1054,9 @@ void noise_grid::propagate_noise()
     dprf(DIAG_NOISE, "noise_grid: %u noises to apply",
          (unsigned int)noises.size());
 #endif
-    vector<coord_def> noise_perimeter[2];
     int circ_index = 0;
+    noise_perimeter[0].clear();
+    noise_perimeter[1].clear();
 
     for (const noise_t &noise : noises)
         noise_perimeter[circ_index].push_back(noise.noise_source);
@@ -1117,9 +1152,12 @@ bool noise_grid::propagate_noise_to_neighbour(int base_attenuation,
                                   cell.noise_id,
                                   travel_distance,
                                   next_pos - current_pos))
+        {
+            touch(next_pos);
             // Return true only if we hadn't already registered this
             // cell as a neighbour (presumably with a lower volume).
             return neighbour_old_distance != travel_distance;
+        }
     }
     return false;
 }
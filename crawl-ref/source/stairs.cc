@@ -560,6 +560,9 @@ void floor_transition(dungeon_feature_type how,
                       bool update_travel_cache)
 {
     const level_id old_level = level_id::current();
+#ifdef DEBUG_DIAGNOSTICS
+    const auto start = chrono::steady_clock::now();
+#endif
 
     // Clean up fake blood.
     heal_flayed_effect(&you, true, true);
@@ -805,6 +808,12 @@ void floor_transition(dungeon_feature_type how,
 
     viewwindow();
 
+#ifdef DEBUG_DIAGNOSTICS
+    const auto taken = chrono::duration_cast<chrono::microseconds>(
+                           chrono::steady_clock::now() - start);
+    dprf("level change drawn after %dus", static_cast<int>(taken.count()));
+#endif
+
     // There's probably a reason for this. I don't know it.
     if (going_up)
         seen_monsters_react();
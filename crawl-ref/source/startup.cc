@@ -75,6 +75,53 @@ static void _loading_message(string m)
 #endif
 }
 
+static bool _game_data_preloaded = false;
+
+/**
+ * Load everything that doesn't depend on the player's options: spell,
+ * mutation and monster tables, the dungeon Lua state with all maps, and the
+ * text databases.
+ *
+ * A zygote server (see zygote.cc) calls this once and then forks games,
+ * closing the databases first since their handles can't be shared across
+ * fork(). Later calls just reopen the databases.
+ */
+void preload_game_data()
+{
+    if (_game_data_preloaded)
+    {
+        databaseSystemInit();
+        return;
+    }
+
+    init_spell_descs();        // This needs to be way up top. {dlb}
+    init_zap_index();
+    init_mut_index();
+    init_sac_index();
+    init_duration_index();
+    init_mon_name_cache();
+    init_mons_spells();
+
+    // Set up the Lua interpreter for the dungeon builder.
+    init_dungeon_lua();
+
+    // Initialise internal databases.
+    _loading_message("Loading databases...");
+    databaseSystemInit();
+
+    _loading_message("Loading spells and features...");
+    init_feat_desc_cache();
+    init_spell_name_cache();
+    init_spell_rarities();
+
+    // Read special levels and vaults.
+    _loading_message("Loading maps...");
+    read_maps();
+    run_map_global_preludes();
+
+    _game_data_preloaded = true;
+}
+
 // Initialise a whole lot of stuff...
 static void _initialize()
 {
@@ -88,21 +135,24 @@ static void _initialize()
     init_char_table(Options.char_set);
     init_show_table();
     init_monster_symbols();
-    init_spell_descs();        // This needs to be way up top. {dlb}
-    init_zap_index();
-    init_mut_index();
-    init_sac_index();
-    init_duration_index();
-    init_mon_name_cache();
-    init_mons_spells();
+
+    unwind_bool no_more(crawl_state.show_more_prompt, false);
+
+#ifdef USE_TILE_LOCAL
+    // Draw the splash screen before the database gets initialised as that
+    // may take awhile and it's better if the player can look at a pretty
+    // screen while this happens.
+    if (!crawl_state.tiles_disabled && crawl_state.title_screen)
+        loading_screen_open();
+#endif
+
+    preload_game_data();
 
     // init_item_name_cache() needs to be redone after init_char_table()
     // and init_show_table() have been called, so that the glyphs will
     // be set to use with item_names_by_glyph_cache.
     init_item_name_cache();
 
-    unwind_bool no_more(crawl_state.show_more_prompt, false);
-
     // Init item array.
     for (int i = 0; i < MAX_ITEMS; ++i)
         init_item(i);
@@ -118,31 +168,6 @@ static void _initialize()
     you.unique_creatures.reset();
     you.unique_items.init(UNIQ_NOT_EXISTS);
 
-    // Set up the Lua interpreter for the dungeon builder.
-    init_dungeon_lua();
-
-#ifdef USE_TILE_LOCAL
-    // Draw the splash screen before the database gets initialised as that
-    // may take awhile and it's better if the player can look at a pretty
-    // screen while this happens.
-    if (!crawl_state.tiles_disabled && crawl_state.title_screen)
-        loading_screen_open();
-#endif
-
-    // Initialise internal databases.
-    _loading_message("Loading databases...");
-    databaseSystemInit();
-
-    _loading_message("Loading spells and features...");
-    init_feat_desc_cache();
-    init_spell_name_cache();
-    init_spell_rarities();
-
-    // Read special levels and vaults.
-    _loading_message("Loading maps...");
-    read_maps();
-    run_map_global_preludes();
-
     if (crawl_state.build_db)
         end(0);
 
@@ -167,6 +192,11 @@ static void _initialize()
         objstat_generate_stats();
         end(0, false);
     }
+    else if (crawl_state.level_hash_gen)
+    {
+        release_cli_signals();
+        end(mapstat_hash_levels() ? 0 : 1, false);
+    }
 #endif
 
     if (!crawl_state.test_list)
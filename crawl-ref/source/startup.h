@@ -7,3 +7,4 @@
 
 bool startup_step();
 void cio_init();
+void preload_game_data();
@@ -12,6 +12,7 @@
 #include <cstdio>
 #include <sstream>
 
+#include "artefact.h"
 #include "chardump.h"
 #include "clua.h"
 #include "cluautil.h"
@@ -23,7 +24,9 @@
 #include "env.h"
 #include "files.h"
 #include "feature.h"
+#include "food.h"
 #include "god-passive.h"
+#include "hash.h"
 #include "hints.h"
 #include "invent.h"
 #include "item-prop.h"
@@ -52,6 +55,7 @@
 
 // Global
 StashTracker StashTrack;
+stash_update_stats stash_updates;
 
 string userdef_annotate_item(const char *s, const item_def *item,
                              bool exclusive)
@@ -485,6 +489,67 @@ vector<stash_search_result> Stash::matches_search(
     return results;
 }
 
+// The part of an item's search annotations that doesn't depend on options,
+// lowercased for the search index.
+static string _indexed_annotation(const item_def &item, bool exclusive)
+{
+    string ann = stash_annotate_item(STASH_LUA_SEARCH_ANNOTATE, &item,
+                                     exclusive);
+    const string autopickup = " {autopickup}";
+    if (ends_with(ann, autopickup))
+        ann.erase(ann.size() - autopickup.size());
+    return lowercase_string(ann);
+}
+
+static uint64_t _item_fingerprint(uint64_t hash, const item_def &item)
+{
+    hash = hash3(hash, item.base_type << 8 | item.sub_type,
+                 (uint16_t) item.plus << 16 | (uint16_t) item.plus2);
+    hash = hash3(hash, item.special, item.quantity);
+    hash = hash3(hash, item.flags, item.rnd);
+    hash = hash3(hash, item.stash_freshness, 0);
+    hash = hash3(hash, hash32(item.inscription.data(),
+                              item.inscription.size()),
+                 item.props.size() << 1 | item_type_known(item));
+    // Known artefact properties are updated in place, and show up in the
+    // name and the chardump description.
+    hash = hash3(hash, artefact_props_hash(item), 0);
+    return hash;
+}
+
+/**
+ * The text that matches_search() looks at, lowercased, leaving out the
+ * level name and the {autopickup} annotation: those depend on where the
+ * search is made from and the options at the time. The pieces that are
+ * matched separately are separated by NULs.
+ */
+string Stash::search_text() const
+{
+    string text;
+    for (const item_def &item : items)
+    {
+        text += " " + _indexed_annotation(item, false) + " "
+                + lowercase_string(stash_item_name(item));
+        text += '\0';
+        if (is_dumpable_artefact(item))
+            text += lowercase_string(chardump_desc(item));
+        text += '\0';
+    }
+    if (feat != DNGN_FLOOR)
+        text += lowercase_string(feature_description());
+    return text;
+}
+
+/// A hash of everything that search_text() depends on.
+uint64_t Stash::search_fingerprint() const
+{
+    uint64_t hash = hash3(feat, hash32(feat_desc.data(), feat_desc.size()),
+                          items.size());
+    for (const item_def &item : items)
+        hash = _item_fingerprint(hash, item);
+    return hash;
+}
+
 /// Fedhas: rot away all corpses.
 void Stash::rot_all_corpses()
 {
@@ -740,6 +805,41 @@ vector<stash_search_result> ShopInfo::matches_search(
     return results;
 }
 
+/// The text that matches_search() looks at; see Stash::search_text().
+string ShopInfo::search_text() const
+{
+    no_notes nx;
+
+    const string shoptitle = shop_name(shop) + (shop.stock.empty() ? "*" : "");
+    string text = lowercase_string(shoptitle + " ");
+    text += '\0';
+    text += " {shop}";
+    text += '\0';
+
+    for (const item_def &item : shop.stock)
+    {
+        text += " " + _indexed_annotation(item, true) + " "
+                + lowercase_string(shop_item_name(item)
+                                   + " {" + shoptitle + "}");
+        text += '\0';
+        text += lowercase_string(shop_item_desc(item));
+        text += '\0';
+    }
+    return text;
+}
+
+/// A hash of everything that search_text() depends on.
+uint64_t ShopInfo::search_fingerprint() const
+{
+    const string name = shop_name(shop);
+    uint64_t hash = hash3(shop.type, shop.greed,
+                          hash32(name.data(), name.size()));
+    hash = hash3(hash, shop.stock.size(), 0);
+    for (const item_def &item : shop.stock)
+        hash = _item_fingerprint(hash, item);
+    return hash;
+}
+
 void ShopInfo::write(FILE *f, bool identify) const
 {
     no_notes nx;
@@ -761,6 +861,131 @@ void ShopInfo::write(FILE *f, bool identify) const
         fprintf(f, "  (Shop contents are unknown)\n");
 }
 
+// ----------------------------------------------------------------------
+// StashSearchIndex
+// ----------------------------------------------------------------------
+
+static uint32_t _trigram(const string &text, size_t i)
+{
+    return (uint8_t) text[i] << 16 | (uint8_t) text[i + 1] << 8
+           | (uint8_t) text[i + 2];
+}
+
+// Lowercasing leaves two letters that case-insensitive matching may take
+// for ASCII ones, U+017F (long s) and U+0131 (dotless i): their uppercase
+// forms are S and I. Fold those too, so that the index never misses text a
+// search would match.
+static string _fold_for_index(const string &text)
+{
+    return replace_all(replace_all(text, "\xc5\xbf", "s"), "\xc4\xb1", "i");
+}
+
+bool StashSearchIndex::needs_text(const key_type &key,
+                                  uint64_t fingerprint) const
+{
+    auto it = entries.find(key);
+    return it == entries.end() || it->second.fingerprint != fingerprint;
+}
+
+void StashSearchIndex::set_text(const key_type &key, uint64_t fingerprint,
+                                const string &text)
+{
+    entries[key] = { fingerprint, _fold_for_index(text) };
+    trigrams_valid = false;
+}
+
+void StashSearchIndex::keep_only(const set<key_type> &keys)
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (keys.count(it->first))
+            ++it;
+        else
+        {
+            it = entries.erase(it);
+            trigrams_valid = false;
+        }
+    }
+}
+
+set<StashSearchIndex::key_type>
+StashSearchIndex::containing(const string &text) const
+{
+    set<key_type> found;
+
+    // Short searches can't use the trigrams; they're cheap to check anyway.
+    if (text.size() < 3)
+    {
+        for (const auto &entry : entries)
+            if (entry.second.text.find(text) != string::npos)
+                found.insert(entry.first);
+        return found;
+    }
+
+    if (!trigrams_valid)
+    {
+        trigrams.clear();
+        for (const auto &entry : entries)
+        {
+            const string &etext = entry.second.text;
+            set<uint32_t> seen;
+            for (size_t i = 0; i + 2 < etext.size(); ++i)
+                if (seen.insert(_trigram(etext, i)).second)
+                    trigrams[_trigram(etext, i)].push_back(entry.first);
+        }
+        trigrams_valid = true;
+    }
+
+    // Check the entries with the rarest of the text's trigrams.
+    const vector<key_type> *fewest = nullptr;
+    for (size_t i = 0; i + 2 < text.size(); ++i)
+    {
+        auto posting = trigrams.find(_trigram(text, i));
+        if (posting == trigrams.end())
+            return found;
+        if (!fewest || posting->second.size() < fewest->size())
+            fewest = &posting->second;
+    }
+
+    for (const key_type &key : *fewest)
+        if (entries.at(key).text.find(text) != string::npos)
+            found.insert(key);
+    return found;
+}
+
+void StashSearchIndex::save(writer& outf) const
+{
+    marshallInt(outf, entries.size());
+    for (const auto &entry : entries)
+    {
+        marshallCoord(outf, entry.first.first);
+        marshallBoolean(outf, entry.first.second);
+        marshallUnsigned(outf, entry.second.fingerprint);
+        marshallString4(outf, entry.second.text);
+    }
+}
+
+void StashSearchIndex::load(reader& inf)
+{
+    entries.clear();
+    trigrams_valid = false;
+
+    const int count = unmarshallInt(inf);
+    for (int i = 0; i < count; ++i)
+    {
+        key_type key;
+        key.first = unmarshallCoord(inf);
+        key.second = unmarshallBoolean(inf);
+        indexed_text &e = entries[key];
+        e.fingerprint = unmarshallUnsigned(inf);
+        unmarshallString4(inf, e.text);
+    }
+}
+
+// ----------------------------------------------------------------------
+// LevelStashes
+// ----------------------------------------------------------------------
+
 LevelStashes::LevelStashes()
     : m_place(level_id::current()),
       m_stashes(),
@@ -920,6 +1145,106 @@ void LevelStashes::_waypoint_search(
     }
 }
 
+#ifdef CLUA_BINDINGS
+static int _hash_lua_chunk(lua_State *, const void *p, size_t sz, void *ud)
+{
+    uint64_t &hash = *static_cast<uint64_t *>(ud);
+    hash = hash3(hash, hash32(p, sz), sz);
+    return 0;
+}
+#endif
+
+/**
+ * A hash of what item annotations depend on besides the items themselves:
+ * the annotation function, and the player state read by the item fields
+ * that the default annotations in stash.lua use: is_throwable reads the
+ * body size (from species and form) and can_throw_large_rocks(), and
+ * is_preferred_food reads foodlessness, species and MUT_CARNIVOROUS. Keep
+ * this in step with those fields; they say so where they're defined.
+ */
+static uint64_t _annotation_context()
+{
+    uint64_t hash = hash3(you.species, static_cast<int>(you.form),
+                          you.body_size());
+    hash = hash3(hash, you.can_throw_large_rocks() << 1 | you_foodless(),
+                 you.get_mutation_level(MUT_CARNIVOROUS));
+#ifdef CLUA_BINDINGS
+    // Compare Lua functions by their bytecode, which stays the same across
+    // saves; C functions can't be dumped, so use their address.
+    lua_stack_cleaner cleaner(clua);
+    lua_getglobal(clua, STASH_LUA_SEARCH_ANNOTATE);
+    uint64_t hook = 0;
+    if (lua_isfunction(clua, -1) && lua_dump(clua, _hash_lua_chunk, &hook))
+        hook = reinterpret_cast<uintptr_t>(lua_topointer(clua, -1));
+    hash = hash3(hash, hook, 0);
+#endif
+    return hash;
+}
+
+// Bring the search index up to date with the stashes and shops.
+void LevelStashes::_update_search_index() const
+{
+    set<StashSearchIndex::key_type> keys;
+    const uint64_t context = _annotation_context();
+
+    for (const auto &entry : m_stashes)
+    {
+        const StashSearchIndex::key_type key(entry.first, false);
+        const uint64_t fingerprint =
+            hash3(context, entry.second.search_fingerprint(), 0);
+        if (m_search_index.needs_text(key, fingerprint))
+            m_search_index.set_text(key, fingerprint,
+                                    entry.second.search_text());
+        keys.insert(key);
+    }
+
+    for (const ShopInfo &shop : m_shops)
+    {
+        const StashSearchIndex::key_type key(shop.shop.pos, true);
+        const uint64_t fingerprint =
+            hash3(context, shop.search_fingerprint(), 0);
+        if (m_search_index.needs_text(key, fingerprint))
+            m_search_index.set_text(key, fingerprint, shop.search_text());
+        keys.insert(key);
+    }
+
+    m_search_index.keep_only(keys);
+}
+
+// Could a match of text in a searched string overlap with part?
+static bool _might_overlap(const string &text, const string &part)
+{
+    if (part.find(text) != string::npos || text.find(part) != string::npos)
+        return true;
+
+    for (size_t len = 1; len < min(text.size(), part.size()); ++len)
+    {
+        if (!part.compare(part.size() - len, len, text, 0, len)
+            || !text.compare(text.size() - len, len, part, 0, len))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Can the search index be used to find strings containing this text, given
+// the level name the strings will start with?
+static bool _indexable_search(const string &text, const string &lplace)
+{
+    if (text.empty())
+        return false;
+
+    // Lowercasing anything else might not be reversible.
+    for (const char c : text)
+        if (!c || (unsigned char) c >= 0x80)
+            return false;
+
+    return !_might_overlap(text, lowercase_string(lplace))
+           && !(Options.autopickup_search
+                && _might_overlap(text, " {autopickup}"));
+}
+
 void LevelStashes::get_matching_stashes(
         const base_pattern &search,
         vector<stash_search_result> &results) const
@@ -940,8 +1265,22 @@ void LevelStashes::get_matching_stashes(
         return;
     }
 
+    // Only stashes and shops whose text contains what every match has to
+    // can match, unless it might come from the parts that aren't indexed.
+    const string required = lowercase_string(search.required_text());
+    const bool use_index = _indexable_search(required, lplace);
+    set<StashSearchIndex::key_type> candidates;
+    if (use_index)
+    {
+        _update_search_index();
+        candidates = m_search_index.containing(required);
+    }
+
     for (const auto &entry : m_stashes)
     {
+        if (use_index && !candidates.count(make_pair(entry.first, false)))
+            continue;
+
         vector<stash_search_result> new_results =
             entry.second.matches_search(lplace, search);
         for (auto &res : new_results)
@@ -953,6 +1292,9 @@ void LevelStashes::get_matching_stashes(
 
     for (const ShopInfo &shop : m_shops)
     {
+        if (use_index && !candidates.count(make_pair(shop.shop.pos, true)))
+            continue;
+
         vector<stash_search_result> new_results =
             shop.matches_search(lplace, search);
         for (auto &res : new_results)
@@ -1043,6 +1385,17 @@ void LevelStashes::load(reader& inf)
     }
 }
 
+void LevelStashes::save_search_index(writer& outf) const
+{
+    m_place.save(outf);
+    m_search_index.save(outf);
+}
+
+void LevelStashes::load_search_index(reader& inf)
+{
+    m_search_index.load(inf);
+}
+
 void LevelStashes::remove_shop(const coord_def& c)
 {
     for (unsigned i = 0; i < m_shops.size(); ++i)
@@ -1083,6 +1436,8 @@ bool StashTracker::update_stash(const coord_def& c)
 
 void StashTracker::move_stash(const coord_def& from, const coord_def& to)
 {
+    note_changed(from);
+    note_changed(to);
     if (LevelStashes *lev = find_current_level())
         lev->move_stash(from, to);
 }
@@ -1161,13 +1516,85 @@ void StashTracker::load(reader& inf)
     }
 }
 
+void StashTracker::note_changed(const coord_def& c)
+{
+    if (in_bounds(c))
+        changed_cells.set(c);
+}
+
+void StashTracker::note_level_changed()
+{
+    changed_cells.init(true);
+}
+
+void StashTracker::save_search_index(writer& outf) const
+{
+    marshallShort(outf, (short) levels.size());
+    for (const auto &entry : levels)
+        entry.second.save_search_index(outf);
+}
+
+void StashTracker::load_search_index(reader& inf)
+{
+    const int count = unmarshallShort(inf);
+    for (int i = 0; i < count; ++i)
+    {
+        level_id place;
+        place.load(inf);
+        if (LevelStashes *lev = find_level(place))
+            lev->load_search_index(inf);
+        else
+            StashSearchIndex().load(inf);
+    }
+}
+
+/**
+ * Summarise the items at a cell, so that changes to them are noticed even
+ * if they weren't reported with StashTracker::note_changed(); for instance
+ * quantities or identification changed by writing to mitm[] directly.
+ */
+static uint32_t _item_signature(const coord_def& c)
+{
+    uint32_t sig = 2166136261U;
+    for (stack_iterator si(c); si; ++si)
+    {
+        sig = (sig ^ si.index()) * 16777619U;
+        sig = (sig ^ si->quantity) * 16777619U;
+        sig = (sig ^ si->flags) * 16777619U;
+    }
+    return sig;
+}
+
 void StashTracker::update_visible_stashes()
 {
+    if (seen_level != level_id::current())
+    {
+        seen_level = level_id::current();
+        seen_cells.reset();
+    }
+
+    map_bitmask now_seen;
     LevelStashes *lev = find_current_level();
     for (radius_iterator ri(you.pos(),
                             you.xray_vision ? LOS_NONE : LOS_DEFAULT); ri; ++ri)
     {
         const dungeon_feature_type feat = grd(*ri);
+        const uint32_t items = _item_signature(*ri);
+        now_seen.set(*ri);
+
+        // Stashes only depend on the items and terrain here, except for
+        // the one under the player, who can see the whole pile.
+        if (seen_cells(*ri) && !changed_cells(*ri) && seen_feat(*ri) == feat
+            && seen_items(*ri) == items && *ri != you.pos())
+        {
+            stash_updates.skipped++;
+            if (feat == DNGN_ENTER_SHOP)
+                get_shop(*ri);
+            continue;
+        }
+        stash_updates.refreshed++;
+        seen_feat(*ri) = feat;
+        seen_items(*ri) = items;
 
         if ((!lev || !lev->update_stash(*ri))
             && (_grid_has_perceived_item(*ri)
@@ -1182,6 +1609,10 @@ void StashTracker::update_visible_stashes()
             get_shop(*ri);
     }
 
+    // Changes out of view are caught by the cells coming back into view.
+    seen_cells = now_seen;
+    changed_cells.reset();
+
     if (lev && !lev->has_stashes())
         remove_level();
 }
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -52,6 +53,8 @@ public:
 
     vector<stash_search_result> matches_search(
         const string &prefix, const base_pattern &search) const;
+    string search_text() const;
+    uint64_t search_fingerprint() const;
 
     void write(FILE *f, coord_def refpos, string place = "",
                bool identify = false) const;
@@ -91,6 +94,8 @@ public:
 
     vector<stash_search_result> matches_search(
         const string &prefix, const base_pattern &search) const;
+    string search_text() const;
+    uint64_t search_fingerprint() const;
 
     void save(writer&) const;
     void load(reader&);
@@ -150,6 +155,44 @@ struct stash_search_result
     }
 };
 
+/**
+ * Lowercased copies of the text that searches look at in each stash and
+ * shop on a level, and which of them contain each trigram, so that a search
+ * only needs to look closely at the ones that could match.
+ *
+ * Each entry keeps a fingerprint of what its text was built from, and is
+ * rebuilt when that changes.
+ */
+class StashSearchIndex
+{
+public:
+    // A stash or shop: its position, and whether it's a shop.
+    typedef pair<coord_def, bool> key_type;
+
+    bool needs_text(const key_type &key, uint64_t fingerprint) const;
+    void set_text(const key_type &key, uint64_t fingerprint,
+                  const string &text);
+    void keep_only(const set<key_type> &keys);
+
+    // The stashes and shops whose text contains this (lowercase) text.
+    set<key_type> containing(const string &text) const;
+
+    void save(writer&) const;
+    void load(reader&);
+
+private:
+    struct indexed_text
+    {
+        uint64_t fingerprint;
+        string text;
+    };
+    map<key_type, indexed_text> entries;
+
+    // Built from entries when next needed after they change.
+    mutable map<uint32_t, vector<key_type>> trigrams;
+    mutable bool trigrams_valid = false;
+};
+
 class LevelStashes
 {
 public:
@@ -190,6 +233,9 @@ public:
     void  save(writer&) const;
     void  load(reader&);
 
+    void  save_search_index(writer&) const;
+    void  load_search_index(reader&);
+
     void  write(FILE *f, bool identify = false) const;
     string level_name() const;
     string short_level_name() const;
@@ -203,6 +249,7 @@ private:
     void _update_corpses(int rot_time);
     void _update_identification();
     void _waypoint_search(int n, vector<stash_search_result> &results) const;
+    void _update_search_index() const;
 
     typedef map<coord_def, Stash> stashes_t;
     typedef vector<ShopInfo> shops_t;
@@ -211,6 +258,7 @@ private:
     level_id m_place;
     stashes_t m_stashes;
     shops_t m_shops;
+    mutable StashSearchIndex m_search_index;
 
     friend class StashTracker;
     friend class ST_ItemIterator;
@@ -219,7 +267,9 @@ private:
 class StashTracker
 {
 public:
-    StashTracker() : levels(), last_corpse_update(0)
+    StashTracker() : levels(), last_corpse_update(0), seen_level(),
+                     seen_cells(), changed_cells(), seen_feat(DNGN_UNSEEN),
+                     seen_items(0)
     {
     }
 
@@ -241,6 +291,12 @@ public:
 
     void update_visible_stashes();
 
+    // Note that the items at c on the current level have changed, so that
+    // update_visible_stashes() looks at them again.
+    void note_changed(const coord_def& c);
+    // The same, for every cell of the current level.
+    void note_level_changed();
+
     // Update stash at (x,y) on current level, returning true if a stash was
     // updated.
     bool update_stash(const coord_def& c);
@@ -254,6 +310,10 @@ public:
     void save(writer&) const;
     void load(reader&);
 
+    // Saved separately, so that saves without it still load.
+    void save_search_index(writer&) const;
+    void load_search_index(reader&);
+
     void write(FILE *f, bool identify = false) const;
 
     void dump(const char *filename, bool identify = false) const;
@@ -278,6 +338,17 @@ private:
 
     int last_corpse_update;
 
+    // What update_visible_stashes() saw last time, so that it only needs to
+    // look again at cells that came into view or changed since. Not saved:
+    // everything is looked at again after a load or a level change.
+    level_id seen_level;
+    map_bitmask seen_cells;
+    map_bitmask changed_cells;
+    FixedArray<dungeon_feature_type, GXM, GYM> seen_feat;
+    // Item links, quantities and flags, for changes made without telling
+    // note_changed().
+    FixedArray<uint32_t, GXM, GYM> seen_items;
+
     friend class ST_ItemIterator;
 };
 
@@ -315,6 +386,13 @@ private:
 
 extern StashTracker StashTrack;
 
+struct stash_update_stats
+{
+    unsigned int refreshed; // Visible cells looked at again.
+    unsigned int skipped;   // Visible cells known not to have changed.
+};
+extern stash_update_stats stash_updates;
+
 void maybe_update_stashes();
 bool is_stash(const coord_def& c);
 string get_stash_desc(const coord_def& c);
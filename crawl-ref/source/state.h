@@ -58,6 +58,7 @@ struct game_state
     bool map_stat_dump_disconnect; // Set if we dump disconnected maps and exit
                                    // under mapstat.
     bool obj_stat_gen;      // Set if we're generating object stats.
+    bool level_hash_gen;    // Set if we're hashing the levels of a seed.
 
     string force_map;       // Set if we're forcing a specific map to generate.
 
@@ -68,12 +69,14 @@ struct game_state
     bool arena_suspended;   // Set if the arena has been temporarily
                             // suspended.
     bool generating_level;
+    bool pregenerating_levels; // Set in a worker building levels ahead.
 
     bool dump_maps;         // Dump map Lua to stderr on fresh parse.
     bool test;              // Set if we want to run self-tests and exit.
     bool test_list;         // Show available tests and exit.
     bool script;            // Set if we want to run a Lua script and exit.
     bool build_db;          // Set if we want to rebuild the db and exit.
+    string zygote_socket;   // Set if we serve forked games from a socket.
     vector<string> tests_selected; // Tests to be run.
     vector<string> script_args;    // Arguments to scripts.
 
@@ -3798,6 +3798,7 @@ static void tag_read_you_items(reader &th)
         for (int j = count2; j < MAX_SUBTYPES; ++j)
             you.type_ids[i][j] = false;
     }
+    invalidate_item_name_cache();
 
 #if TAG_MAJOR_VERSION == 34
     if (th.getMinorVersion() < TAG_MINOR_ID_STATES)
@@ -4273,9 +4274,9 @@ static void tag_construct_level(writer &th)
 
     // how many clouds?
     marshallShort(th, env.cloud.size());
-    for (const auto& entry : env.cloud)
+    for (const coord_def &pos : env.cloud.positions())
     {
-        const cloud_struct& cloud = entry.second;
+        const cloud_struct& cloud = *env.cloud.find(pos);
         marshallByte(th, cloud.type);
         ASSERT(cloud.type != CLOUD_NONE);
         ASSERT_IN_BOUNDS(cloud.pos);
@@ -4992,7 +4993,7 @@ void marshallMapCell(writer &th, const map_cell &cell)
 
     if (flags & MAP_SERIALIZE_CLOUD)
     {
-        cloud_info* ci = cell.cloudinfo();
+        const cloud_info* ci = cell.cloudinfo();
         marshallUnsigned(th, ci->type);
         marshallUnsigned(th, ci->colour);
         marshallUnsigned(th, ci->duration);
@@ -5716,9 +5717,9 @@ static void tag_read_level(reader &th)
             unmarshallMapCell(th, env.map_knowledge[i][j]);
             // Fixup positions
             if (env.map_knowledge[i][j].monsterinfo())
-                env.map_knowledge[i][j].monsterinfo()->pos = coord_def(i, j);
+                env.map_knowledge[i][j].edit_monsterinfo()->pos = coord_def(i, j);
             if (env.map_knowledge[i][j].cloudinfo())
-                env.map_knowledge[i][j].cloudinfo()->pos = coord_def(i, j);
+                env.map_knowledge[i][j].edit_cloudinfo()->pos = coord_def(i, j);
 
             env.map_knowledge[i][j].flags &= ~MAP_VISIBLE_FLAG;
             if (env.map_knowledge[i][j].seen())
@@ -5786,7 +5787,7 @@ static void tag_read_level(reader &th)
         // 0.18-a0-629-g16988c9.
         if (!cell_is_solid(cloud.pos))
 #endif
-            env.cloud[cloud.pos] = cloud;
+            env.cloud.insert(cloud);
     }
 
     EAT_CANARY;
@@ -0,0 +1,97 @@
+-- Check that dgn.fill_small_zones fills the same cells as zonify's Lua
+-- zoning and filling did, including which of two zones the same size it
+-- keeps.
+
+require("dlua/layout/zonify.lua")
+
+local gxm, gym = dgn.max_bounds()
+local map = dgn.map_by_tag("fill_small_zones_test")
+assert(map, "No fill_small_zones_test map")
+
+-- Draw the given rows over a map of solid wall the size of the level.
+local function draw(rows)
+  dgn.map(map, nil)
+  for y = 1, gym do
+    local row = rows[y] or ""
+    dgn.map(map, row .. string.rep("x", gxm - #row))
+  end
+end
+
+local function random_rows(wall_chance)
+  local rows = {}
+  for y = 1, gym do
+    local row = {}
+    for x = 1, gxm do
+      if x == 1 or y == 1 or x == gxm or y == gym
+         or crawl.random2(100) < wall_chance then
+        row[x] = crawl.one_chance_in(8) and "l" or "x"
+      else
+        row[x] = crawl.one_chance_in(8) and "W" or "."
+      end
+    end
+    rows[y] = table.concat(row)
+  end
+  return rows
+end
+
+local function old_fill(keep, min_size)
+  local e = { mapgrd = dgn.mapgrd_table(map) }
+  local zonemap = zonify.map_map(e)
+  zonify.fill_smallest_zones(zonemap, keep, "floor",
+                             function(x, y) e.mapgrd[x][y] = 'x' end,
+                             min_size)
+  return dgn.map(map)
+end
+
+local function new_fill(keep, min_size)
+  dgn.fill_small_zones(map, { keep = keep, fill = 'x', min_size = min_size,
+                              wall = zonify.map_wall_glyphs })
+  return dgn.map(map)
+end
+
+local function check(name, rows, keep, min_size)
+  draw(rows)
+  local old = old_fill(keep, min_size)
+  draw(rows)
+  local new = new_fill(keep, min_size)
+  for y = 1, gym do
+    assert(old[y] == new[y],
+           name .. " (keep " .. keep .. ", min_size " .. min_size
+           .. "): row " .. (y - 1) .. " is\n" .. new[y]
+           .. "\nbut zonify gave\n" .. old[y])
+  end
+end
+
+-- Two rooms of 6 cells, one of 10 around a lava cell (lava is wall) and
+-- one of 2.
+local tied = {
+  "xxxxxxxxxxxxxxxx",
+  "x...xx...xxxxxxx",
+  "x...xx...xx.l..x",
+  "xxxxxxxxxxx.lW.x",
+  "xxxxxxxxxxx....x",
+  "x..xxxxxxxxxxxxx",
+  "xxxxxxxxxxxxxxxx",
+}
+-- Three rooms of 6 cells and one of 2, reached in a different order.
+local tied_reversed = {
+  "xxxxxxxxxxxxxxxx",
+  "xxxxxx...xx...xx",
+  "x..xxx...xx...xx",
+  "xxxxxxxxxxxxxxxx",
+  "x...xxxxxxxxxxxx",
+  "x...xxxxxxxxxxxx",
+  "xxxxxxxxxxxxxxxx",
+}
+
+for _, keep in ipairs({1, 2, 3, 5}) do
+  for _, min_size in ipairs({1, 2, 6}) do
+    check("tied", tied, keep, min_size)
+    check("tied_reversed", tied_reversed, keep, min_size)
+  end
+end
+
+for i = 1, 10 do
+  local rows = random_rows(35 + i * 2)
+  check("random " .. i, rows, 1 + i % 3, i % 2 == 0 and 1 or 8)
+end
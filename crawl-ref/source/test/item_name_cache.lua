@@ -0,0 +1,41 @@
+-- Check that cached item names notice changes to the item being named.
+
+local place = dgn.point(20, 20)
+
+debug.goto_place("D:1")
+dgn.dismiss_monsters()
+dgn.grid(place.x, place.y, "floor")
+
+dgn.create_item(place.x, place.y, "arrow q:2")
+local item = dgn.items_at(place.x, place.y)[1]
+
+local first = item.name()
+local hits = debug.item_name_cache()
+assert(item.name() == first, "Name changed without the item changing")
+assert(debug.item_name_cache() > hits, "Repeated name wasn't cached")
+
+item.inc_quantity(3)
+local after = item.name()
+assert(after ~= first,
+       "Stale name '" .. after .. "' after changing the quantity")
+assert(after:find("^5 "), "Unexpected name '" .. after .. "'")
+
+-- Learning an artefact property updates the item's props in place.
+dgn.create_item(place.x, place.y, "salamander hide armour")
+local armour
+for _, it in ipairs(dgn.items_at(place.x, place.y)) do
+  if it.artefact then
+    armour = it
+  end
+end
+assert(armour, "Couldn't create the unrandart")
+assert(not armour.artprops,
+       "Unrandart was created with its properties known")
+
+local unlearnt = armour.name()
+assert(armour.name() == unlearnt, "Name changed without the item changing")
+armour.learn_artprop("rF")
+local learnt = armour.name()
+assert(learnt ~= unlearnt,
+       "Stale name '" .. learnt .. "' after learning a property")
+assert(learnt:find("rF"), "Unexpected name '" .. learnt .. "'")
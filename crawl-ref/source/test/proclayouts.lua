@@ -0,0 +1,33 @@
+-- Check that the procedural layouts still give the terrain they always
+-- have, whether sampled cell by cell or in batches. If a layout is changed
+-- on purpose, its digests here need updating.
+
+local golden = {
+  { layout = "abyss",      x = 40,        y = 30,        depth = 0,
+    digest = 3972863513 },
+  { layout = "abyss",      x = 123456789, y = 987654321, depth = 5000000,
+    digest = 3783739696 },
+  { layout = "wastes",     x = 40,        y = 30,        depth = 0,
+    digest = 2599842881 },
+  { layout = "wastes",     x = 123456789, y = 987654321, depth = 5000000,
+    digest = 3386619094 },
+  { layout = "forest",     x = 40,        y = 30,        depth = 0,
+    digest = 1999683400 },
+  { layout = "forest",     x = 123456789, y = 987654321, depth = 5000000,
+    digest = 364708884 },
+  { layout = "underworld", x = 40,        y = 30,        depth = 0,
+    digest = 3253269843 },
+  { layout = "underworld", x = 123456789, y = 987654321, depth = 5000000,
+    digest = 863220184 },
+}
+
+for _, case in ipairs(golden) do
+  for _, batched in ipairs({ false, true }) do
+    local digest = debug.proclayout_digest(case.layout, case.x, case.y,
+                                           80, 70, case.depth, batched)
+    assert(digest == case.digest,
+           "Layout " .. case.layout .. " at (" .. case.x .. ", " .. case.y
+           .. ") depth " .. case.depth .. (batched and " (batched)" or "")
+           .. " changed: digest " .. digest .. ", expected " .. case.digest)
+  end
+end
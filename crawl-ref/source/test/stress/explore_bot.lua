@@ -0,0 +1,51 @@
+-- Seeded autoexplore bot for the stress rc files that measure a long run.
+-- It explores, fights, rests and takes the stairs down until the given
+-- turn, then runs an optional check from the wizmode console and quits.
+-- The run is deterministic for a given seed.
+--
+-- Load it with "lua_file = test/stress/explore_bot.lua", then set:
+--   explore_bot.last_turn  the turn to stop at
+--   explore_bot.check      a line of Lua for the wizmode console, where the
+--                          debug module is available; use
+--                          debug.cpp_assert() to fail the run
+--
+-- Wizmode is needed.
+
+explore_bot = { last_turn = 3000, check = nil }
+
+local esc = string.char(27)
+local eol = string.char(13)
+local lua_console = "&" .. string.char(20)
+local cmds = {'o', string.char(9), '5', '&d'}
+
+local bot_start = true
+local last_turn = -1
+local command = 1
+
+function ready()
+  if you.turns() == 0 and bot_start then
+    bot_start = false
+    crawl.enable_more(false)
+    crawl.set_sendkeys_errors(true)
+    crawl.sendkeys("&Y" .. esc)
+    crawl.sendkeys(lua_console ..
+                   "debug.disable('confirmations')" .. eol ..
+                   "debug.disable('death')" .. eol .. esc)
+  end
+  if you.turns() ~= last_turn then
+    command = 1
+    last_turn = you.turns()
+
+    if you.turns() >= explore_bot.last_turn then
+      if explore_bot.check then
+        crawl.sendkeys(lua_console .. explore_bot.check .. eol .. esc)
+      end
+      crawl.sendkeys("*qyes" .. eol .. esc .. esc)
+    end
+  else
+    -- explore is done or keeps getting interrupted: fight, rest, and
+    -- finally move on to the next level
+    command = command % #cmds + 1
+  end
+  crawl.sendkeys(cmds[command])
+end
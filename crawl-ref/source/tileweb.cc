@@ -6,9 +6,11 @@
 
 #include <cerrno>
 #include <cstdarg>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -38,6 +40,7 @@
 #include "skills.h"
 #include "state.h"
 #include "stringutil.h"
+#include "syscalls.h"
 #include "throw.h"
 #include "tile-flags.h"
 #include "tile-player-flag-cut.h"
@@ -59,6 +62,16 @@
 
 //#define DEBUG_WEBSOCKETS
 
+// While running or resting, frames are coalesced over tile_runrest_rate
+// milliseconds. If more than this many bytes we sent are still waiting to be
+// read by the receivers, the coalescing interval is doubled (up to
+// MAX_FRAME_DELAY); it shrinks back once they catch up.
+#define MAX_RECEIVER_BACKLOG (32 * 1024)
+#define MAX_FRAME_DELAY 1000
+#define MIN_FRAME_BACKOFF 50
+// How often frame statistics are reported to the server.
+#define FRAME_STATS_INTERVAL 10000
+
 static unsigned int get_milliseconds()
 {
     // This is Unix-only, but so is Webtiles at the moment.
@@ -81,7 +94,14 @@ TilesFramework::TilesFramework() :
       m_next_flash_colour(BLACK),
       m_need_full_map(true),
       m_text_menu("menu_txt"),
-      m_print_fg(15)
+      m_print_fg(15),
+      m_frame_delay(0),
+      m_frames_sent(0),
+      m_frames_coalesced(0),
+      m_bytes_sent(0),
+      m_stats_start(0),
+      m_record(nullptr),
+      m_record_start(0)
 {
     screen_cell_t default_cell;
     default_cell.tile.bg = TILE_FLAG_UNSEEN;
@@ -95,6 +115,12 @@ TilesFramework::~TilesFramework()
 
 void TilesFramework::shutdown()
 {
+    if (m_record)
+    {
+        fclose(m_record);
+        m_record = nullptr;
+    }
+
     if (m_sock_name.empty())
         return;
 
@@ -115,8 +141,28 @@ bool TilesFramework::initialise()
     // Initially, switch to CRT.
     cgotoxy(1, 1, GOTO_CRT);
 
+    if (!m_record_name.empty())
+    {
+        m_record = fopen_u(m_record_name.c_str(), "w");
+        if (!m_record)
+        {
+            die("Can't open the webtiles record file %s: %s",
+                m_record_name.c_str(), strerror(errno));
+        }
+        m_record_start = get_milliseconds();
+    }
+
     if (m_sock_name.empty())
+    {
+        // Recordings should start the way a real session does.
+        if (m_record)
+        {
+            _send_version();
+            _send_options();
+            _send_layout();
+        }
         return true;
+    }
 
     // Init socket
     m_sock = socket(PF_UNIX, SOCK_DGRAM, 0);
@@ -181,6 +227,9 @@ void TilesFramework::finish_message()
     fprintf(stderr, "websocket: About to send %d bytes.\n", initial_buf_size);
 #endif
 
+    if (m_record)
+        _record("o", m_msg_buf.c_str());
+
     if (m_sock_name.empty())
     {
         m_msg_buf.clear();
@@ -188,6 +237,7 @@ void TilesFramework::finish_message()
     }
 
     m_msg_buf.append("\n");
+    m_bytes_sent += m_msg_buf.size();
     const char* fragment_start = m_msg_buf.data();
     const char* data_end = m_msg_buf.data() + m_msg_buf.size();
     int fragments = 0;
@@ -306,42 +356,320 @@ void TilesFramework::_await_connection()
     if (m_sock_name.empty())
         return;
 
+    // Stop at the message that attaches, so that anything sent after it in
+    // the same burst, such as keys, stays queued for await_input().
     while (m_dest_addrs.size() == 0)
-        _receive_control_message();
+    {
+        if (m_control_queue.empty())
+            _read_control_messages(true);
+        _process_control_message();
+    }
 }
 
-wint_t TilesFramework::_receive_control_message()
+/*
+  Read every control message waiting on the socket into m_control_queue, so
+  that one wakeup handles a whole burst of them. If block is true, wait for
+  at least one.
+ */
+void TilesFramework::_read_control_messages(bool block)
 {
-    if (m_sock_name.empty())
-        return 0;
-
     char buf[4096]; // Should be enough for client->server messages
     sockaddr_un srcaddr;
     socklen_t srcaddr_len;
 
-    srcaddr_len = sizeof(srcaddr);
+    while (true)
+    {
+        srcaddr_len = sizeof(srcaddr);
+
+        int len = recvfrom(m_sock, buf, sizeof(buf),
+                           block ? 0 : MSG_DONTWAIT,
+                           (sockaddr *) &srcaddr, &srcaddr_len);
+
+        if (len == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+            die("Socket read error: %s", strerror(errno));
+        }
+
+        m_control_queue.emplace_back(srcaddr, string(buf, len));
+        block = false;
+    }
+}
 
-    int len = recvfrom(m_sock, buf, sizeof(buf),
-                       0,
-                       (sockaddr *) &srcaddr, &srcaddr_len);
+/*
+  Handle queued control messages in order, until one of them results in
+  input. The rest stay queued for the next call.
+ */
+wint_t TilesFramework::_process_control_messages()
+{
+    while (!m_control_queue.empty())
+    {
+        const wint_t c = _process_control_message();
+        if (c != 0)
+            return c;
+    }
+    return 0;
+}
 
-    if (len == -1)
-        die("Socket read error: %s", strerror(errno));
+// Handle the first queued control message, returning any input from it.
+wint_t TilesFramework::_process_control_message()
+{
+    const pair<sockaddr_un, string> msg = m_control_queue.front();
+    m_control_queue.pop_front();
 
-    string data(buf, len);
     try
     {
-        return _handle_control_message(srcaddr, data);
+        return _handle_control_message(msg.first, msg.second);
     }
     catch (JsonWrapper::MalformedException&)
     {
         dprf("Malformed control message!");
+    }
+    return 0;
+}
+
+/*
+  An in-place tokenizer for flat JSON objects, used for the small control
+  messages that arrive most often, such as {"msg":"key","keycode":13}. Only
+  objects with a few string, number and boolean members and no escape
+  sequences are accepted; parse() returns false for anything else, which is
+  then left to the full json_decode() parser.
+ */
+struct flat_json_object
+{
+    enum { MAX_MEMBERS = 8 };
+
+    struct member
+    {
+        const char *name;
+        size_t name_len;
+        const char *value;
+        size_t value_len;
+        JsonTag tag;
+    };
+
+    member members[MAX_MEMBERS];
+    int num_members = 0;
+
+    static const char *skip_space(const char *p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n'
+                           || *p == '\r'))
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    // Scan a string without escapes; p points at the opening quote.
+    static const char *scan_string(const char *p, const char *end,
+                                   const char *&str, size_t &len)
+    {
+        str = ++p;
+        while (p < end && *p != '"')
+        {
+            if (*p == '\\')
+                return nullptr;
+            ++p;
+        }
+        if (p >= end)
+            return nullptr;
+        len = p - str;
+        return p + 1;
+    }
+
+    bool parse(const char *p, const char *end)
+    {
+        p = skip_space(p, end);
+        if (p >= end || *p++ != '{')
+            return false;
+
+        p = skip_space(p, end);
+        if (p < end && *p == '}')
+            return true;
+
+        while (p < end)
+        {
+            if (num_members >= MAX_MEMBERS || *p != '"')
+                return false;
+
+            member &m = members[num_members++];
+            p = scan_string(p, end, m.name, m.name_len);
+            if (!p)
+                return false;
+
+            p = skip_space(p, end);
+            if (p >= end || *p++ != ':')
+                return false;
+            p = skip_space(p, end);
+            if (p >= end)
+                return false;
+
+            if (*p == '"')
+            {
+                m.tag = JSON_STRING;
+                p = scan_string(p, end, m.value, m.value_len);
+                if (!p)
+                    return false;
+            }
+            else
+            {
+                m.value = p;
+                while (p < end && (isaalnum(*p) || *p == '-' || *p == '+'
+                                   || *p == '.'))
+                {
+                    ++p;
+                }
+                m.value_len = p - m.value;
+                if (m.value_len == 4 && !strncmp(m.value, "true", 4)
+                    || m.value_len == 5 && !strncmp(m.value, "false", 5))
+                {
+                    m.tag = JSON_BOOL;
+                }
+                else if (m.value_len
+                         && (isadigit(*m.value) || *m.value == '-'))
+                {
+                    m.tag = JSON_NUMBER;
+                }
+                else
+                    return false; // null, nested values, or garbage
+            }
+
+            p = skip_space(p, end);
+            if (p >= end)
+                return false;
+            if (*p == '}')
+                return skip_space(p + 1, end) == end;
+            if (*p++ != ',')
+                return false;
+            p = skip_space(p, end);
+        }
+        return false;
+    }
+
+    const member *find(const char *name, JsonTag tag) const
+    {
+        const size_t len = strlen(name);
+        for (int i = 0; i < num_members; ++i)
+        {
+            if (members[i].name_len == len
+                && !strncmp(members[i].name, name, len))
+            {
+                return members[i].tag == tag ? &members[i] : nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    bool string_is(const char *name, const char *value) const
+    {
+        const member *m = find(name, JSON_STRING);
+        return m && m->value_len == strlen(value)
+               && !strncmp(m->value, value, m->value_len);
+    }
+
+    bool number(const char *name, int &value) const
+    {
+        const member *m = find(name, JSON_NUMBER);
+        if (!m)
+            return false;
+        value = (int) strtod(string(m->value, m->value_len).c_str(), nullptr);
+        return true;
+    }
+
+    bool boolean(const char *name, bool &value) const
+    {
+        const member *m = find(name, JSON_BOOL);
+        if (!m)
+            return false;
+        value = m->value_len == 4;
+        return true;
+    }
+};
+
+/*
+  Handle the most frequent control messages without building a JsonNode
+  tree. Returns false if the message isn't one of them, or isn't in the
+  simple form we expect, in which case it should be handled in full.
+ */
+bool TilesFramework::_handle_simple_control_message(sockaddr_un addr,
+                                                    const string &data,
+                                                    wint_t &c)
+{
+    flat_json_object obj;
+    if (!obj.parse(data.data(), data.data() + data.size()))
+        return false;
+
+    c = 0;
+    if (obj.string_is("msg", "key"))
+    {
+        int keycode;
+        if (!obj.number("keycode", keycode))
+            return false;
+        c = keycode;
+    }
+    else if (obj.string_is("msg", "attach"))
+    {
+        bool primary;
+        if (!obj.boolean("primary", primary))
+            return false;
+        _attach(addr, primary);
+    }
+    else if (obj.string_is("msg", "spectator_joined"))
+        _spectator_joined();
+    else if (obj.string_is("msg", "click_travel"))
+    {
+        int x, y;
+        if (!obj.number("x", x) || !obj.number("y", y))
+            return false;
+        bool force = false;
+        obj.boolean("force", force);
+        c = _click_travel(coord_def(x, y), force);
+    }
+    else
+        return false;
+
+    return true;
+}
+
+void TilesFramework::_attach(sockaddr_un addr, bool primary)
+{
+    m_dest_addrs.push_back(addr);
+    m_controlled_from_web = primary;
+}
+
+void TilesFramework::_spectator_joined()
+{
+    flush_messages();
+    _send_everything();
+    flush_messages();
+}
+
+// Handle a click on the map, at a position relative to m_origin; returns
+// the resulting input, if any.
+wint_t TilesFramework::_click_travel(const coord_def &pos, bool force)
+{
+    if (mouse_control::current_mode() != MOUSE_MODE_COMMAND)
         return 0;
+
+    int c = click_travel(pos + m_origin, force);
+    if (c != CK_MOUSE_CMD)
+    {
+        clear_messages();
+        process_command((command_type) c);
     }
+    return CK_MOUSE_CMD;
 }
 
 wint_t TilesFramework::_handle_control_message(sockaddr_un addr, string data)
 {
+    wint_t simple_c;
+    if (_handle_simple_control_message(addr, data, simple_c))
+        return simple_c;
+
     JsonWrapper obj = json_decode(data.c_str());
     obj.check(JSON_OBJECT);
 
@@ -359,8 +687,7 @@ wint_t TilesFramework::_handle_control_message(sockaddr_un addr, string data)
         JsonWrapper primary = json_find_member(obj.node, "primary");
         primary.check(JSON_BOOL);
 
-        m_dest_addrs.push_back(addr);
-        m_controlled_from_web = primary->bool_;
+        _attach(addr, primary->bool_);
     }
     else if (msgtype == "key")
     {
@@ -370,11 +697,7 @@ wint_t TilesFramework::_handle_control_message(sockaddr_un addr, string data)
         c = (int) keycode->number_;
     }
     else if (msgtype == "spectator_joined")
-    {
-        flush_messages();
-        _send_everything();
-        flush_messages();
-    }
+        _spectator_joined();
     else if (msgtype == "menu_scroll")
     {
         JsonWrapper first = json_find_member(obj.node, "first");
@@ -405,8 +728,7 @@ wint_t TilesFramework::_handle_control_message(sockaddr_un addr, string data)
         if (Options.note_chat_messages)
             take_note(Note(NOTE_MESSAGE, MSGCH_PLAIN, 0, content->string_));
     }
-    else if (msgtype == "click_travel" &&
-             mouse_control::current_mode() == MOUSE_MODE_COMMAND)
+    else if (msgtype == "click_travel")
     {
         JsonWrapper x = json_find_member(obj.node, "x");
         JsonWrapper y = json_find_member(obj.node, "y");
@@ -414,14 +736,9 @@ wint_t TilesFramework::_handle_control_message(sockaddr_un addr, string data)
         y.check(JSON_NUMBER);
         JsonWrapper force = json_find_member(obj.node, "force");
 
-        coord_def gc = coord_def((int) x->number_, (int) y->number_) + m_origin;
-        c = click_travel(gc, force.node && force->tag == JSON_BOOL && force->bool_);
-        if (c != CK_MOUSE_CMD)
-        {
-            clear_messages();
-            process_command((command_type) c);
-        }
-        c = CK_MOUSE_CMD;
+        c = _click_travel(coord_def((int) x->number_, (int) y->number_),
+                          force.node && force->tag == JSON_BOOL
+                          && force->bool_);
     }
     else if (msgtype == "formatted_scroller_scroll")
     {
@@ -441,6 +758,14 @@ bool TilesFramework::await_input(wint_t& c, bool block)
 
     while (true)
     {
+        // Input may be left over from the last burst of control messages.
+        if (!m_control_queue.empty())
+        {
+            c = _process_control_messages();
+            if (c != 0)
+                return true;
+        }
+
         do
         {
             FD_ZERO(&fds);
@@ -470,7 +795,8 @@ bool TilesFramework::await_input(wint_t& c, bool block)
         {
             if (!m_sock_name.empty() && FD_ISSET(m_sock, &fds))
             {
-                c = _receive_control_message();
+                _read_control_messages(false);
+                c = _process_control_messages();
 
                 if (c != 0)
                     return true;
@@ -1456,26 +1782,27 @@ void TilesFramework::_send_cursor(cursor_type type)
     }
 }
 
+void TilesFramework::_mcache_ref(const coord_def &gc, bool inc)
+{
+    int fg_idx = m_current_view(gc).tile.fg & TILE_FLAG_MASK;
+    if (fg_idx >= TILEP_MCACHE_START)
+    {
+        mcache_entry *entry = mcache.get(fg_idx);
+        if (entry)
+        {
+            if (inc)
+                entry->inc_ref();
+            else
+                entry->dec_ref();
+        }
+    }
+}
+
 void TilesFramework::_mcache_ref(bool inc)
 {
     for (int y = 0; y < GYM; y++)
         for (int x = 0; x < GXM; x++)
-        {
-            coord_def gc(x, y);
-
-            int fg_idx = m_current_view(gc).tile.fg & TILE_FLAG_MASK;
-            if (fg_idx >= TILEP_MCACHE_START)
-            {
-                mcache_entry *entry = mcache.get(fg_idx);
-                if (entry)
-                {
-                    if (inc)
-                        entry->inc_ref();
-                    else
-                        entry->dec_ref();
-                }
-            }
-        }
+            _mcache_ref(coord_def(x, y), inc);
 }
 
 void TilesFramework::_send_map(bool force_full)
@@ -1524,56 +1851,69 @@ void TilesFramework::_send_map(bool force_full)
     coord_def last_gc(0, 0);
     bool send_gc = true;
 
-    json_open_array("cells");
-    for (int y = 0; y < GYM; y++)
-        for (int x = 0; x < GXM; x++)
-        {
-            coord_def gc(x, y);
-
-            if (!is_dirty(gc) && !force_full)
-                continue;
+    // Cells sent in this update; only these need to be copied into
+    // m_current_view and m_current_map_knowledge afterwards.
+    vector<coord_def> sent_cells;
 
-            if (cell_needs_redraw(gc))
-            {
-                screen_cell_t *cell = &m_next_view(gc);
+    auto send_cell = [&](const coord_def &gc)
+    {
+        if (cell_needs_redraw(gc))
+        {
+            screen_cell_t *cell = &m_next_view(gc);
 
-                draw_cell(cell, gc, false, m_current_flash_colour);
-                cell->tile.flv = env.tile_flv(gc);
-                pack_cell_overlays(gc, &(cell->tile));
-            }
+            draw_cell(cell, gc, false, m_current_flash_colour);
+            cell->tile.flv = env.tile_flv(gc);
+            pack_cell_overlays(gc, &(cell->tile));
+        }
 
-            mark_clean(gc);
+        mark_clean(gc);
+        sent_cells.push_back(gc);
 
-            if (m_origin.equals(-1, -1))
-                m_origin = gc;
+        if (m_origin.equals(-1, -1))
+            m_origin = gc;
 
-            json_open_object();
-            if (send_gc
-                || last_gc.x + 1 != gc.x
-                || last_gc.y != gc.y)
-            {
-                json_write_int("x", x - m_origin.x);
-                json_write_int("y", y - m_origin.y);
-                json_treat_as_empty();
-            }
+        json_open_object();
+        if (send_gc
+            || last_gc.x + 1 != gc.x
+            || last_gc.y != gc.y)
+        {
+            json_write_int("x", gc.x - m_origin.x);
+            json_write_int("y", gc.y - m_origin.y);
+            json_treat_as_empty();
+        }
 
-            const screen_cell_t& sc = force_full ? default_cell
-                : m_current_view(gc);
-            const map_cell& mc = force_full ? default_map_cell
-                : m_current_map_knowledge(gc);
-            _send_cell(gc,
-                       sc,
-                       m_next_view(gc),
-                       mc, env.map_knowledge(gc),
-                       new_monster_locs, force_full);
-
-            if (!json_is_empty())
-            {
-                send_gc = false;
-                last_gc = gc;
-            }
-            json_close_object(true);
+        const screen_cell_t& sc = force_full ? default_cell
+            : m_current_view(gc);
+        const map_cell& mc = force_full ? default_map_cell
+            : m_current_map_knowledge(gc);
+        _send_cell(gc,
+                   sc,
+                   m_next_view(gc),
+                   mc, env.map_knowledge(gc),
+                   new_monster_locs, force_full);
+
+        if (!json_is_empty())
+        {
+            send_gc = false;
+            last_gc = gc;
         }
+        json_close_object(true);
+    };
+
+    json_open_array("cells");
+    if (force_full)
+    {
+        for (int y = 0; y < GYM; y++)
+            for (int x = 0; x < GXM; x++)
+                send_cell(coord_def(x, y));
+    }
+    else
+    {
+        // Visit only dirty cells, in the same row-major order as above so
+        // that the client's run-length coordinate elision still applies.
+        for (int x = 0, y = 0; m_dirty_cells.find_next(x, y); ++x)
+            send_cell(coord_def(x, y));
+    }
     json_close_array(true);
 
     json_close_object(true);
@@ -1583,18 +1923,60 @@ void TilesFramework::_send_map(bool force_full)
     if (force_full)
         _send_cursor(CURSOR_MAP);
 
-    if (m_mcache_ref_done)
-        _mcache_ref(false);
+    if (force_full || !m_mcache_ref_done)
+    {
+        if (m_mcache_ref_done)
+            _mcache_ref(false);
 
-    m_current_map_knowledge = env.map_knowledge;
-    m_current_view = m_next_view;
+        m_current_map_knowledge = env.map_knowledge;
+        m_current_view = m_next_view;
 
-    _mcache_ref(true);
+        _mcache_ref(true);
+    }
+    else
+    {
+        // Unchanged cells keep their references; only move the references
+        // of the cells we just sent.
+        for (const coord_def &gc : sent_cells)
+        {
+            _mcache_ref(gc, false);
+            m_current_map_knowledge(gc) = env.map_knowledge(gc);
+            m_current_view(gc) = m_next_view(gc);
+            _mcache_ref(gc, true);
+        }
+    }
     m_mcache_ref_done = true;
 
     m_monster_locs = new_monster_locs;
 }
 
+// Whether the client's copy of the cell at gc is out of date, i.e. whether
+// _send_cell() would have anything to say about it.
+bool TilesFramework::_cell_changed(const coord_def &gc)
+{
+    const screen_cell_t &cur = m_current_view(gc);
+    const screen_cell_t &next = m_next_view(gc);
+    const map_cell &cur_mc = m_current_map_knowledge(gc);
+    const map_cell &next_mc = env.map_knowledge(gc);
+
+    // Monsters are always resent to keep m_monster_locs complete, and the
+    // player so that doll changes are noticed.
+    if (next_mc.monsterinfo() || cur_mc.monsterinfo()
+        || (next.tile.fg & TILE_FLAG_MASK) == TILEP_PLAYER)
+    {
+        return true;
+    }
+
+    return cur.glyph != next.glyph
+           || cur.colour != next.colour
+           || cur.flash_colour != next.flash_colour
+           || cur.tile != next.tile
+           || cur.tile.flv.floor != next.tile.flv.floor
+           || cur.tile.flv.special != next.tile.flv.special
+           || cur_mc.feat() != next_mc.feat()
+           || get_cell_map_feature(cur_mc) != get_cell_map_feature(gc);
+}
+
 void TilesFramework::_send_monster(const coord_def &gc, const monster_info* m,
                                    map<uint32_t, coord_def>& new_monster_locs,
                                    bool force_full)
@@ -1707,7 +2089,8 @@ void TilesFramework::load_dungeon(const crawl_view_buffer &vbuf,
             pack_cell_overlays(grid, &(cell->tile));
 
             mark_clean(grid); // Remove redraw flag
-            mark_dirty(grid);
+            if (_cell_changed(grid))
+                mark_dirty(grid);
         }
 
     m_next_gc = gc;
@@ -1838,7 +2221,14 @@ void TilesFramework::cgotoxy(int x, int y, GotoRegion region)
     m_cursor_region = region;
 }
 
-void TilesFramework::redraw()
+/**
+ * Send everything that changed since the last frame to the receivers.
+ *
+ * @param coalesce  if true, and the player is running or resting, the frame
+ *                  may be skipped and its changes sent along with a later one.
+ * @return whether a frame was sent.
+ */
+bool TilesFramework::redraw(bool coalesce)
 {
     if (!has_receivers())
     {
@@ -1847,9 +2237,17 @@ void TilesFramework::redraw()
             _mcache_ref(false);
             m_mcache_ref_done = false;
         }
-        return;
+        return false;
+    }
+
+    if (coalesce && !_frame_due())
+    {
+        m_frames_coalesced++;
+        return false;
     }
 
+    const unsigned long cpu_start = m_record ? _cpu_microseconds() : 0;
+
     if (m_layout_reset)
     {
         _send_layout();
@@ -1886,6 +2284,110 @@ void TilesFramework::redraw()
 
     m_need_redraw = false;
     m_last_tick_redraw = get_milliseconds();
+    m_frames_sent++;
+
+    if (m_record)
+    {
+        _record("f", make_stringf("%lu", _cpu_microseconds() - cpu_start)
+                     .c_str());
+    }
+
+    if (m_last_tick_redraw - m_stats_start >= FRAME_STATS_INTERVAL)
+        _send_frame_stats();
+
+    return true;
+}
+
+// CPU time used by the process so far, for timing the encoder.
+unsigned long TilesFramework::_cpu_microseconds()
+{
+    timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts))
+        return 0;
+    return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+/*
+  Append an entry to the recording started with -webtiles-record. Each entry
+  is a single line: a type ("o" for an output message, "i" for an input key,
+  "f" for the encoder CPU time of a frame in microseconds), the milliseconds
+  since the recording started, the turn count, and the data, without any
+  newline the data ends with.
+ */
+void TilesFramework::_record(const char *type, const char *data)
+{
+    int len = strlen(data);
+    while (len > 0 && data[len - 1] == '\n')
+        --len;
+    fprintf(m_record, "%s %u %d %.*s\n", type,
+            get_milliseconds() - m_record_start, you.num_turns, len, data);
+}
+
+void TilesFramework::record_input(int key)
+{
+    if (m_record)
+        _record("i", make_stringf("%d", key).c_str());
+}
+
+// Number of bytes we sent that the receivers haven't read yet, or 0 if the
+// platform can't tell us.
+int TilesFramework::_receiver_backlog() const
+{
+#ifdef TIOCOUTQ
+    int pending = 0;
+    if (!m_sock_name.empty() && ioctl(m_sock, TIOCOUTQ, &pending) == 0)
+        return pending;
+#endif
+    return 0;
+}
+
+// Whether a coalescable frame should be sent now. Outside of runs and rests
+// this is always true; during them, frames are spaced out by a delay that
+// grows while the receivers fall behind.
+bool TilesFramework::_frame_due()
+{
+    if (!you.running)
+        return true;
+
+    const unsigned int base_delay = Options.tile_runrest_rate;
+    if (_receiver_backlog() > MAX_RECEIVER_BACKLOG)
+    {
+        m_frame_delay = min(max(m_frame_delay * 2, base_delay
+                                                   + MIN_FRAME_BACKOFF),
+                            (unsigned int) MAX_FRAME_DELAY);
+    }
+    else if (m_frame_delay > base_delay)
+        m_frame_delay = max(m_frame_delay / 2, base_delay);
+    else
+        m_frame_delay = base_delay;
+
+    return get_milliseconds() - m_last_tick_redraw >= m_frame_delay;
+}
+
+/*
+  Report frame and output rates since the last report to the server, for
+  monitoring.
+ */
+void TilesFramework::_send_frame_stats()
+{
+    const unsigned int now = get_milliseconds();
+    const unsigned int elapsed = max(now - m_stats_start, 1U);
+
+    if (m_stats_start)
+    {
+        send_message("*{\"msg\":\"frame_stats\",\"fps\":%.2f,"
+                     "\"bytes_per_sec\":%lu,\"frames\":%d,"
+                     "\"coalesced\":%d,\"frame_delay\":%u,\"backlog\":%d}",
+                     m_frames_sent * 1000.0 / elapsed,
+                     (unsigned long) (m_bytes_sent * 1000 / elapsed),
+                     m_frames_sent, m_frames_coalesced, m_frame_delay,
+                     _receiver_backlog());
+    }
+
+    m_stats_start = now;
+    m_frames_sent = 0;
+    m_frames_coalesced = 0;
+    m_bytes_sent = 0;
 }
 
 void TilesFramework::update_minimap(const coord_def& gc)
@@ -2064,28 +2566,28 @@ void TilesFramework::clear_to_end_of_line()
 void TilesFramework::mark_for_redraw(const coord_def& gc)
 {
     mark_dirty(gc);
-    m_cells_needing_redraw[gc.y * GXM + gc.x] = true;
+    m_cells_needing_redraw.set(gc);
 }
 
 void TilesFramework::mark_dirty(const coord_def& gc)
 {
-    m_dirty_cells[gc.y * GXM + gc.x] = true;
+    m_dirty_cells.set(gc);
 }
 
 void TilesFramework::mark_clean(const coord_def& gc)
 {
-    m_cells_needing_redraw[gc.y * GXM + gc.x] = false;
-    m_dirty_cells[gc.y * GXM + gc.x] = false;
+    m_cells_needing_redraw.set(gc, false);
+    m_dirty_cells.set(gc, false);
 }
 
 bool TilesFramework::is_dirty(const coord_def& gc)
 {
-    return m_dirty_cells[gc.y * GXM + gc.x];
+    return m_dirty_cells(gc);
 }
 
 bool TilesFramework::cell_needs_redraw(const coord_def& gc)
 {
-    return m_cells_needing_redraw[gc.y * GXM + gc.x];
+    return m_cells_needing_redraw(gc);
 }
 
 void TilesFramework::write_message_escaped(const string& s)
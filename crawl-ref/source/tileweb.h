@@ -7,10 +7,11 @@
 
 #ifdef USE_TILE_WEB
 
-#include <bitset>
+#include <deque>
 #include <map>
 #include <sys/un.h>
 
+#include "bitary.h"
 #include "cursor-type.h"
 #include "equipment-type.h"
 #include "map-cell.h"
@@ -107,7 +108,7 @@ public:
     void mark_for_redraw(const coord_def& gc);
     void set_need_redraw(unsigned int min_tick_delay = 0);
     bool need_redraw() const;
-    void redraw();
+    bool redraw(bool coalesce = false);
 
     void place_cursor(cursor_type type, const coord_def &gc);
     void clear_text_tags(text_tag_type type);
@@ -149,7 +150,7 @@ public:
     void send_message(PRINTF(1, ));
     void flush_messages();
 
-    bool has_receivers() { return !m_dest_addrs.empty(); }
+    bool has_receivers() { return !m_dest_addrs.empty() || m_record; }
     bool is_controlled_from_web() { return m_controlled_from_web; }
 
     /* Webtiles can receive input both via stdin, and on the
@@ -197,6 +198,10 @@ public:
     string m_sock_name;
     bool m_await_connection;
 
+    // If set, all output and input is also logged to this file.
+    string m_record_name;
+    void record_input(int key);
+
     void set_text_cursor(bool enabled);
     void set_ui_state(WebtilesUIState state);
     WebtilesUIState get_ui_state() { return m_ui_state; }
@@ -221,7 +226,18 @@ protected:
 
     void _await_connection();
     wint_t _handle_control_message(sockaddr_un addr, string data);
-    wint_t _receive_control_message();
+    bool _handle_simple_control_message(sockaddr_un addr, const string &data,
+                                        wint_t &c);
+    void _read_control_messages(bool block);
+    wint_t _process_control_messages();
+    wint_t _process_control_message();
+
+    void _attach(sockaddr_un addr, bool primary);
+    void _spectator_joined();
+    wint_t _click_travel(const coord_def &pos, bool force);
+
+    // Control messages received but not handled yet.
+    deque<pair<sockaddr_un, string>> m_control_queue;
 
     struct JsonFrame
     {
@@ -265,8 +281,9 @@ protected:
     coord_def m_next_view_tl;
     coord_def m_next_view_br;
 
-    bitset<GXM * GYM> m_dirty_cells;
-    bitset<GXM * GYM> m_cells_needing_redraw;
+    // Sparse, so that _send_map() only visits cells that actually changed.
+    SparseBitArray<GXM, GYM> m_dirty_cells;
+    SparseBitArray<GXM, GYM> m_cells_needing_redraw;
     void mark_dirty(const coord_def& gc);
     void mark_clean(const coord_def& gc);
     bool is_dirty(const coord_def& gc);
@@ -306,6 +323,7 @@ protected:
 
     bool m_mcache_ref_done;
     void _mcache_ref(bool inc);
+    void _mcache_ref(const coord_def &gc, bool inc);
 
     void _send_cursor(cursor_type type);
     void _send_map(bool force_full = false);
@@ -314,6 +332,7 @@ protected:
                     const map_cell &current_mc, const map_cell &next_mc,
                     map<uint32_t, coord_def>& new_monster_locs,
                     bool force_full);
+    bool _cell_changed(const coord_def &gc);
     void _send_monster(const coord_def &gc, const monster_info* m,
                        map<uint32_t, coord_def>& new_monster_locs,
                        bool force_full);
@@ -321,6 +340,24 @@ protected:
     void _send_item(item_info& current, const item_info& next,
                     bool force_full);
     void _send_messages();
+
+    // Frame scheduling and statistics
+    unsigned int m_frame_delay;
+    int m_frames_sent;
+    int m_frames_coalesced;
+    uint64_t m_bytes_sent;
+    unsigned int m_stats_start;
+
+    bool _frame_due();
+    int _receiver_backlog() const;
+    void _send_frame_stats();
+
+    // Recording
+    FILE *m_record;
+    unsigned int m_record_start;
+
+    void _record(const char *type, const char *data);
+    static unsigned long _cpu_microseconds();
 };
 
 // Main interface for tiles functions
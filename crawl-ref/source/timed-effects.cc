@@ -54,6 +54,9 @@
 #include "viewchar.h"
 #include "unwind.h"
 
+// Turns of off-level catch-up that update_level() left for later.
+#define CATCHUP_TURNS_KEY "catchup_turns"
+
 /**
  * Choose a random, spooky hell effect message, print it, and make a loud noise
  * if appropriate. (1/6 chance of loud noise.)
@@ -1157,9 +1160,10 @@ static void _catchup_monster_moves(monster* mon, int turns)
     // Expire friendly summons
     if (mon->friendly() && mon->is_summoned() && !mon->is_perm_summoned())
     {
-        // You might still see them disappear if you were quick
+        // You might still see them disappear if you were quick. Otherwise
+        // they expired while you were away, so do it silently.
         if (turns > 2)
-            monster_die(*mon, KILL_DISMISSED, NON_MONSTER);
+            monster_die(*mon, KILL_DISMISSED, NON_MONSTER, true);
         else
         {
             mon_enchant abj  = mon->get_ench(ENCH_ABJ);
@@ -1368,9 +1372,11 @@ void monster::timeout_enchantments(int levels)
 /**
  * Update the level upon the player's return.
  *
- * @param elapsedTime how long the player was away.
+ * @param elapsedTime    how long the player was away.
+ * @param defer_monsters whether to leave each monster's catch-up until it's
+ *                       first seen or about to act; see catch_up_monster().
  */
-void update_level(int elapsedTime)
+void update_level(int elapsedTime, bool defer_monsters)
 {
     ASSERT(!crawl_state.game_is_arena());
 
@@ -1378,6 +1384,8 @@ void update_level(int elapsedTime)
 
 #ifdef DEBUG_DIAGNOSTICS
     int mons_total = 0;
+    int mons_deferred = 0;
+    const auto start = chrono::steady_clock::now();
 
     dprf("turns: %d", turns);
 #endif
@@ -1403,17 +1411,72 @@ void update_level(int elapsedTime)
         mons_total++;
 #endif
 
+        // Monsters that just arrived skip their catch-up; don't let the
+        // flag be cleared before they get to it.
+        if (defer_monsters && turns > 0 && !(mi->flags & MF_JUST_SUMMONED))
+        {
+            mi->props[CATCHUP_TURNS_KEY].get_int() += turns;
+#ifdef DEBUG_DIAGNOSTICS
+            mons_deferred++;
+#endif
+            continue;
+        }
+
         if (!update_monster(**mi, turns))
             continue;
     }
 
 #ifdef DEBUG_DIAGNOSTICS
-    dprf("total monsters on level = %d", mons_total);
+    const auto taken = chrono::duration_cast<chrono::microseconds>(
+                           chrono::steady_clock::now() - start);
+    dprf("total monsters on level = %d (%d deferred); update took %dus",
+         mons_total, mons_deferred, static_cast<int>(taken.count()));
 #endif
 
     delete_all_clouds();
 }
 
+/**
+ * Bring a monster up to date with any time the player spent away from its
+ * level that update_level() deferred. Off-level healing, forgetting and
+ * enchantment timeouts are all worked out in one step from the total time
+ * away, so several deferred absences add up to one catch-up.
+ *
+ * @param mon   The monster to update.
+ * @returns     nullptr if the monster was destroyed by the update;
+ *              otherwise the monster.
+ */
+monster* catch_up_monster(monster& mon)
+{
+    if (!mon.props.exists(CATCHUP_TURNS_KEY))
+        return &mon;
+
+    const int turns = mon.props[CATCHUP_TURNS_KEY].get_int();
+    mon.props.erase(CATCHUP_TURNS_KEY);
+    return update_monster(mon, turns);
+}
+
+/**
+ * Catch up all the monsters in the player's line of sight, so that they're
+ * shown as they should be when they first come into view.
+ */
+void catch_up_visible_monsters()
+{
+    // update_level() never runs in the arena.
+    if (crawl_state.game_is_arena())
+        return;
+
+    // Catching up moves monsters around, so find them all first.
+    vector<monster*> visible;
+    for (monster_near_iterator mi(you.pos()); mi; ++mi)
+        if (mi->props.exists(CATCHUP_TURNS_KEY))
+            visible.push_back(*mi);
+
+    for (monster *mon : visible)
+        if (mon->alive())
+            catch_up_monster(*mon);
+}
+
 /**
  * Update the monster upon the player's return
  *
@@ -1424,10 +1487,13 @@ void update_level(int elapsedTime)
  */
 monster* update_monster(monster& mon, int turns)
 {
-    // Pacified monsters often leave the level now.
+    // Pacified monsters often leave the level now. They left while the
+    // player was away, so don't announce it; with catch-up deferred, the
+    // player may already be standing next to them.
     if (mon.pacified() && turns > random2(40) + 21)
     {
-        make_mons_leave_level(&mon);
+        mon.flags |= MF_HARD_RESET;
+        monster_die(mon, KILL_DISMISSED, NON_MONSTER, true);
         return nullptr;
     }
 
@@ -7,8 +7,10 @@
 
 void change_labyrinth(bool msg = false);
 
-void update_level(int elapsedTime);
+void update_level(int elapsedTime, bool defer_monsters = false);
 monster* update_monster(monster& mon, int turns);
+monster* catch_up_monster(monster& mon);
+void catch_up_visible_monsters();
 void handle_time();
 
 void timeout_tombs(int duration);
@@ -64,6 +64,7 @@
 #include "stringutil.h"
 #include "target.h"
 #include "terrain.h"
+#include "timed-effects.h"
 #include "tilemcache.h"
 #ifdef USE_TILE
  #include "tile-flags.h"
@@ -469,6 +470,8 @@ void update_monsters_in_view()
     vector<string> msgs;
     vector<monster*> monsters;
 
+    catch_up_visible_monsters();
+
     for (monster_iterator mi; mi; ++mi)
     {
         if (you.see_cell(mi->pos()))
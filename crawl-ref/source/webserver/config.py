@@ -45,6 +45,10 @@ watch_socket_dirs = False
 # Game configs
 # %n in paths and urls is replaced by the current username
 # morgue_url is for a publicly available URL to access morgue_path
+# zygote_socket, if set, is the socket of a crawl_binary started with
+# -zygote <socket> (and the same -dir, if any); games are then forked from
+# that process, which has already loaded the maps and databases, instead of
+# being started from scratch. Falls back to starting crawl_binary directly.
 games = OrderedDict([
     ("dcss-web-trunk", dict(
         name = "DCSS trunk",
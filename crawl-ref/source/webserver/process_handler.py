@@ -10,7 +10,7 @@ import config
 from tornado.escape import json_decode, json_encode, xhtml_escape
 from tornado.ioloop import PeriodicCallback, IOLoop
 
-from terminal import TerminalRecorder
+from terminal import TerminalRecorder, ZygoteTerminalRecorder
 from connection import WebtilesSocketConnection
 from util import DynamicTemplateLoader, dgl_format_str, parse_where_data
 from game_data_handler import GameDataHandler
@@ -561,6 +561,7 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
         self.exit_reason = None
         self.exit_message = None
         self.exit_dump_url = None
+        self.frame_stats = None
 
         self._stale_pid = None
         self._stale_lockfile = None
@@ -711,10 +712,7 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
             self.logger.info("Starting game.")
 
         try:
-            self.process = TerminalRecorder(call, self.ttyrec_filename,
-                                            self._ttyrec_id_header(),
-                                            self.logger, self.io_loop,
-                                            config.recording_term_size)
+            self.process = self._start_process(call)
             self.process.end_callback = self._on_process_end
             self.process.output_callback = self._on_process_output
             self.process.activity_callback = self.note_activity
@@ -738,6 +736,19 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
             else:
                 self._on_process_end()
 
+    def _start_process(self, call):
+        args = (call, self.ttyrec_filename, self._ttyrec_id_header(),
+                self.logger, self.io_loop, config.recording_term_size)
+        zygote_socket = self.game_params.get("zygote_socket")
+        if zygote_socket:
+            try:
+                return ZygoteTerminalRecorder(zygote_socket, *args)
+            except Exception:
+                self.logger.warning("Couldn't start the game from the zygote "
+                                    "at %s, starting it directly.",
+                                    zygote_socket, exc_info=True)
+        return TerminalRecorder(*args)
+
     def connect(self, socketpath, primary = False):
         self.socketpath = socketpath
         self.conn = WebtilesSocketConnection(self.io_loop, self.socketpath, self.logger)
@@ -912,6 +923,11 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
                         self.send_to_all("dump", url = url)
                     else:
                         self.exit_dump_url = url
+            elif msgobj["msg"] == "frame_stats":
+                # Output rates since the last report, for monitoring.
+                del msgobj["msg"]
+                self.frame_stats = msgobj
+                self.logger.debug("Frame stats: %s", msgobj)
             elif msgobj["msg"] == "exit_reason":
                 self.exit_reason = msgobj["type"]
                 if "message" in msgobj:
@@ -1,11 +1,14 @@
 import pty
 import termios
 import os
+import errno
 import fcntl
 import struct
 import resource
 import signal
+import socket
 import sys
+import tempfile
 import time
 
 BUFSIZ = 2048
@@ -161,10 +164,19 @@ class TerminalRecorder(object):
     def send_signal(self, signal):
         os.kill(self.pid, signal)
 
+    def _exit_status(self):
+        pid, status = os.waitpid(self.pid, os.WNOHANG)
+        if pid == self.pid:
+            return status
+        return None
+
+    def _cleanup(self):
+        pass
+
     def poll(self):
         if self.returncode is None:
-            pid, status = os.waitpid(self.pid, os.WNOHANG)
-            if pid == self.pid:
+            status = self._exit_status()
+            if status is not None:
                 if os.WIFSIGNALED(status):
                     self.returncode = -os.WTERMSIG(status)
                 elif os.WIFEXITED(status):
@@ -183,6 +195,8 @@ class TerminalRecorder(object):
                 if self.ttyrec:
                     self.ttyrec.close()
 
+                self._cleanup()
+
                 if self.end_callback:
                     self.end_callback()
 
@@ -197,3 +211,127 @@ class TerminalRecorder(object):
         while len(data) > 0:
             written = os.write(self.child_fd, data)
             data = data[written:]
+
+
+class ZygoteTerminalRecorder(TerminalRecorder):
+    """Runs the game in a process forked by a crawl zygote (a crawl started
+    with -zygote <socket>) instead of executing the binary. The game opens
+    our pty by name, and the zygote reports its pid and then its exit status
+    over the request connection."""
+    def __init__(self, zygote_socket, *args, **kwargs):
+        self.zygote_socket = zygote_socket
+        self.zygote_conn = None
+        self.zygote_buffer = ""
+        self.zygote_status = None
+        self.errfifo_dir = None
+        super(ZygoteTerminalRecorder, self).__init__(*args, **kwargs)
+
+    def _spawn(self):
+        try:
+            self._request_game()
+        except Exception:
+            for fd in (self.child_fd, self.errpipe_read):
+                if fd is not None:
+                    os.close(fd)
+            self.child_fd = self.errpipe_read = None
+            if self.ttyrec:
+                self.ttyrec.close()
+            self._cleanup()
+            raise
+
+        self.io_loop.add_handler(self.zygote_conn.fileno(),
+                                 self._handle_zygote_read,
+                                 self.io_loop.READ | self.io_loop.ERROR)
+        self.io_loop.add_handler(self.child_fd,
+                                 self._handle_read,
+                                 self.io_loop.ERROR | self.io_loop.READ)
+        self.io_loop.add_handler(self.errpipe_read,
+                                 self._handle_err_read,
+                                 self.io_loop.READ)
+
+    def _request_game(self):
+        self.zygote_conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.zygote_conn.connect(self.zygote_socket)
+
+        # stderr goes through a fifo, since we can't pass descriptors
+        self.errfifo_dir = tempfile.mkdtemp(prefix="crawl-zygote-")
+        errfifo = os.path.join(self.errfifo_dir, "stderr")
+        os.mkfifo(errfifo, 0o600)
+        self.errpipe_read = os.open(errfifo, os.O_RDONLY | os.O_NONBLOCK)
+
+        self.child_fd, slave = os.openpty()
+        try:
+            cols, lines = self.get_terminal_size()
+            s = struct.pack("HHHH", lines, cols, 0, 0)
+            fcntl.ioctl(slave, termios.TIOCSWINSZ, s)
+
+            env            = dict(os.environ)
+            env["COLUMNS"] = str(cols)
+            env["LINES"]   = str(lines)
+            env["TERM"]    = "linux"
+
+            fields = ["tty=" + os.ttyname(slave), "err=" + errfifo,
+                      "cwd=" + os.getcwd()]
+            fields += ["env=%s=%s" % item for item in env.items()]
+            fields += ["arg=" + arg for arg in self.command]
+            self.zygote_conn.sendall("\0".join(fields) + "\0\0")
+
+            # The zygote answers as soon as it has forked
+            while "\n" not in self.zygote_buffer:
+                data = self.zygote_conn.recv(BUFSIZ)
+                if not data:
+                    break
+                self.zygote_buffer += data
+        finally:
+            os.close(slave)
+
+        reply, _, self.zygote_buffer = self.zygote_buffer.partition("\n")
+        if not reply.isdigit():
+            raise RuntimeError("Zygote failed to start the game: %s" % reply)
+        self.pid = int(reply)
+        self.zygote_conn.setblocking(0)
+
+    def _handle_zygote_read(self, fd, events):
+        try:
+            data = self.zygote_conn.recv(BUFSIZ)
+        except socket.error as e:
+            if e.errno in (errno.EAGAIN, errno.EWOULDBLOCK):
+                return
+            data = ""
+
+        self.zygote_buffer += data
+        if "\n" in self.zygote_buffer:
+            self.zygote_status = int(self.zygote_buffer.split("\n", 1)[0])
+        elif not data:
+            # The zygote went away; from now on, look for the game process
+            # directly.
+            self.io_loop.remove_handler(fd)
+            self.zygote_conn.close()
+            self.zygote_conn = None
+
+        self.poll()
+
+    def _exit_status(self):
+        if self.zygote_status is not None:
+            return self.zygote_status
+        if self.zygote_conn is None:
+            try:
+                os.kill(self.pid, 0)
+            except OSError as e:
+                if e.errno == errno.ESRCH:
+                    return 1 << 8 # Status unknown, report exit code 1
+        return None
+
+    def _cleanup(self):
+        if self.zygote_conn:
+            if self.pid is not None:
+                self.io_loop.remove_handler(self.zygote_conn.fileno())
+            self.zygote_conn.close()
+            self.zygote_conn = None
+        if self.errfifo_dir:
+            try:
+                os.unlink(os.path.join(self.errfifo_dir, "stderr"))
+            except OSError:
+                pass
+            os.rmdir(self.errfifo_dir)
+            self.errfifo_dir = None
@@ -63,15 +63,41 @@ namespace worley
        is 1.0. This makes an easy natural "scale" size of the cellular features. */
 #define DENSITY_ADJUSTMENT  0.398150
 
+    /* The feature points in one cube; there are at most 5, the largest
+       Poisson count. A point's pos is the cube's corner plus the point's
+       offset within the cube. */
+    struct cube_points
+    {
+        int32_t xi, yi, zi;
+        int32_t count;
+        uint32_t id[5];
+        double pos[5][3];
+    };
+
+    /* The cubes visited while sampling a batch of points. Nearby samples
+       visit mostly the same cubes, so remembering their feature points saves
+       regenerating them for every sample. Direct mapped: a cube just replaces
+       whatever was in its slot. */
+    struct cube_cache
+    {
+        static const int SLOTS = 512;
+        cube_points cubes[SLOTS];
+        bool used[SLOTS];
+
+        cube_cache() { memset(used, 0, sizeof(used)); }
+        const cube_points &get(int32_t xi, int32_t yi, int32_t zi);
+    };
+
     /* the function to merge-sort a "cube" of samples into the current best-found
        list of values. */
     static void AddSamples(int32_t xi, int32_t yi, int32_t zi, int32_t max_order,
             double at[3], double *F,
-            double (*delta)[3], uint32_t *ID);
+            double (*delta)[3], uint32_t *ID, cube_cache *cache);
 
     /* The main function! */
     static void _worley(double at[3], int32_t max_order,
-            double *F, double (*delta)[3], uint32_t *ID)
+            double *F, double (*delta)[3], uint32_t *ID,
+            cube_cache *cache = nullptr)
     {
         double x2,y2,z2, mx2, my2, mz2;
         double new_at[3];
@@ -99,7 +125,7 @@ namespace worley
            int32_t ii, jj, kk;
            for (ii=-1; ii<=1; ii++) for (jj=-1; jj<=1; jj++) for (kk=-1; kk<=1; kk++)
            AddSamples(int_at[0]+ii,int_at[1]+jj,int_at[2]+kk,
-           max_order, new_at, F, delta, ID);
+           max_order, new_at, F, delta, ID, cache);
            }
            But this wastes a lot of time working on cubes which are known to be
            too far away to matter! So we can use a more complex testing method
@@ -107,7 +133,7 @@ namespace worley
            speed of the algorithm. */
 
         /* Test the central cube for closest point(s). */
-        AddSamples(int_at[0], int_at[1], int_at[2], max_order, new_at, F, delta, ID);
+        AddSamples(int_at[0], int_at[1], int_at[2], max_order, new_at, F, delta, ID, cache);
 
         /* We test if neighbor cubes are even POSSIBLE contributors by examining the
            combinations of the sum of the squared distances from the cube's lower
@@ -125,62 +151,62 @@ namespace worley
         /* Test 6 facing neighbors of center cube. These are closest and most
            likely to have a close feature point. */
         if (x2<F[max_order-1])  AddSamples(int_at[0]-1, int_at[1]  , int_at[2]  ,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (y2<F[max_order-1])  AddSamples(int_at[0]  , int_at[1]-1, int_at[2]  ,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (z2<F[max_order-1])  AddSamples(int_at[0]  , int_at[1]  , int_at[2]-1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
 
         if (mx2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]  , int_at[2]  ,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (my2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]+1, int_at[2]  ,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (mz2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]  , int_at[2]+1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
 
         /* Test 12 "edge cube" neighbors if necessary. They're next closest. */
         if ( x2+ y2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]-1, int_at[2]  ,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if ( x2+ z2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]  , int_at[2]-1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if ( y2+ z2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]-1, int_at[2]-1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (mx2+my2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]+1, int_at[2]  ,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (mx2+mz2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]  , int_at[2]+1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (my2+mz2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]+1, int_at[2]+1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if ( x2+my2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]+1, int_at[2]  ,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if ( x2+mz2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]  , int_at[2]+1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if ( y2+mz2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]-1, int_at[2]+1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (mx2+ y2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]-1, int_at[2]  ,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (mx2+ z2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]  , int_at[2]-1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (my2+ z2<F[max_order-1]) AddSamples(int_at[0]  , int_at[1]+1, int_at[2]-1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
 
         /* Final 8 "corner" cubes */
         if ( x2+ y2+ z2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]-1, int_at[2]-1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if ( x2+ y2+mz2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]-1, int_at[2]+1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if ( x2+my2+ z2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]+1, int_at[2]-1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if ( x2+my2+mz2<F[max_order-1]) AddSamples(int_at[0]-1, int_at[1]+1, int_at[2]+1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (mx2+ y2+ z2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]-1, int_at[2]-1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (mx2+ y2+mz2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]-1, int_at[2]+1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (mx2+my2+ z2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]+1, int_at[2]-1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
         if (mx2+my2+mz2<F[max_order-1]) AddSamples(int_at[0]+1, int_at[1]+1, int_at[2]+1,
-                max_order, new_at, F, delta, ID);
+                max_order, new_at, F, delta, ID, cache);
 
         /* We're done! Convert everything to right size scale */
         for (i=0; i<max_order; i++)
@@ -194,13 +220,16 @@ namespace worley
         return;
     }
 
-    static void AddSamples(int32_t xi, int32_t yi, int32_t zi, int32_t max_order,
-            double at[3], double *F,
-            double (*delta)[3], uint32_t *ID)
+    static void _cube_points(int32_t xi, int32_t yi, int32_t zi,
+            cube_points &cube)
     {
-        double dx, dy, dz, fx, fy, fz, d2;
-        int32_t count, i, j, index;
-        uint32_t seed, this_id;
+        double fx, fy, fz;
+        int32_t count, j;
+        uint32_t seed;
+
+        cube.xi=xi;
+        cube.yi=yi;
+        cube.zi=zi;
 
         /* Each cube has a random number seed based on the cube's ID number.
            The seed might be better if it were a nonlinear hash like Perlin uses
@@ -213,9 +242,9 @@ namespace worley
 
         seed=1402024253*seed+586950981; /* churn the seed with good Knuth LCG */
 
-        for (j=0; j<count; j++) /* test and insert each point into our solution */
+        for (j=0; j<count; j++) /* generate each point */
         {
-            this_id=seed;
+            cube.id[j]=seed;
             seed=1402024253*seed+586950981; /* churn */
 
             /* compute the 0..1 feature point location's XYZ */
@@ -226,10 +255,47 @@ namespace worley
             fz=(seed+0.5)*(1.0/4294967296.0);
             seed=1402024253*seed+586950981; /* churn */
 
+            cube.pos[j][0]=xi+fx;
+            cube.pos[j][1]=yi+fy;
+            cube.pos[j][2]=zi+fz;
+        }
+        cube.count=count;
+    }
+
+    const cube_points &cube_cache::get(int32_t xi, int32_t yi, int32_t zi)
+    {
+        const uint32_t slot = ((uint32_t) xi * 73856093
+                               ^ (uint32_t) yi * 19349663
+                               ^ (uint32_t) zi * 83492791) % SLOTS;
+        cube_points &cube = cubes[slot];
+        if (!used[slot] || cube.xi != xi || cube.yi != yi || cube.zi != zi)
+        {
+            _cube_points(xi, yi, zi, cube);
+            used[slot] = true;
+        }
+        return cube;
+    }
+
+    static void AddSamples(int32_t xi, int32_t yi, int32_t zi, int32_t max_order,
+            double at[3], double *F,
+            double (*delta)[3], uint32_t *ID, cube_cache *cache)
+    {
+        double dx, dy, dz, d2;
+        int32_t i, j, index;
+        cube_points uncached;
+        const cube_points *cube = &uncached;
+
+        if (cache)
+            cube = &cache->get(xi, yi, zi);
+        else
+            _cube_points(xi, yi, zi, uncached);
+
+        for (j=0; j<cube->count; j++) /* test and insert each point into our solution */
+        {
             /* delta from feature point to sample location */
-            dx=xi+fx-at[0];
-            dy=yi+fy-at[1];
-            dz=zi+fz-at[2];
+            dx=cube->pos[j][0]-at[0];
+            dy=cube->pos[j][1]-at[1];
+            dz=cube->pos[j][2]-at[2];
 
             /* Distance computation!  Lots of interesting variations are
                possible here!
@@ -271,7 +337,7 @@ cases.]
                 }
                 /* Insert the new point's information into the list. */
                 F[index]=d2;
-                ID[index]=this_id;
+                ID[index]=cube->id[j];
                 delta[index][0]=dx;
                 delta[index][1]=dy;
                 delta[index][2]=dz;
@@ -281,14 +347,14 @@ cases.]
         return;
     }
 
-    noise_datum noise(double x, double y, double z)
+    static noise_datum _noise(double x, double y, double z, cube_cache *cache)
     {
         double point[3] = {x,y,z};
         double F[2];
         double delta[2][3];
         uint32_t id[2];
 
-        _worley(point, 2, F, delta, id);
+        _worley(point, 2, F, delta, id, cache);
 
         noise_datum datum;
         datum.distance[0] = F[0];
@@ -300,4 +366,17 @@ cases.]
                 datum.pos[i][j] = delta[i][j];
         return datum;
     }
+
+    noise_datum noise(double x, double y, double z)
+    {
+        return _noise(x, y, z, nullptr);
+    }
+
+    void noise(const double *x, const double *y, const double *z,
+               size_t count, noise_datum *out)
+    {
+        unique_ptr<cube_cache> cache(new cube_cache);
+        for (size_t i = 0; i < count; ++i)
+            out[i] = _noise(x[i], y[i], z[i], cache.get());
+    }
 }
@@ -68,4 +68,8 @@ struct noise_datum
 };
 
 noise_datum noise(double x, double y, double z);
+// The same as calling noise() for each of count points, but faster when
+// the points are close together.
+void noise(const double *x, const double *y, const double *z, size_t count,
+           noise_datum *out);
 }
@@ -0,0 +1,415 @@
+/**
+ * @file
+ * @brief Fork server for webtiles hosts.
+ *
+ * Started with -zygote <socket>, crawl loads everything that doesn't depend
+ * on a player's options (see preload_game_data()) once, then listens on a
+ * local stream socket and forks a game process for each request. The games
+ * share the preloaded data copy-on-write, which makes them start faster and
+ * use less memory than fresh processes would.
+ *
+ * A request is a list of NUL-terminated fields, ended by an empty field:
+ *   tty=<path>    terminal for stdin, stdout and stderr (required)
+ *   err=<path>    file or fifo to use as stderr instead
+ *   cwd=<path>    working directory
+ *   env=<k>=<v>   environment variable; may be repeated
+ *   arg=<value>   command line argument, starting with argv[0]; repeated
+ * The zygote replies with the game's pid on a line of its own, and once the
+ * game has exited with its raw wait status on a second line. A request that
+ * can't be served gets a single "error <reason>" line instead.
+ *
+ * Games must use the same data directories as the zygote, since the maps
+ * and databases have already been loaded from there.
+**/
+
+#include "AppHdr.h"
+
+#ifdef USE_TILE_WEB
+
+#include "zygote.h"
+
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "initfile.h"
+#include "mapdef.h" // depth_ranges, for resetting SysEnv
+#include "startup.h"
+#include "state.h"
+#include "stringutil.h"
+
+struct zygote_client
+{
+    int fd;
+    string request;
+    pid_t pid;          // The game forked for this client, once there is one.
+};
+
+struct zygote_request
+{
+    string tty;
+    string err;
+    string cwd;
+    vector<string> env;
+    vector<string> args;
+};
+
+static int listen_fd = -1;
+static int child_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t stop_requested = 0;
+static vector<zygote_client> clients;
+
+static const int handled_signals[] = { SIGCHLD, SIGTERM, SIGINT, SIGHUP,
+                                       SIGPIPE };
+static struct sigaction saved_actions[ARRAYSZ(handled_signals)];
+
+static void _handle_child(int)
+{
+    // Just wake up the select() loop; the children are reaped there.
+    const int saved_errno = errno;
+    const char c = 0;
+    if (write(child_pipe[1], &c, 1)) {};
+    errno = saved_errno;
+}
+
+static void _handle_stop(int)
+{
+    stop_requested = 1;
+}
+
+static void _install_signals()
+{
+    for (unsigned int i = 0; i < ARRAYSZ(handled_signals); ++i)
+    {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sigemptyset(&sa.sa_mask);
+        switch (handled_signals[i])
+        {
+        case SIGCHLD:
+            sa.sa_handler = _handle_child;
+            sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+            break;
+        case SIGPIPE:
+            // Clients that have gone away are noticed by write() failing.
+            sa.sa_handler = SIG_IGN;
+            break;
+        default:
+            sa.sa_handler = _handle_stop;
+            break;
+        }
+        sigaction(handled_signals[i], &sa, &saved_actions[i]);
+    }
+}
+
+static void _restore_signals()
+{
+    for (unsigned int i = 0; i < ARRAYSZ(handled_signals); ++i)
+        sigaction(handled_signals[i], &saved_actions[i], nullptr);
+}
+
+static void _listen(const string &sock_name)
+{
+    listen_fd = socket(PF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+        die("Can't open the zygote socket!");
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (sock_name.size() >= sizeof(addr.sun_path))
+        die("Zygote socket name too long: %s", sock_name.c_str());
+    strcpy(addr.sun_path, sock_name.c_str());
+
+    // A stale socket is left behind if a previous zygote was killed.
+    unlink(sock_name.c_str());
+    if (::bind(listen_fd, (sockaddr*) &addr, sizeof(sockaddr_un)))
+        die("Can't bind the zygote socket!");
+    if (listen(listen_fd, 16))
+        die("Can't listen on the zygote socket!");
+
+    if (pipe(child_pipe))
+        die("Can't create the zygote child pipe!");
+    fcntl(child_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(child_pipe[1], F_SETFL, O_NONBLOCK);
+}
+
+static void _reply(int fd, const string &line)
+{
+    // Replies are a few bytes each; if they don't fit the client is gone
+    // and there is nobody left to tell.
+    const string msg = line + "\n";
+    if (write(fd, msg.data(), msg.size())) {};
+}
+
+static bool _request_complete(const string &request)
+{
+    // Fields are never empty, so an empty one is a NUL right after another
+    // NUL or at the very start.
+    return !request.empty()
+           && (request[0] == '\0'
+               || request.find(string("\0\0", 2)) != string::npos);
+}
+
+static bool _parse_request(const string &data, zygote_request &req,
+                           string &error)
+{
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        const size_t end = data.find('\0', pos);
+        const string field = data.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (field.empty())
+            break;
+        else if (starts_with(field, "tty="))
+            req.tty = field.substr(4);
+        else if (starts_with(field, "err="))
+            req.err = field.substr(4);
+        else if (starts_with(field, "cwd="))
+            req.cwd = field.substr(4);
+        else if (starts_with(field, "env=")
+                 && field.find('=', 4) != string::npos)
+        {
+            req.env.push_back(field.substr(4));
+        }
+        else if (starts_with(field, "arg="))
+            req.args.push_back(field.substr(4));
+        else
+        {
+            error = "bad field: " + field;
+            return false;
+        }
+    }
+
+    if (req.tty.empty())
+        error = "no tty given";
+    else if (req.args.empty())
+        error = "no command line given";
+    return error.empty();
+}
+
+NORETURN static void _child_fail(const char *what, const string &arg)
+{
+    fprintf(stderr, "Zygote child: %s %s: %s\n", what, arg.c_str(),
+            strerror(errno));
+    _exit(127);
+}
+
+// Turn a freshly forked child into the game process described by req.
+static void _become_game(const zygote_request &req, int &argc, char **&argv)
+{
+    close(listen_fd);
+    close(child_pipe[0]);
+    close(child_pipe[1]);
+    for (const zygote_client &client : clients)
+        close(client.fd);
+    clients.clear();
+    _restore_signals();
+
+    // Get a controlling terminal of our own, like a pty.fork() child would.
+    setsid();
+    const int tty = open(req.tty.c_str(), O_RDWR);
+    if (tty < 0)
+        _child_fail("can't open", req.tty);
+#ifdef TIOCSCTTY
+    ioctl(tty, TIOCSCTTY, 0);
+#endif
+    dup2(tty, STDIN_FILENO);
+    dup2(tty, STDOUT_FILENO);
+    dup2(tty, STDERR_FILENO);
+    if (tty > STDERR_FILENO)
+        close(tty);
+
+    if (!req.err.empty())
+    {
+        const int err = open(req.err.c_str(), O_WRONLY);
+        if (err < 0)
+            _child_fail("can't open", req.err);
+        dup2(err, STDERR_FILENO);
+        close(err);
+    }
+
+    if (!req.cwd.empty() && chdir(req.cwd.c_str()))
+        _child_fail("can't change directory to", req.cwd);
+
+    for (const string &var : req.env)
+    {
+        const size_t eq = var.find('=');
+        setenv(var.substr(0, eq).c_str(), var.substr(eq + 1).c_str(), 1);
+    }
+
+    // These have to outlive main(), like a real argv.
+    static vector<string> args;
+    static vector<char *> arg_ptrs;
+    args = req.args;
+    for (string &arg : args)
+        arg_ptrs.push_back(&arg[0]);
+    arg_ptrs.push_back(nullptr);
+    argc = args.size();
+    argv = arg_ptrs.data();
+
+    // Forget the zygote's own command line and environment, so that the
+    // game's are parsed as if it had been started directly.
+    crawl_state.zygote_socket.clear();
+    crawl_state.command_line_arguments.clear();
+    SysEnv = system_environment();
+    get_system_environment();
+}
+
+// Returns true in the forked game process.
+static bool _spawn(zygote_client &client, int &argc, char **&argv)
+{
+    zygote_request req;
+    string error;
+    if (!_parse_request(client.request, req, error))
+    {
+        _reply(client.fd, "error " + error);
+        return false;
+    }
+
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        _reply(client.fd, string("error fork: ") + strerror(errno));
+        return false;
+    }
+    if (pid == 0)
+    {
+        _become_game(req, argc, argv);
+        return true;
+    }
+
+    client.pid = pid;
+    client.request.clear();
+    _reply(client.fd, make_stringf("%d", (int) pid));
+    return false;
+}
+
+static void _reap_children()
+{
+    char buf[64];
+    while (read(child_pipe[0], buf, sizeof(buf)) > 0)
+        ;
+
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        for (auto it = clients.begin(); it != clients.end(); ++it)
+        {
+            if (it->pid == pid)
+            {
+                _reply(it->fd, make_stringf("%d", status));
+                close(it->fd);
+                clients.erase(it);
+                break;
+            }
+        }
+    }
+}
+
+// Returns true in the forked game process.
+static bool _read_request(zygote_client &client, int &argc, char **&argv,
+                          bool &closed)
+{
+    char buf[4096];
+    const ssize_t len = recv(client.fd, buf, sizeof(buf), 0);
+    if (len <= 0)
+    {
+        // Nothing to do for a client that gives up before its game starts.
+        closed = len == 0 || errno != EINTR;
+        return false;
+    }
+
+    client.request.append(buf, len);
+    if (!_request_complete(client.request))
+        return false;
+
+    const bool in_child = _spawn(client, argc, argv);
+    // A client whose request failed won't get an exit status.
+    closed = !in_child && !client.pid;
+    return in_child;
+}
+
+/**
+ * Preload the game data, then serve game requests on the socket given with
+ * -zygote until told to stop.
+ *
+ * Returns only in forked game processes, with argc and argv replaced by the
+ * requested command line.
+ */
+void zygote_serve(int &argc, char **&argv)
+{
+    preload_game_data();
+    // Each game reopens these; database handles mustn't be shared.
+    databaseSystemShutdown();
+
+    _listen(crawl_state.zygote_socket);
+    _install_signals();
+
+    while (!stop_requested)
+    {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(listen_fd, &fds);
+        FD_SET(child_pipe[0], &fds);
+        int max_fd = max(listen_fd, child_pipe[0]);
+        for (const zygote_client &client : clients)
+        {
+            // Once the game is running the only thing left is to report its
+            // exit status.
+            if (client.pid)
+                continue;
+            FD_SET(client.fd, &fds);
+            max_fd = max(max_fd, client.fd);
+        }
+
+        if (select(max_fd + 1, &fds, nullptr, nullptr, nullptr) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            die("Zygote select() failed: %s", strerror(errno));
+        }
+
+        if (FD_ISSET(child_pipe[0], &fds))
+            _reap_children();
+
+        for (unsigned int i = 0; i < clients.size(); ++i)
+        {
+            if (clients[i].pid || !FD_ISSET(clients[i].fd, &fds))
+                continue;
+
+            bool closed = false;
+            if (_read_request(clients[i], argc, argv, closed))
+                return;
+            if (closed)
+            {
+                close(clients[i].fd);
+                clients.erase(clients.begin() + i);
+                --i;
+            }
+        }
+
+        if (FD_ISSET(listen_fd, &fds))
+        {
+            const int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0)
+                clients.push_back({ fd, "", 0 });
+        }
+    }
+
+    unlink(crawl_state.zygote_socket.c_str());
+    exit(0);
+}
+
+#endif
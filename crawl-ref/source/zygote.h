@@ -0,0 +1,10 @@
+/**
+ * @file
+ * @brief Fork server for webtiles hosts.
+**/
+
+#pragma once
+
+#ifdef USE_TILE_WEB
+void zygote_serve(int &argc, char **&argv);
+#endif